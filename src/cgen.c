@@ -0,0 +1,527 @@
+// src/cgen.c
+#define _POSIX_C_SOURCE 200809L
+
+#include "cgen.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+/*
+   C backend.
+
+   Every Noema variable becomes a slot in a static array; expressions are
+   flattened into C temporaries in evaluation order (so the first error
+   raised is the same one the tree evaluator raises), and each runtime
+   check calls into the prelude below with the node's line/column.
+   Programs have no loops, so strings are never freed: every statement
+   runs at most once and the process exits right after.
+*/
+
+/* top-level statements per generated function (keeps the C compiler fast) */
+#define CG_CHUNK 256
+
+static const char *cg_prelude =
+    "typedef struct {\n"
+    "    int k;\n"
+    "    int i;\n"
+    "    const char *s;\n"
+    "} nv;\n"
+    "\n"
+    "enum { NR_UNDEF, NR_INT, NR_STRING, NR_BOOL, NR_NULL };\n"
+    "\n"
+    "static nv NR_V[NR_NVARS];\n"
+    "static int NR_COUNT;\n"
+    "\n"
+    "static inline _Noreturn void nr_fail(int line, int col, const char *msg) {\n"
+    "    char buf[512];\n"
+    "    if (line > 0 && col > 0) snprintf(buf, sizeof(buf), \"%s:%d:%d: runtime error: %s\", NR_PATH, line, col, msg);\n"
+    "    else if (line > 0) snprintf(buf, sizeof(buf), \"%s:%d: runtime error: %s\", NR_PATH, line, msg);\n"
+    "    else snprintf(buf, sizeof(buf), \"%s: runtime error: %s\", NR_PATH, msg);\n"
+    "    fprintf(stderr, \"%s\\n\", buf);\n"
+    "    exit(1);\n"
+    "}\n"
+    "\n"
+    "static inline nv nr_int(int i) { nv v = { NR_INT, i, 0 }; return v; }\n"
+    "static inline nv nr_str(const char *s) { nv v = { NR_STRING, 0, s }; return v; }\n"
+    "static inline nv nr_bool(int b) { nv v = { NR_BOOL, b != 0, 0 }; return v; }\n"
+    "static inline nv nr_null(void) { nv v = { NR_NULL, 0, 0 }; return v; }\n"
+    "\n"
+    "static inline int nr_truthy(nv v) {\n"
+    "    switch (v.k) {\n"
+    "        case NR_BOOL:   return v.i;\n"
+    "        case NR_INT:    return v.i != 0;\n"
+    "        case NR_STRING: return v.s[0] != 0;\n"
+    "        default:        return 0;\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "static inline nv nr_get(int x, int line, int col) {\n"
+    "    if (NR_V[x].k == NR_UNDEF) {\n"
+    "        char msg[320];\n"
+    "        snprintf(msg, sizeof(msg), \"undefined variable '%s'\", NR_NAME[x]);\n"
+    "        nr_fail(line, col, msg);\n"
+    "    }\n"
+    "    return NR_V[x];\n"
+    "}\n"
+    "\n"
+    "/* assignment creates the variable (as nulla) before evaluating the value */\n"
+    "static inline void nr_def(int x, int line, int col) {\n"
+    "    if (NR_V[x].k != NR_UNDEF) return;\n"
+    "    if (NR_COUNT == 1000) nr_fail(line, col, \"too many variables\");\n"
+    "    NR_COUNT++;\n"
+    "    NR_V[x].k = NR_NULL;\n"
+    "}\n"
+    "\n"
+    "static inline nv nr_neg(nv a, int line, int col) {\n"
+    "    if (a.k != NR_INT) nr_fail(line, col, \"unary '-' expects integer\");\n"
+    "    return nr_int((int)(0u - (unsigned)a.i));\n"
+    "}\n"
+    "\n"
+    "static inline nv nr_add(nv a, nv b, int line, int col) {\n"
+    "    if (a.k == NR_INT && b.k == NR_INT) return nr_int((int)((unsigned)a.i + (unsigned)b.i));\n"
+    "    if (a.k == NR_STRING && b.k == NR_STRING) {\n"
+    "        size_t na = strlen(a.s), nb = strlen(b.s);\n"
+    "        char *p = (char*)malloc(na + nb + 1);\n"
+    "        if (!p) nr_fail(line, col, \"out of memory concatenating strings\");\n"
+    "        memcpy(p, a.s, na);\n"
+    "        memcpy(p + na, b.s, nb + 1);\n"
+    "        return nr_str(p);\n"
+    "    }\n"
+    "    nr_fail(line, col, \"operator '+' expects int+int or string+string\");\n"
+    "}\n"
+    "\n"
+    "static inline void nr_ints(nv a, nv b, int line, int col, const char *what) {\n"
+    "    if (a.k != NR_INT || b.k != NR_INT) nr_fail(line, col, what);\n"
+    "}\n"
+    "\n"
+    "#define NR_ARITH \"arithmetic operators expect integers\"\n"
+    "#define NR_CMP \"comparison operators expect integers\"\n"
+    "\n"
+    "static inline nv nr_sub(nv a, nv b, int l, int c) { nr_ints(a, b, l, c, NR_ARITH); return nr_int((int)((unsigned)a.i - (unsigned)b.i)); }\n"
+    "static inline nv nr_mul(nv a, nv b, int l, int c) { nr_ints(a, b, l, c, NR_ARITH); return nr_int((int)((unsigned)a.i * (unsigned)b.i)); }\n"
+    "\n"
+    "static inline nv nr_div(nv a, nv b, int l, int c) {\n"
+    "    nr_ints(a, b, l, c, NR_ARITH);\n"
+    "    if (b.i == 0) nr_fail(l, c, \"division by zero\");\n"
+    "    return nr_int(a.i / b.i);\n"
+    "}\n"
+    "\n"
+    "static inline nv nr_mod(nv a, nv b, int l, int c) {\n"
+    "    nr_ints(a, b, l, c, NR_ARITH);\n"
+    "    if (b.i == 0) nr_fail(l, c, \"modulo by zero\");\n"
+    "    return nr_int(a.i % b.i);\n"
+    "}\n"
+    "\n"
+    "static inline int nr_eq(nv a, nv b) {\n"
+    "    if (a.k != b.k) return 0;\n"
+    "    if (a.k == NR_STRING && b.k == NR_STRING) return strcmp(a.s, b.s) == 0;\n"
+    "    return a.k == NR_NULL || a.i == b.i;\n"
+    "}\n"
+    "\n"
+    "static inline nv nr_lt(nv a, nv b, int l, int c) { nr_ints(a, b, l, c, NR_CMP); return nr_bool(a.i <  b.i); }\n"
+    "static inline nv nr_le(nv a, nv b, int l, int c) { nr_ints(a, b, l, c, NR_CMP); return nr_bool(a.i <= b.i); }\n"
+    "static inline nv nr_gt(nv a, nv b, int l, int c) { nr_ints(a, b, l, c, NR_CMP); return nr_bool(a.i >  b.i); }\n"
+    "static inline nv nr_ge(nv a, nv b, int l, int c) { nr_ints(a, b, l, c, NR_CMP); return nr_bool(a.i >= b.i); }\n"
+    "\n"
+    "static inline void nr_print(nv v) {\n"
+    "    switch (v.k) {\n"
+    "        case NR_STRING: printf(\"%s\\n\", v.s); break;\n"
+    "        case NR_INT:    printf(\"%d\\n\", v.i); break;\n"
+    "        case NR_BOOL:   printf(\"%s\\n\", v.i ? \"verum\" : \"falsum\"); break;\n"
+    "        default:        printf(\"nulla\\n\"); break;\n"
+    "    }\n"
+    "}\n";
+
+/* ============================================================
+   Emitter state
+   ============================================================ */
+
+typedef struct {
+    FILE *out;
+
+    const char **names;     /* variable slot -> Noema name (borrowed from the AST) */
+    int nnames, capnames;
+
+    int ntemp;
+    int ind;
+    int failed;
+} Cg;
+
+static void cg_line(Cg *cg, const char *fmt, ...) {
+    fprintf(cg->out, "%*s", cg->ind * 4, "");
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(cg->out, fmt, ap);
+    va_end(ap);
+    fputc('\n', cg->out);
+}
+
+static void cg_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (const unsigned char *p = (const unsigned char*)s; *p; p++) {
+        if (*p == '"' || *p == '\\') fprintf(out, "\\%c", *p);
+        else if (*p == '?') fputs("\\?", out);     /* no trigraphs */
+        else if (*p >= 32 && *p < 127) fputc(*p, out);
+        else fprintf(out, "\\%03o", *p);
+    }
+    fputc('"', out);
+}
+
+static int slot_of(Cg *cg, const char *name) {
+    for (int i = 0; i < cg->nnames; i++) {
+        if (strcmp(cg->names[i], name) == 0) return i;
+    }
+    if (cg->nnames == cg->capnames) {
+        int cap = cg->capnames ? cg->capnames * 2 : 32;
+        const char **p = (const char**)realloc(cg->names, (size_t)cap * sizeof(*p));
+        if (!p) { cg->failed = 1; return 0; }
+        cg->names = p;
+        cg->capnames = cap;
+    }
+    cg->names[cg->nnames] = name;
+    return cg->nnames++;
+}
+
+static void collect_expr(Cg *cg, const Expr *e) {
+    if (!e) return;
+    switch (e->kind) {
+        case EXPR_VAR:    slot_of(cg, e->as.var.name); break;
+        case EXPR_UNARY:  collect_expr(cg, e->as.unary.rhs); break;
+        case EXPR_BINARY: collect_expr(cg, e->as.binary.lhs); collect_expr(cg, e->as.binary.rhs); break;
+        default: break;
+    }
+}
+
+static void collect_block(Cg *cg, const Stmt *s) {
+    for (; s; s = s->next) {
+        switch (s->kind) {
+            case STMT_ASSIGN:
+                slot_of(cg, s->target);
+                collect_expr(cg, s->value);
+                break;
+            case STMT_CALL_PRINT:
+                collect_expr(cg, s->arg);
+                break;
+            case STMT_IF:
+                for (const IfBranch *b = s->if_branches; b; b = b->next) {
+                    collect_expr(cg, b->cond);
+                    collect_block(cg, b->body);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/* ============================================================
+   Expressions: one temporary per node, in evaluation order
+   ============================================================ */
+
+static const char* cg_helper(ExprOp op) {
+    switch (op) {
+        case OP_ADD: return "nr_add";
+        case OP_SUB: return "nr_sub";
+        case OP_MUL: return "nr_mul";
+        case OP_DIV: return "nr_div";
+        case OP_MOD: return "nr_mod";
+        case OP_LT:  return "nr_lt";
+        case OP_LE:  return "nr_le";
+        case OP_GT:  return "nr_gt";
+        case OP_GE:  return "nr_ge";
+        default:     return NULL;
+    }
+}
+
+static int cg_expr(Cg *cg, const Expr *e) {
+    int t = cg->ntemp++;
+
+    if (!e) {
+        cg->failed = 1;
+        return t;
+    }
+
+    switch (e->kind) {
+        case EXPR_LITERAL:
+            switch (e->as.lit.lit_kind) {
+                case LIT_INT:
+                    if (e->as.lit.int_value == INT_MIN) cg_line(cg, "nv t%d = nr_int(-2147483647 - 1);", t);
+                    else cg_line(cg, "nv t%d = nr_int(%d);", t, e->as.lit.int_value);
+                    break;
+                case LIT_BOOL:
+                    cg_line(cg, "nv t%d = nr_bool(%d);", t, e->as.lit.int_value ? 1 : 0);
+                    break;
+                case LIT_STRING:
+                    fprintf(cg->out, "%*snv t%d = nr_str(", cg->ind * 4, "", t);
+                    cg_string(cg->out, e->as.lit.text);
+                    fprintf(cg->out, ");\n");
+                    break;
+                default:
+                    cg_line(cg, "nv t%d = nr_null();", t);
+                    break;
+            }
+            break;
+
+        case EXPR_VAR:
+            cg_line(cg, "nv t%d = nr_get(%d, %d, %d);", t, slot_of(cg, e->as.var.name), e->line, e->col);
+            break;
+
+        case EXPR_UNARY: {
+            int a = cg_expr(cg, e->as.unary.rhs);
+            if (e->as.unary.op == OP_NOT) cg_line(cg, "nv t%d = nr_bool(!nr_truthy(t%d));", t, a);
+            else cg_line(cg, "nv t%d = nr_neg(t%d, %d, %d);", t, a, e->line, e->col);
+            break;
+        }
+
+        case EXPR_BINARY: {
+            ExprOp op = e->as.binary.op;
+
+            if (op == OP_AND || op == OP_OR) {
+                cg_line(cg, "nv t%d;", t);
+                cg_line(cg, "{");
+                cg->ind++;
+                int a = cg_expr(cg, e->as.binary.lhs);
+                cg_line(cg, "if (%snr_truthy(t%d)) {", op == OP_AND ? "!" : "", a);
+                cg_line(cg, "    t%d = nr_bool(%d);", t, op == OP_OR);
+                cg_line(cg, "} else {");
+                cg->ind++;
+                int b = cg_expr(cg, e->as.binary.rhs);
+                cg_line(cg, "t%d = nr_bool(nr_truthy(t%d));", t, b);
+                cg->ind--;
+                cg_line(cg, "}");
+                cg->ind--;
+                cg_line(cg, "}");
+                break;
+            }
+
+            int a = cg_expr(cg, e->as.binary.lhs);
+            int b = cg_expr(cg, e->as.binary.rhs);
+
+            if (op == OP_EQ || op == OP_NE) {
+                cg_line(cg, "nv t%d = nr_bool(%snr_eq(t%d, t%d));", t, op == OP_NE ? "!" : "", a, b);
+                break;
+            }
+
+            const char *fn = cg_helper(op);
+            if (!fn) { cg->failed = 1; break; }
+            cg_line(cg, "nv t%d = %s(t%d, t%d, %d, %d);", t, fn, a, b, e->line, e->col);
+            break;
+        }
+
+        default:
+            cg->failed = 1;
+            break;
+    }
+    return t;
+}
+
+/* ============================================================
+   Statements
+   ============================================================ */
+
+static const Stmt* cg_stmts(Cg *cg, const Stmt *s, int limit);
+
+static void cg_if(Cg *cg, const IfBranch *b) {
+    if (!b->cond) {
+        cg_stmts(cg, b->body, -1);
+        return;
+    }
+
+    int c = cg_expr(cg, b->cond);
+    cg_line(cg, "if (nr_truthy(t%d)) {", c);
+    cg->ind++;
+    cg_stmts(cg, b->body, -1);
+    cg->ind--;
+    if (b->next) {
+        cg_line(cg, "} else {");
+        cg->ind++;
+        cg_if(cg, b->next);
+        cg->ind--;
+    }
+    cg_line(cg, "}");
+}
+
+/* Emits up to `limit` statements (all when negative); returns the rest. */
+static const Stmt* cg_stmts(Cg *cg, const Stmt *s, int limit) {
+    for (; s && limit != 0 && !cg->failed; s = s->next, limit--) {
+        switch (s->kind) {
+            case STMT_IMPORT:
+                cg_line(cg, "/* import %s */", s->module);
+                break;
+
+            case STMT_ASSIGN: {
+                int x = slot_of(cg, s->target);
+                cg_line(cg, "{");
+                cg->ind++;
+                cg_line(cg, "nr_def(%d, %d, %d);", x, s->line, s->col);
+                int t = cg_expr(cg, s->value);
+                cg_line(cg, "NR_V[%d] = t%d;", x, t);
+                cg->ind--;
+                cg_line(cg, "}");
+                break;
+            }
+
+            case STMT_CALL_PRINT: {
+                cg_line(cg, "{");
+                cg->ind++;
+                int t = cg_expr(cg, s->arg);
+                cg_line(cg, "nr_print(t%d);", t);
+                cg->ind--;
+                cg_line(cg, "}");
+                break;
+            }
+
+            case STMT_IF:
+                if (!s->if_branches) break;
+                cg_line(cg, "{");
+                cg->ind++;
+                cg_if(cg, s->if_branches);
+                cg->ind--;
+                cg_line(cg, "}");
+                break;
+
+            default:
+                cg->failed = 1;
+                break;
+        }
+    }
+    return s;
+}
+
+/* ============================================================
+   Public API
+   ============================================================ */
+
+int cgen_emit_c(const Stmt *program, const char *path, FILE *out, char *err, int cap) {
+    Cg cg;
+    memset(&cg, 0, sizeof(cg));
+    cg.out = out;
+
+    if (!path || !path[0]) path = "<input>";
+
+    collect_block(&cg, program);
+    if (cg.failed) {
+        free(cg.names);
+        snprintf(err, cap, "noema: out of memory generating C");
+        return 0;
+    }
+
+    fprintf(out, "/* generated by noema from ");
+    for (const char *p = path; *p; p++) {
+        if (p[0] == '*' && p[1] == '/') fputs("*\\/", out), p++;
+        else fputc(*p, out);
+    }
+    fprintf(out, " */\n");
+    fprintf(out, "#include <stdio.h>\n#include <stdlib.h>\n#include <string.h>\n\n");
+
+    fprintf(out, "#define NR_PATH ");
+    cg_string(out, path);
+    fprintf(out, "\n#define NR_NVARS %d\n\n", cg.nnames > 0 ? cg.nnames : 1);
+
+    fprintf(out, "static const char *const NR_NAME[NR_NVARS] = {\n");
+    for (int i = 0; i < cg.nnames; i++) {
+        fprintf(out, "    ");
+        cg_string(out, cg.names[i]);
+        fprintf(out, ",\n");
+    }
+    if (cg.nnames == 0) fprintf(out, "    \"\",\n");
+    fprintf(out, "};\n\n");
+
+    fputs(cg_prelude, out);
+    fputc('\n', out);
+
+    int nparts = 0;
+    const Stmt *s = program;
+    do {
+        cg_line(&cg, "static void nr_part%d(void) {", nparts++);
+        cg.ind++;
+        s = cg_stmts(&cg, s, CG_CHUNK);
+        cg.ind--;
+        cg_line(&cg, "}");
+        cg_line(&cg, "");
+    } while (s && !cg.failed);
+
+    cg_line(&cg, "int main(void) {");
+    cg.ind++;
+    for (int i = 0; i < nparts; i++) cg_line(&cg, "nr_part%d();", i);
+    cg_line(&cg, "return 0;");
+    cg.ind--;
+    cg_line(&cg, "}");
+
+    free(cg.names);
+
+    if (cg.failed) {
+        snprintf(err, cap, "noema: cannot translate program to C");
+        return 0;
+    }
+    if (ferror(out)) {
+        snprintf(err, cap, "noema: error writing C output");
+        return 0;
+    }
+    return 1;
+}
+
+int cgen_compile(const Stmt *program, const char *path, const char *exe_path, char *err, int cap) {
+    char cpath[] = "/tmp/noema-XXXXXX";
+    int fd = mkstemp(cpath);
+    if (fd < 0) {
+        snprintf(err, cap, "noema: cannot create temporary file");
+        return 0;
+    }
+
+    FILE *cf = fdopen(fd, "w");
+    if (!cf) {
+        close(fd);
+        remove(cpath);
+        snprintf(err, cap, "noema: cannot create temporary file");
+        return 0;
+    }
+
+    int ok = cgen_emit_c(program, path, cf, err, cap);
+    if (fclose(cf) != 0 && ok) {
+        snprintf(err, cap, "noema: error writing C output");
+        ok = 0;
+    }
+    if (!ok) {
+        remove(cpath);
+        return 0;
+    }
+
+    const char *cc = getenv("CC");
+    if (!cc || !cc[0]) cc = "gcc";
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        remove(cpath);
+        snprintf(err, cap, "noema: cannot start %s", cc);
+        return 0;
+    }
+    if (pid == 0) {
+        execlp(cc, cc, "-O2", "-x", "c", cpath, "-o", exe_path, (char*)NULL);
+        _exit(127);
+    }
+
+    int status = 0;
+    pid_t w;
+    do {
+        w = waitpid(pid, &status, 0);
+    } while (w < 0 && errno == EINTR);
+    remove(cpath);
+
+    if (w < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 127) {
+            snprintf(err, cap, "noema: cannot run C compiler '%s'", cc);
+        } else {
+            snprintf(err, cap, "noema: C compiler '%s' failed", cc);
+        }
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,32 @@
+// src/cgen.h
+#ifndef NOEMA_CGEN_H
+#define NOEMA_CGEN_H
+
+#include <stdio.h>
+
+#include "parser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+   Ahead-of-time backend: translates a parsed program into one standalone
+   C file (a small value/string/sonus runtime followed by `main`) whose
+   behavior, output and runtime errors match runtime.c exactly.
+*/
+
+/* Writes the C translation of `program` to `out`.
+   `path` is the source path baked into runtime error messages.
+   Returns 1 on success; on failure writes a message to err. */
+int cgen_emit_c(const Stmt *program, const char *path, FILE *out, char *err, int cap);
+
+/* Emits C to a temporary file and builds it with $CC (default gcc)
+   into `exe_path`. Returns 1 on success. */
+int cgen_compile(const Stmt *program, const char *path, const char *exe_path, char *err, int cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
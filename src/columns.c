@@ -0,0 +1,578 @@
+// src/columns.c
+#include "columns.h"
+#include "runtime.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#define COLUMNS_MAX_INPUTS 1000 /* the runtime's variable limit: below it, binding never fails */
+
+/* One value per record of the block. `k` is its ValueKind, or 0 where
+   the value is not known without running the record (it would be a
+   runtime error, or an operator here does not handle it). `v` is the
+   int or bool; for a string, whether it is non-empty; for null, 0. So
+   a known value is true exactly when v != 0. */
+typedef struct {
+    int32_t v[COLUMNS_BLOCK];
+    uint8_t k[COLUMNS_BLOCK];
+    const char *s[COLUMNS_BLOCK];       /* strings */
+} Vec;
+
+/* What a register holds: an operator over two others (b is -1 for a
+   unary one), or with op 0 a literal or an input's column. Equal
+   subexpressions of any rules share one node, so each distinct
+   condition is computed once per block, however many rules test it. */
+typedef struct {
+    int op;
+    int a, b;
+    int strings;                /* EQ/NE: both operands may be strings */
+    int cond;                   /* some si/aliosi tests it */
+    size_t hash;                /* of what it holds, for the table */
+    unsigned stamp;             /* block it was last computed for */
+} Node;
+
+typedef struct {
+    int reg;                    /* -1 if no condition reads the input */
+    uint8_t k;                  /* its default, as a lane */
+    int32_t v;
+    const char *s;
+} Input;
+
+typedef struct {
+    int cond;                   /* register; -1 for alio */
+    Stmt *body;
+} Branch;
+
+typedef struct {
+    int first, n;               /* its branches */
+    int fires;                  /* some record of the block takes one */
+} Chain;
+
+struct Columns {
+    Vec *regs;
+    Node *nodes;                /* per register */
+    int nregs, capregs;
+    int *table;                 /* hash-consing: open addressing, register + 1 */
+    size_t tcap;
+    int *conds;                 /* distinct registers of the si/aliosi conditions */
+    int nconds, capconds;
+    unsigned stamp;
+
+    Branch *branches;
+    int nbranches, capbranches;
+    Chain *chains;              /* the top-level si statements */
+    int nchains, capchains;
+
+    int16_t taken[COLUMNS_BLOCK];       /* per record: branch of one chain, -1 none */
+    uint8_t unknown[COLUMNS_BLOCK];     /* per record: some chain's outcome is unknown */
+    int count[COLUMNS_BLOCK + 1];       /* per record: bodies, then where its list starts */
+    Stmt **fired;
+    size_t capfired;
+
+    Input *inputs;
+    const SpecInput *spec;
+    int ninputs;
+
+    const char **assigned;      /* sorted names the program assigns */
+    int nassigned, capassigned;
+    int n;                      /* records in the block */
+};
+
+/* ============================================================
+   Compiling conditions
+   ============================================================ */
+
+static int cmp_name(const void *a, const void *b) {
+    return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+static int collect_assigned(Columns *c, const Stmt *s) {
+    for (; s; s = s->next) {
+        if (s->kind == STMT_ASSIGN) {
+            if (c->nassigned == c->capassigned) {
+                int cap = c->capassigned ? c->capassigned * 2 : 16;
+                const char **a = (const char**)realloc((void*)c->assigned, (size_t)cap * sizeof(*a));
+                if (!a) return 0;
+                c->assigned = a;
+                c->capassigned = cap;
+            }
+            c->assigned[c->nassigned++] = s->target;
+        } else if (s->kind == STMT_IF) {
+            for (const IfBranch *b = s->if_branches; b; b = b->next) {
+                if (!collect_assigned(c, b->body)) return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+static int is_assigned(const Columns *c, const char *name) {
+    return c->nassigned && bsearch(&name, (const void*)c->assigned, (size_t)c->nassigned,
+                                   sizeof(*c->assigned), cmp_name) != NULL;
+}
+
+static void lane_of(const LiteralValue *lit, uint8_t *k, int32_t *v, const char **s) {
+    *s = NULL;
+    switch (lit->lit_kind) {
+        case LIT_INT:    *k = VAL_INT;    *v = lit->int_value; break;
+        case LIT_BOOL:   *k = VAL_BOOL;   *v = lit->int_value ? 1 : 0; break;
+        case LIT_NULL:   *k = VAL_NULL;   *v = 0; break;
+        case LIT_STRING: *k = VAL_STRING; *v = lit->text[0] != '\0'; *s = lit->text; break;
+        default:         *k = 0;          *v = 0; break;
+    }
+}
+
+static void put_lane(Vec *r, int i, const LiteralValue *lit) {
+    lane_of(lit, &r->k[i], &r->v[i], &r->s[i]);
+}
+
+static int new_reg(Columns *c, int op, int a, int b, size_t hash) {
+    if (c->nregs == c->capregs) {
+        int cap = c->capregs ? c->capregs * 2 : 16;
+        Vec *r = (Vec*)realloc(c->regs, (size_t)cap * sizeof(Vec));
+        if (!r) return -1;
+        c->regs = r;
+        Node *n = (Node*)realloc(c->nodes, (size_t)cap * sizeof(Node));
+        if (!n) return -1;
+        c->nodes = n;
+        c->capregs = cap;
+    }
+    memset(&c->regs[c->nregs], 0, sizeof(Vec));
+    Node *n = &c->nodes[c->nregs];
+    n->op = op;
+    n->a = a;
+    n->b = b;
+    n->strings = 0;
+    n->cond = 0;
+    n->hash = hash;
+    n->stamp = 0;
+    return c->nregs++;
+}
+
+static size_t node_hash(int op, int a, int b, const LiteralValue *lit) {
+    size_t h = 1469598103934665603ull;
+    if (lit) {
+        uint8_t k;
+        int32_t v;
+        const char *str;
+        lane_of(lit, &k, &v, &str);
+        h = (h ^ k) * 1099511628211ull;
+        h = (h ^ (uint32_t)v) * 1099511628211ull;
+        for (; str && *str; str++) h = (h ^ (unsigned char)*str) * 1099511628211ull;
+    } else {
+        h = (h ^ (unsigned)op) * 1099511628211ull;
+        h = (h ^ (unsigned)a) * 1099511628211ull;
+        h = (h ^ (unsigned)b) * 1099511628211ull;
+    }
+    return h;
+}
+
+static int node_is(const Columns *c, int r, int op, int a, int b, const LiteralValue *lit) {
+    const Node *n = &c->nodes[r];
+    if (!lit) return n->op == op && n->a == a && n->b == b;
+    if (n->op != 0 || n->a != -1) return 0;
+
+    uint8_t k;
+    int32_t v;
+    const char *str;
+    lane_of(lit, &k, &v, &str);
+    const Vec *x = &c->regs[r];
+    return x->k[0] == k && x->v[0] == v && (!str || strcmp(x->s[0], str) == 0);
+}
+
+static int table_grow(Columns *c) {
+    size_t cap = c->tcap ? c->tcap * 2 : 64;
+    int *t = (int*)calloc(cap, sizeof(int));
+    if (!t) return 0;
+    for (int r = 0; r < c->nregs; r++) {
+        const Node *n = &c->nodes[r];
+        if (n->op == 0 && n->a != -1) continue;         /* columns are found by input */
+        size_t h = n->hash & (cap - 1);
+        while (t[h]) h = (h + 1) & (cap - 1);
+        t[h] = r + 1;
+    }
+    free(c->table);
+    c->table = t;
+    c->tcap = cap;
+    return 1;
+}
+
+/* The register for a literal (`lit`) or for `op` over a and b, shared
+   with any equal one compiled before; -1 if out of memory. */
+static int intern(Columns *c, int op, int a, int b, const LiteralValue *lit) {
+    if ((size_t)(c->nregs + 1) * 2 > c->tcap && !table_grow(c)) return -1;
+
+    size_t hash = node_hash(op, a, b, lit);
+    size_t h = hash & (c->tcap - 1);
+    while (c->table[h]) {
+        int r = c->table[h] - 1;
+        if (node_is(c, r, op, a, b, lit)) return r;
+        h = (h + 1) & (c->tcap - 1);
+    }
+
+    int r = new_reg(c, lit ? 0 : op, lit ? -1 : a, lit ? -1 : b, hash);
+    if (r < 0) return -1;
+    if (lit) {
+        for (int i = 0; i < COLUMNS_BLOCK; i++) put_lane(&c->regs[r], i, lit);
+    }
+    c->table[h] = r + 1;
+    return r;
+}
+
+static int find_input(const Columns *c, const char *name) {
+    int lo = 0, hi = c->ninputs - 1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        int d = strcmp(c->spec[mid].name, name);
+        if (d == 0) return mid;
+        if (d < 0) lo = mid + 1; else hi = mid - 1;
+    }
+    return -1;
+}
+
+static int may_be_string(const Expr *e) {
+    return e->kind == EXPR_VAR || (e->kind == EXPR_LITERAL && e->as.lit.lit_kind == LIT_STRING);
+}
+
+/* The register holding `e`, or -1 if it cannot be computed here. */
+static int compile(Columns *c, const Expr *e) {
+    switch (e->kind) {
+        case EXPR_LITERAL:
+            return intern(c, 0, -1, -1, &e->as.lit);
+
+        case EXPR_VAR: {
+            int in = find_input(c, e->as.var.name);
+            if (in < 0 || is_assigned(c, e->as.var.name)) return -1;
+            if (c->spec[in].kind != SPEC_INPUT && c->spec[in].kind != SPEC_FREE) return -1;
+            if (c->inputs[in].reg < 0) c->inputs[in].reg = new_reg(c, 0, in, -1, 0);
+            return c->inputs[in].reg;
+        }
+
+        case EXPR_UNARY: {
+            if (e->as.unary.op != OP_NOT && e->as.unary.op != OP_NEG) return -1;
+            int a = compile(c, e->as.unary.rhs);
+            return a < 0 ? -1 : intern(c, e->as.unary.op, a, -1, NULL);
+        }
+
+        case EXPR_BINARY: {
+            int a = compile(c, e->as.binary.lhs);
+            int b = a < 0 ? -1 : compile(c, e->as.binary.rhs);
+            if (b < 0) return -1;
+            ExprOp op = e->as.binary.op;
+            if ((op == OP_EQ || op == OP_NE || op == OP_ADD || op == OP_MUL) && b < a) {
+                int t = a; a = b; b = t;            /* symmetric: share both orders */
+            }
+            int r = intern(c, op, a, b, NULL);
+            if (r >= 0 && may_be_string(e->as.binary.lhs) && may_be_string(e->as.binary.rhs)) {
+                c->nodes[r].strings = 1;
+            }
+            return r;
+        }
+
+        default:
+            return -1;
+    }
+}
+
+Columns* columns_build(Stmt *program, const SpecInput *inputs, int ninputs) {
+    if (ninputs > COLUMNS_MAX_INPUTS) return NULL;
+
+    Columns *c = (Columns*)calloc(1, sizeof(Columns));
+    if (!c) return NULL;
+    c->spec = inputs;
+    c->ninputs = ninputs;
+    c->inputs = (Input*)calloc((size_t)ninputs + 1, sizeof(Input));
+    int ok = c->inputs && collect_assigned(c, program);
+    if (ok && c->nassigned) qsort((void*)c->assigned, (size_t)c->nassigned, sizeof(*c->assigned), cmp_name);
+
+    for (int i = 0; ok && i < ninputs; i++) {
+        c->inputs[i].reg = -1;
+        /* a free input left unset is undefined: its lanes stay unknown */
+        if (inputs[i].kind == SPEC_INPUT) lane_of(&inputs[i].value, &c->inputs[i].k, &c->inputs[i].v, &c->inputs[i].s);
+    }
+
+    for (Stmt *s = program; ok && s; s = s->next) {
+        if (s->kind == STMT_IMPORT) continue;
+        if (s->kind != STMT_IF) { ok = 0; break; }
+
+        if (c->nchains == c->capchains) {
+            int cap = c->capchains ? c->capchains * 2 : 16;
+            Chain *ch = (Chain*)realloc(c->chains, (size_t)cap * sizeof(Chain));
+            if (!ch) { ok = 0; break; }
+            c->chains = ch;
+            c->capchains = cap;
+        }
+        Chain *ch = &c->chains[c->nchains++];
+        ch->first = c->nbranches;
+        ch->n = 0;
+        ch->fires = 0;
+
+        for (IfBranch *b = s->if_branches; ok && b; b = b->next) {
+            int r = b->cond ? compile(c, b->cond) : -1;
+            if (b->cond && r < 0) { ok = 0; break; }
+            if (c->nbranches == c->capbranches) {
+                int cap = c->capbranches ? c->capbranches * 2 : 16;
+                Branch *br = (Branch*)realloc(c->branches, (size_t)cap * sizeof(Branch));
+                if (!br) { ok = 0; break; }
+                c->branches = br;
+                c->capbranches = cap;
+            }
+            c->branches[c->nbranches].cond = r;
+            c->branches[c->nbranches].body = b->body;
+            c->nbranches++;
+            ch->n++;
+
+            if (r < 0 || c->nodes[r].cond) continue;
+            c->nodes[r].cond = 1;
+            if (c->nconds == c->capconds) {
+                int cap = c->capconds ? c->capconds * 2 : 16;
+                int *conds = (int*)realloc(c->conds, (size_t)cap * sizeof(int));
+                if (!conds) { ok = 0; break; }
+                c->conds = conds;
+                c->capconds = cap;
+            }
+            c->conds[c->nconds++] = r;
+        }
+    }
+
+    if (!ok) {
+        columns_free(c);
+        return NULL;
+    }
+    return c;
+}
+
+void columns_free(Columns *c) {
+    if (!c) return;
+    free(c->regs);
+    free(c->nodes);
+    free(c->table);
+    free(c->conds);
+    free(c->branches);
+    free(c->chains);
+    free(c->fired);
+    free(c->inputs);
+    free((void*)c->assigned);
+    free(c);
+}
+
+/* ============================================================
+   Evaluation
+   Every pass runs over the whole block, whatever its length, so the
+   loops have a fixed trip count and no branches and the compiler can
+   vectorize them; lanes past the block's records are unknown.
+   ============================================================ */
+
+#define LANES for (int i = 0; i < COLUMNS_BLOCK; i++)
+#define BOTH_INT ((a->k[i] == VAL_INT) & (b->k[i] == VAL_INT))
+
+/* Computes register r from its operands. */
+static void run_node(Columns *c, int r) {
+    const Node *in = &c->nodes[r];
+    Vec *d = &c->regs[r];
+    const Vec *a = &c->regs[in->a];
+    const Vec *b = in->b >= 0 ? &c->regs[in->b] : a;
+
+    switch (in->op) {
+        case OP_ADD:
+            LANES { d->v[i] = (int32_t)((uint32_t)a->v[i] + (uint32_t)b->v[i]); d->k[i] = (uint8_t)(BOTH_INT * VAL_INT); }
+            break;
+        case OP_SUB:
+            LANES { d->v[i] = (int32_t)((uint32_t)a->v[i] - (uint32_t)b->v[i]); d->k[i] = (uint8_t)(BOTH_INT * VAL_INT); }
+            break;
+        case OP_MUL:
+            LANES { d->v[i] = (int32_t)((uint32_t)a->v[i] * (uint32_t)b->v[i]); d->k[i] = (uint8_t)(BOTH_INT * VAL_INT); }
+            break;
+        case OP_DIV:
+        case OP_MOD:
+            LANES {
+                int ok = BOTH_INT & (b->v[i] != 0) & !((a->v[i] == INT_MIN) & (b->v[i] == -1));
+                int32_t den = ok ? b->v[i] : 1;
+                d->v[i] = in->op == OP_DIV ? a->v[i] / den : a->v[i] % den;
+                d->k[i] = (uint8_t)(ok * VAL_INT);
+            }
+            break;
+
+        case OP_LT: LANES { d->v[i] = a->v[i] <  b->v[i]; d->k[i] = (uint8_t)(BOTH_INT * VAL_BOOL); } break;
+        case OP_LE: LANES { d->v[i] = a->v[i] <= b->v[i]; d->k[i] = (uint8_t)(BOTH_INT * VAL_BOOL); } break;
+        case OP_GT: LANES { d->v[i] = a->v[i] >  b->v[i]; d->k[i] = (uint8_t)(BOTH_INT * VAL_BOOL); } break;
+        case OP_GE: LANES { d->v[i] = a->v[i] >= b->v[i]; d->k[i] = (uint8_t)(BOTH_INT * VAL_BOOL); } break;
+
+        case OP_EQ:
+        case OP_NE: {
+            int ne = in->op == OP_NE;
+            LANES {
+                int eq = (a->k[i] == b->k[i]) & ((a->k[i] == VAL_NULL) | (a->v[i] == b->v[i]));
+                d->v[i] = eq ^ ne;
+                d->k[i] = (uint8_t)(((a->k[i] != 0) & (b->k[i] != 0)) * VAL_BOOL);
+            }
+            if (in->strings) {
+                LANES {
+                    if (a->k[i] == VAL_STRING && b->k[i] == VAL_STRING) {
+                        d->v[i] = (strcmp(a->s[i], b->s[i]) == 0) ^ ne;
+                    }
+                }
+            }
+            break;
+        }
+
+        case OP_AND:
+            LANES {
+                int ta = (a->k[i] != 0) & (a->v[i] != 0);
+                int tb = (b->k[i] != 0) & (b->v[i] != 0);
+                d->v[i] = ta & tb;
+                d->k[i] = (uint8_t)(((a->k[i] != 0) & (!ta | (b->k[i] != 0))) * VAL_BOOL);
+            }
+            break;
+        case OP_OR:
+            LANES {
+                int ta = (a->k[i] != 0) & (a->v[i] != 0);
+                int tb = (b->k[i] != 0) & (b->v[i] != 0);
+                d->v[i] = ta | tb;
+                d->k[i] = (uint8_t)(((a->k[i] != 0) & (ta | (b->k[i] != 0))) * VAL_BOOL);
+            }
+            break;
+
+        case OP_NOT:
+            LANES { d->v[i] = a->v[i] == 0; d->k[i] = (uint8_t)((a->k[i] != 0) * VAL_BOOL); }
+            break;
+        case OP_NEG:
+            LANES { d->v[i] = (int32_t)(0u - (uint32_t)a->v[i]); d->k[i] = (uint8_t)((a->k[i] == VAL_INT) * VAL_INT); }
+            break;
+
+        default:
+            LANES { d->v[i] = 0; d->k[i] = 0; }
+            break;
+    }
+}
+
+/* Whether every record of the block has a known value in r whose truth
+   is `truth`. */
+static int settled(const Columns *c, int r, int truth) {
+    const Vec *a = &c->regs[r];
+    int all = 1;
+    for (int i = 0; i < c->n; i++) all &= (a->k[i] != 0) & ((a->v[i] != 0) == truth);
+    return all;
+}
+
+/* Computes register r for the current block, after what it reads. The
+   right operand of `et` (`aut`) is skipped when the left one is known
+   false (true) on every record of the block. */
+static void eval_reg(Columns *c, int r) {
+    Node *n = &c->nodes[r];
+    if (n->op == 0 || n->stamp == c->stamp) return;
+    n->stamp = c->stamp;
+
+    eval_reg(c, n->a);
+    if ((n->op == OP_AND || n->op == OP_OR) && settled(c, n->a, n->op == OP_OR)) {
+        const Vec *a = &c->regs[n->a];
+        Vec *d = &c->regs[r];
+        int32_t v = n->op == OP_OR;
+        LANES { d->v[i] = v; d->k[i] = (uint8_t)((a->k[i] != 0) * VAL_BOOL); }
+        return;
+    }
+    if (n->b >= 0) eval_reg(c, n->b);
+    run_node(c, r);
+}
+
+void columns_begin(Columns *c, int n) {
+    c->n = n;
+    if (++c->stamp == 0) {
+        for (int r = 0; r < c->nregs; r++) c->nodes[r].stamp = 0;
+        c->stamp = 1;
+    }
+    for (int in = 0; in < c->ninputs; in++) {
+        const Input *p = &c->inputs[in];
+        if (p->reg < 0) continue;
+        Vec *r = &c->regs[p->reg];
+        for (int i = 0; i < n; i++) {
+            r->k[i] = p->k;
+            r->v[i] = p->v;
+            r->s[i] = p->s;
+        }
+        memset(r->k + n, 0, (size_t)(COLUMNS_BLOCK - n));
+        memset(r->v + n, 0, (size_t)(COLUMNS_BLOCK - n) * sizeof(int32_t));
+    }
+}
+
+void columns_set(Columns *c, int row, int input, const LiteralValue *value) {
+    int reg = c->inputs[input].reg;
+    if (reg >= 0) put_lane(&c->regs[reg], row, value);
+}
+
+/* The branch `ch` takes on each record into c->taken (-1: none), and
+   the records on which that is unknown into c->unknown. */
+static void chain_taken(Columns *c, const Chain *ch) {
+    int16_t *taken = c->taken;
+    uint8_t open[COLUMNS_BLOCK];
+    LANES { taken[i] = -1; open[i] = 1; }
+
+    for (int j = 0; j < ch->n; j++) {
+        int r = c->branches[ch->first + j].cond;
+        if (r < 0) {
+            LANES taken[i] = open[i] ? (int16_t)j : taken[i];
+            break;
+        }
+        const Vec *x = &c->regs[r];
+        LANES {
+            int known = x->k[i] != 0, t = x->v[i] != 0;
+            taken[i] = (open[i] & known & t) ? (int16_t)j : taken[i];
+            c->unknown[i] |= (uint8_t)(open[i] & !known);
+            open[i] = (uint8_t)(open[i] & known & !t);
+        }
+    }
+}
+
+void columns_select(Columns *c) {
+    for (int j = 0; j < c->nconds; j++) eval_reg(c, c->conds[j]);
+
+    memset(c->unknown, 0, sizeof(c->unknown));
+    memset(c->count, 0, sizeof(c->count));
+    for (int k = 0; k < c->nchains; k++) {
+        Chain *ch = &c->chains[k];
+        chain_taken(c, ch);
+        int fires = 0;
+        for (int i = 0; i < c->n; i++) {
+            int t = c->taken[i] >= 0;
+            c->count[i] += t;
+            fires |= t;
+        }
+        ch->fires = fires;
+    }
+
+    /* counts to starts, then each record's bodies in program order */
+    size_t total = 0;
+    for (int i = 0; i <= c->n; i++) {
+        size_t n = i < c->n ? (size_t)c->count[i] : 0;
+        c->count[i] = (int)total;
+        total += n;
+    }
+    if (total > c->capfired) {
+        Stmt **f = (Stmt**)realloc(c->fired, total * sizeof(Stmt*));
+        if (!f) {                       /* run every record whole */
+            memset(c->unknown, 1, sizeof(c->unknown));
+            return;
+        }
+        c->fired = f;
+        c->capfired = total;
+    }
+
+    int at[COLUMNS_BLOCK];
+    memcpy(at, c->count, (size_t)c->n * sizeof(int));
+    for (int k = 0; k < c->nchains; k++) {
+        const Chain *ch = &c->chains[k];
+        if (!ch->fires) continue;
+        chain_taken(c, ch);
+        for (int i = 0; i < c->n; i++) {
+            if (c->taken[i] >= 0) c->fired[at[i]++] = c->branches[ch->first + c->taken[i]].body;
+        }
+    }
+}
+
+int columns_fired(const Columns *c, int row, Stmt *const **bodies) {
+    if (c->unknown[row]) return -1;
+    *bodies = c->fired ? c->fired + c->count[row] : NULL;
+    return c->count[row + 1] - c->count[row];
+}
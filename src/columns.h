@@ -0,0 +1,55 @@
+// src/columns.h
+#ifndef NOEMA_COLUMNS_H
+#define NOEMA_COLUMNS_H
+
+#include "parser.h"
+#include "specialize.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+   Column-at-a-time evaluation of rule conditions (rule mode).
+
+   A rule set whose top level is only `si` chains, with conditions over
+   inputs the program never assigns, runs on a record as the bodies of
+   the branches its conditions pick, in program order: nothing else in
+   it has an effect. Those conditions are evaluated here for a block of
+   records at once: each input is a typed column, and each operator is
+   one pass over whole columns. Equal subexpressions of different rules
+   (`edad >= 18` in hundreds of them) are one node, computed once per
+   block, so the cost grows with the distinct conditions rather than
+   with the rules. Per record the result is the list of bodies to run.
+   A record on which some outcome cannot be settled exactly has to run
+   whole, as before. That happens for a would-be runtime error, or for a
+   string operand the passes do not handle.
+*/
+
+#define COLUMNS_BLOCK 1024      /* records per block */
+
+typedef struct Columns Columns;
+
+/* The conditions of `program` compiled over `inputs` (from
+   spec_take_inputs), or NULL if the program does not have the shape
+   above. Each thread needs its own. */
+Columns* columns_build(Stmt *program, const SpecInput *inputs, int ninputs);
+void     columns_free(Columns *c);
+
+/* Starts a block of `n` (at most COLUMNS_BLOCK) records, each holding
+   the inputs' defaults; columns_set then gives record `row` the value
+   of input `input`. `value` must stay valid until columns_select. */
+void     columns_begin(Columns *c, int n);
+void     columns_set(Columns *c, int row, int input, const LiteralValue *value);
+
+/* Evaluates the block's conditions. Then columns_fired gives, for
+   record `row`, the number of branch bodies it runs (0: the record does
+   nothing) with the bodies in *bodies, or -1 if it has to run whole. */
+void     columns_select(Columns *c);
+int      columns_fired(const Columns *c, int row, Stmt *const **bodies);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
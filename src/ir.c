@@ -0,0 +1,1888 @@
+// src/ir.c
+#include "ir.h"
+#include "optimize.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdio.h>
+
+#define IR_NONE (-1)
+
+typedef enum {
+    IR_CONST = 1,
+    IR_LOADVAR,     /* explicit read of a variable that may be unassigned (may raise) */
+    IR_UNARY,
+    IR_BINARY,
+    IR_TRUTHY,      /* bool(truthy(a)) */
+    IR_IF,
+    IR_PHI,
+    IR_STORE,
+    IR_PRINT,
+    IR_IMPORT
+} IrOp;
+
+/* Type lattice: set of value kinds an instruction may produce. */
+enum {
+    TY_INT    = 1,
+    TY_STRING = 2,
+    TY_BOOL   = 4,
+    TY_NULL   = 8,
+    TY_ANY    = 15
+};
+
+typedef struct {
+    int *ids;
+    int n, cap;
+} IrRegion;
+
+typedef struct {
+    IrOp op;
+    ExprOp eop;                         /* UNARY/BINARY */
+    int a, b;                           /* operands; IF: a=cond; PHI: a=then, b=else */
+    LiteralValue *lit;                  /* CONST (owned) */
+    const char *name;                   /* LOADVAR/STORE/IMPORT/PHI ("" for et/aut),
+                                           PRINT (callee); points into the source program */
+    int line, col;
+    int uline[2], ucol[2];              /* source position of operand a/b at this use */
+    int type;
+    int undef;                          /* PHI: variable unassigned on some path */
+    int is_expr;                        /* IF built from et/aut */
+    int owner;                          /* PHI: the IF it merges */
+    IrRegion *then_r, *else_r;          /* IF */
+    int forward;                        /* replaced by another value */
+    int live;
+} IrInstr;
+
+struct IrFunc {
+    IrInstr *ins;
+    int n, cap;
+
+    IrRegion *body;
+
+    IrRegion **regions;                 /* every region, for freeing */
+    int nregions, capregions;
+
+    int failed;                         /* OOM or unsupported construct */
+};
+
+/* ============================================================
+   Storage
+   ============================================================ */
+
+static IrRegion* new_region(IrFunc *f) {
+    if (f->nregions == f->capregions) {
+        int cap = f->capregions ? f->capregions * 2 : 16;
+        IrRegion **p = (IrRegion**)realloc(f->regions, (size_t)cap * sizeof(*p));
+        if (!p) { f->failed = 1; return NULL; }
+        f->regions = p;
+        f->capregions = cap;
+    }
+    IrRegion *r = (IrRegion*)calloc(1, sizeof(IrRegion));
+    if (!r) { f->failed = 1; return NULL; }
+    f->regions[f->nregions++] = r;
+    return r;
+}
+
+static void region_push(IrFunc *f, IrRegion *r, int id) {
+    if (r->n == r->cap) {
+        int cap = r->cap ? r->cap * 2 : 8;
+        int *p = (int*)realloc(r->ids, (size_t)cap * sizeof(int));
+        if (!p) { f->failed = 1; return; }
+        r->ids = p;
+        r->cap = cap;
+    }
+    r->ids[r->n++] = id;
+}
+
+/* Never keep an IrInstr* across this call: the array may move. */
+static int new_instr(IrFunc *f, IrRegion *r, IrOp op, int line, int col) {
+    if (f->failed || !r) return IR_NONE;
+    if (f->n == f->cap) {
+        int cap = f->cap ? f->cap * 2 : 64;
+        IrInstr *p = (IrInstr*)realloc(f->ins, (size_t)cap * sizeof(IrInstr));
+        if (!p) { f->failed = 1; return IR_NONE; }
+        f->ins = p;
+        f->cap = cap;
+    }
+    int id = f->n++;
+    IrInstr *in = &f->ins[id];
+    memset(in, 0, sizeof(*in));
+    in->op = op;
+    in->a = in->b = IR_NONE;
+    in->owner = IR_NONE;
+    in->forward = IR_NONE;
+    in->line = line;
+    in->col = col;
+    in->type = TY_ANY;
+    in->live = 1;
+    in->name = "";
+    region_push(f, r, id);
+    return id;
+}
+
+static int lit_type(const LiteralValue *v);
+
+/* Makes `id` the constant `v` (which may not be its own literal). */
+static int set_lit(IrFunc *f, int id, const LiteralValue *v) {
+    IrInstr *in = &f->ins[id];
+    if (!in->lit) {
+        in->lit = (LiteralValue*)malloc(sizeof(LiteralValue));
+        if (!in->lit) { f->failed = 1; return 0; }
+    }
+    *in->lit = *v;
+    in->op = IR_CONST;
+    in->type = lit_type(v);
+    return 1;
+}
+
+static int new_const(IrFunc *f, IrRegion *r, const LiteralValue *v, int line, int col) {
+    int id = new_instr(f, r, IR_CONST, line, col);
+    if (id == IR_NONE) return IR_NONE;
+    return set_lit(f, id, v) ? id : IR_NONE;
+}
+
+static int res(const IrFunc *f, int id) {
+    while (id != IR_NONE && f->ins[id].forward != IR_NONE) id = f->ins[id].forward;
+    return id;
+}
+
+static void set_use(IrFunc *f, int id, int k, const Expr *e) {
+    if (id == IR_NONE || !e) return;
+    f->ins[id].uline[k] = e->line;
+    f->ins[id].ucol[k] = e->col;
+}
+
+static void copy_use(IrFunc *f, int dst, int from, int k) {
+    f->ins[dst].uline[0] = f->ins[from].uline[k];
+    f->ins[dst].ucol[0] = f->ins[from].ucol[k];
+}
+
+static void forward_to(IrFunc *f, int id, int to) {
+    f->ins[id].forward = to;
+    f->ins[id].live = 0;
+}
+
+static void kill_region(IrFunc *f, IrRegion *r);
+
+static void kill(IrFunc *f, int id) {
+    IrInstr *in = &f->ins[id];
+    in->live = 0;
+    if (in->op == IR_IF) {
+        kill_region(f, in->then_r);
+        kill_region(f, in->else_r);
+    }
+}
+
+static void kill_region(IrFunc *f, IrRegion *r) {
+    for (int i = 0; r && i < r->n; i++) kill(f, r->ids[i]);
+}
+
+/* Drops dead ids from region lists and resolves forwarded operands. */
+static void compact_region(IrFunc *f, IrRegion *r) {
+    int k = 0;
+    for (int i = 0; i < r->n; i++) {
+        int id = r->ids[i];
+        IrInstr *in = &f->ins[id];
+        if (!in->live) continue;
+        in->a = res(f, in->a);
+        in->b = res(f, in->b);
+        if (in->op == IR_IF) {
+            compact_region(f, in->then_r);
+            compact_region(f, in->else_r);
+        }
+        r->ids[k++] = id;
+    }
+    r->n = k;
+}
+
+static int is_stmt_phi(const IrInstr *in) {
+    return in->op == IR_PHI && in->name[0] != '\0';
+}
+
+static int is_side_effect(const IrInstr *in) {
+    return in->op == IR_STORE || in->op == IR_PRINT || in->op == IR_IMPORT ||
+           (in->op == IR_IF && !in->is_expr);
+}
+
+static int lit_type(const LiteralValue *v) {
+    switch (v->lit_kind) {
+        case LIT_INT:    return TY_INT;
+        case LIT_STRING: return TY_STRING;
+        case LIT_BOOL:   return TY_BOOL;
+        case LIT_NULL:   return TY_NULL;
+        default:         return TY_ANY;
+    }
+}
+
+static int type_of(const IrFunc *f, int id) {
+    id = res(f, id);
+    return id == IR_NONE ? TY_ANY : f->ins[id].type;
+}
+
+static int is_const(const IrFunc *f, int id) {
+    id = res(f, id);
+    return id != IR_NONE && f->ins[id].op == IR_CONST;
+}
+
+static int is_const_bool(const IrFunc *f, int id, int b) {
+    id = res(f, id);
+    return is_const(f, id) && f->ins[id].lit->lit_kind == LIT_BOOL &&
+           f->ins[id].lit->int_value == b;
+}
+
+static int region_can_raise(const IrFunc *f, const IrRegion *r);
+
+/* Reading the variable behind this value may fail with "undefined". */
+static int maybe_undef(const IrFunc *f, int v) {
+    v = res(f, v);
+    return v != IR_NONE && f->ins[v].undef;
+}
+
+/* Could evaluating this instruction stop the program with a runtime error? */
+static int can_raise(const IrFunc *f, int id) {
+    const IrInstr *in = &f->ins[id];
+    int ta = type_of(f, in->a);
+    int tb = type_of(f, in->b);
+
+    switch (in->op) {
+        case IR_CONST:
+        case IR_TRUTHY:
+        case IR_PHI:
+            return 0;
+        case IR_LOADVAR:
+            return 1;
+        case IR_UNARY:
+            return in->eop == OP_NEG && ta != TY_INT;
+        case IR_BINARY:
+            switch (in->eop) {
+                case OP_EQ: case OP_NE:
+                    return 0;
+                case OP_ADD:
+                    return !((ta == TY_INT && tb == TY_INT) || (ta == TY_STRING && tb == TY_STRING));
+                case OP_DIV: case OP_MOD: {
+                    int rb = res(f, in->b);
+                    if (ta != TY_INT || !is_const(f, rb) || tb != TY_INT) return 1;
+                    int d = f->ins[rb].lit->int_value;
+                    return d == 0 || d == -1;
+                }
+                default:
+                    return ta != TY_INT || tb != TY_INT;
+            }
+        case IR_IF:
+            if (!in->is_expr) return 1;
+            return region_can_raise(f, in->then_r) || region_can_raise(f, in->else_r);
+        default:
+            return 1;
+    }
+}
+
+static int region_can_raise(const IrFunc *f, const IrRegion *r) {
+    for (int i = 0; i < r->n; i++) {
+        int id = r->ids[i];
+        if (!f->ins[id].live) continue;
+        if (is_side_effect(&f->ins[id]) || can_raise(f, id)) return 1;
+    }
+    return 0;
+}
+
+static int region_has_live(const IrFunc *f, const IrRegion *r) {
+    for (int i = 0; i < r->n; i++) {
+        if (f->ins[r->ids[i]].live) return 1;
+    }
+    return 0;
+}
+
+/* ============================================================
+   Name -> value environments
+   ============================================================ */
+
+typedef struct {
+    const char *name;
+    int val;
+} Bind;
+
+typedef struct {
+    Bind *v;
+    int n, cap;
+} Env;
+
+static Bind* env_find(const Env *e, const char *name) {
+    for (int i = 0; i < e->n; i++) {
+        if (strcmp(e->v[i].name, name) == 0) return &e->v[i];
+    }
+    return NULL;
+}
+
+static int env_get(const Env *e, const char *name) {
+    Bind *b = env_find(e, name);
+    return b ? b->val : IR_NONE;
+}
+
+static int env_set(Env *e, const char *name, int val) {
+    Bind *b = env_find(e, name);
+    if (b) { b->val = val; return 1; }
+    if (e->n == e->cap) {
+        int cap = e->cap ? e->cap * 2 : 16;
+        Bind *p = (Bind*)realloc(e->v, (size_t)cap * sizeof(Bind));
+        if (!p) return 0;
+        e->v = p;
+        e->cap = cap;
+    }
+    e->v[e->n].name = name;
+    e->v[e->n].val = val;
+    e->n++;
+    return 1;
+}
+
+static int env_copy(Env *dst, const Env *src) {
+    memset(dst, 0, sizeof(*dst));
+    if (src->n == 0) return 1;
+    dst->v = (Bind*)malloc((size_t)src->n * sizeof(Bind));
+    if (!dst->v) return 0;
+    memcpy(dst->v, src->v, (size_t)src->n * sizeof(Bind));
+    dst->n = dst->cap = src->n;
+    return 1;
+}
+
+static void env_free(Env *e) {
+    free(e->v);
+    memset(e, 0, sizeof(*e));
+}
+
+/* ============================================================
+   Construction (AST -> SSA)
+   ============================================================ */
+
+static int build_expr(IrFunc *f, IrRegion *r, Env *env, const Expr *e);
+
+static int build_logical(IrFunc *f, IrRegion *r, Env *env, const Expr *e) {
+    int is_and = (e->as.binary.op == OP_AND);
+    int cond = build_expr(f, r, env, e->as.binary.lhs);
+
+    int id = new_instr(f, r, IR_IF, e->line, e->col);
+    IrRegion *tr = new_region(f);
+    IrRegion *er = new_region(f);
+    if (id == IR_NONE || !tr || !er) return IR_NONE;
+
+    f->ins[id].a = cond;
+    set_use(f, id, 0, e->as.binary.lhs);
+    f->ins[id].is_expr = 1;
+    f->ins[id].then_r = tr;
+    f->ins[id].else_r = er;
+
+    /* loads inside the lazy operand must not leak into the outer scope */
+    Env local;
+    if (!env_copy(&local, env)) { f->failed = 1; return IR_NONE; }
+
+    IrRegion *lazy = is_and ? tr : er;
+    IrRegion *fixed = is_and ? er : tr;
+
+    int v = build_expr(f, lazy, &local, e->as.binary.rhs);
+    LiteralValue fixed_lit;
+    memset(&fixed_lit, 0, sizeof(fixed_lit));
+    fixed_lit.lit_kind = LIT_BOOL;
+    fixed_lit.int_value = is_and ? 0 : 1;
+
+    int t = new_instr(f, lazy, IR_TRUTHY, e->line, e->col);
+    int c = new_const(f, fixed, &fixed_lit, e->line, e->col);
+    env_free(&local);
+    if (t == IR_NONE || c == IR_NONE) return IR_NONE;
+
+    f->ins[t].a = v;
+    set_use(f, t, 0, e->as.binary.rhs);
+
+    int p = new_instr(f, r, IR_PHI, e->line, e->col);
+    if (p == IR_NONE) return IR_NONE;
+    f->ins[p].owner = id;
+    f->ins[p].a = is_and ? t : c;
+    f->ins[p].b = is_and ? c : t;
+    return p;
+}
+
+static int build_expr(IrFunc *f, IrRegion *r, Env *env, const Expr *e) {
+    if (!e || f->failed) { f->failed = 1; return IR_NONE; }
+
+    switch (e->kind) {
+        case EXPR_LITERAL: {
+            return new_const(f, r, &e->as.lit, e->line, e->col);
+        }
+
+        case EXPR_VAR: {
+            /* a variable that may be unassigned is read explicitly, at
+               this point, so the error keeps its place */
+            int v = env_get(env, e->as.var.name);
+            if (v != IR_NONE && !maybe_undef(f, v)) return v;
+            int id = new_instr(f, r, IR_LOADVAR, e->line, e->col);
+            if (id == IR_NONE) return IR_NONE;
+            f->ins[id].name = e->as.var.name;
+            if (!env_set(env, e->as.var.name, id)) f->failed = 1;
+            return id;
+        }
+
+        case EXPR_UNARY: {
+            int a = build_expr(f, r, env, e->as.unary.rhs);
+            int id = new_instr(f, r, IR_UNARY, e->line, e->col);
+            if (id == IR_NONE) return IR_NONE;
+            f->ins[id].eop = e->as.unary.op;
+            f->ins[id].a = a;
+            set_use(f, id, 0, e->as.unary.rhs);
+            return id;
+        }
+
+        case EXPR_BINARY: {
+            if (e->as.binary.op == OP_AND || e->as.binary.op == OP_OR) {
+                return build_logical(f, r, env, e);
+            }
+            int a = build_expr(f, r, env, e->as.binary.lhs);
+            int b = build_expr(f, r, env, e->as.binary.rhs);
+            int id = new_instr(f, r, IR_BINARY, e->line, e->col);
+            if (id == IR_NONE) return IR_NONE;
+            f->ins[id].eop = e->as.binary.op;
+            f->ins[id].a = a;
+            f->ins[id].b = b;
+            set_use(f, id, 0, e->as.binary.lhs);
+            set_use(f, id, 1, e->as.binary.rhs);
+            return id;
+        }
+
+        default:
+            f->failed = 1;
+            return IR_NONE;
+    }
+}
+
+static void build_block(IrFunc *f, IrRegion *r, Env *env, Env *stored, const Stmt *s);
+
+static int expr_reads(const Expr *e, const char *name) {
+    if (!e) return 0;
+    switch (e->kind) {
+        case EXPR_VAR:    return strcmp(e->as.var.name, name) == 0;
+        case EXPR_UNARY:  return expr_reads(e->as.unary.rhs, name);
+        case EXPR_BINARY: return expr_reads(e->as.binary.lhs, name) ||
+                                 expr_reads(e->as.binary.rhs, name);
+        default:          return 0;
+    }
+}
+
+
+static void build_if(IrFunc *f, IrRegion *r, Env *env, Env *stored,
+                     const IfBranch *b, int line, int col) {
+    int cond = build_expr(f, r, env, b->cond);
+
+    int id = new_instr(f, r, IR_IF, line, col);
+    IrRegion *tr = new_region(f);
+    IrRegion *er = new_region(f);
+    if (id == IR_NONE || !tr || !er) return;
+
+    f->ins[id].a = cond;
+    set_use(f, id, 0, b->cond);
+    f->ins[id].then_r = tr;
+    f->ins[id].else_r = er;
+
+    Env tenv, eenv;
+    Env tst = {0}, est = {0};
+    if (!env_copy(&tenv, env) || !env_copy(&eenv, env)) { f->failed = 1; return; }
+
+    build_block(f, tr, &tenv, &tst, b->body);
+
+    const IfBranch *nx = b->next;
+    if (nx && nx->cond == NULL) {
+        build_block(f, er, &eenv, &est, nx->body);
+    } else if (nx) {
+        build_if(f, er, &eenv, &est, nx, nx->cond->line, nx->cond->col);
+    }
+
+    /* one phi per variable either side may redefine */
+    for (int side = 0; side < 2 && !f->failed; side++) {
+        Env *st = side ? &est : &tst;
+        for (int i = 0; i < st->n; i++) {
+            const char *name = st->v[i].name;
+            if (side && env_find(&tst, name)) continue;
+
+            int p = new_instr(f, r, IR_PHI, line, col);
+            if (p == IR_NONE) break;
+            f->ins[p].name = name;
+            f->ins[p].owner = id;
+            f->ins[p].a = env_get(&tenv, name);
+            f->ins[p].b = env_get(&eenv, name);
+            f->ins[p].undef = f->ins[p].a == IR_NONE || f->ins[p].b == IR_NONE ||
+                              maybe_undef(f, f->ins[p].a) || maybe_undef(f, f->ins[p].b);
+            if (!env_set(env, name, p) || !env_set(stored, name, 1)) f->failed = 1;
+        }
+    }
+
+    env_free(&tenv);
+    env_free(&eenv);
+    env_free(&tst);
+    env_free(&est);
+}
+
+static void build_block(IrFunc *f, IrRegion *r, Env *env, Env *stored, const Stmt *s) {
+    for (; s && !f->failed; s = s->next) {
+        switch (s->kind) {
+            case STMT_IMPORT: {
+                int id = new_instr(f, r, IR_IMPORT, s->line, s->col);
+                if (id != IR_NONE) f->ins[id].name = s->module;
+                break;
+            }
+
+            case STMT_ASSIGN: {
+                /* the runtime creates the target (as nulla) before it
+                   evaluates the value, so `x = x ...` reads nulla or the
+                   old value instead of raising */
+                if (expr_reads(s->value, s->target)) {
+                    int old = env_get(env, s->target);
+                    if (old == IR_NONE) {
+                        LiteralValue null_lit;
+                        memset(&null_lit, 0, sizeof(null_lit));
+                        null_lit.lit_kind = LIT_NULL;
+                        old = new_const(f, r, &null_lit, s->line, s->col);
+                        if (old == IR_NONE) break;
+                        if (!env_set(env, s->target, old)) f->failed = 1;
+                    } else if (maybe_undef(f, old)) {
+                        f->failed = 1;
+                        break;
+                    }
+                }
+                int v = build_expr(f, r, env, s->value);
+                int id = new_instr(f, r, IR_STORE, s->line, s->col);
+                if (id == IR_NONE) break;
+                f->ins[id].name = s->target;
+                f->ins[id].a = v;
+                set_use(f, id, 0, s->value);
+                if (!env_set(env, s->target, v) || !env_set(stored, s->target, 1)) f->failed = 1;
+                break;
+            }
+
+            case STMT_CALL_PRINT: {
+                int v = build_expr(f, r, env, s->arg);
+                int id = new_instr(f, r, IR_PRINT, s->line, s->col);
+                if (id != IR_NONE) {
+                    f->ins[id].name = s->callee;
+                    f->ins[id].a = v;
+                    set_use(f, id, 0, s->arg);
+                }
+                break;
+            }
+
+            case STMT_IF:
+                if (!s->if_branches) { f->failed = 1; break; }
+                build_if(f, r, env, stored, s->if_branches, s->line, s->col);
+                break;
+
+            default:
+                f->failed = 1;
+                break;
+        }
+    }
+}
+
+/* ============================================================
+   Passes
+   ============================================================ */
+
+static int typeprop_region(IrFunc *f, IrRegion *r) {
+    int changed = 0;
+
+    for (int i = 0; i < r->n; i++) {
+        int id = r->ids[i];
+        IrInstr *in = &f->ins[id];
+        if (!in->live) continue;
+
+        int ta = type_of(f, in->a);
+        int tb = type_of(f, in->b);
+        int t = TY_ANY;
+
+        switch (in->op) {
+            case IR_CONST:   t = lit_type(in->lit); break;
+            case IR_LOADVAR: t = TY_ANY; break;
+            case IR_TRUTHY:  t = TY_BOOL; break;
+            case IR_UNARY:   t = in->eop == OP_NOT ? TY_BOOL : TY_INT; break;
+            case IR_BINARY:
+                switch (in->eop) {
+                    case OP_ADD:
+                        t = 0;
+                        if ((ta & TY_INT) && (tb & TY_INT)) t |= TY_INT;
+                        if ((ta & TY_STRING) && (tb & TY_STRING)) t |= TY_STRING;
+                        break;
+                    case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+                        t = TY_INT;
+                        break;
+                    default:
+                        t = TY_BOOL;
+                        break;
+                }
+                break;
+            case IR_PHI:
+                /* an undefined side contributes nothing: reading it raises */
+                t = (in->a == IR_NONE ? 0 : ta) | (in->b == IR_NONE ? 0 : tb);
+                break;
+            case IR_IF:
+                changed |= typeprop_region(f, in->then_r);
+                changed |= typeprop_region(f, in->else_r);
+                continue;
+            default:
+                continue;
+        }
+
+        if (in->type != t) {
+            in->type = t;
+            changed = 1;
+        }
+    }
+    return changed;
+}
+
+static int pass_typeprop(IrFunc *f) {
+    return typeprop_region(f, f->body);
+}
+
+static void to_const(IrFunc *f, int id, const LiteralValue *v) {
+    if (!set_lit(f, id, v)) return;
+    f->ins[id].a = f->ins[id].b = IR_NONE;
+}
+
+/* si/aliosi with a constant condition: splice the taken region in place. */
+static int fold_if_const(IrFunc *f, IrRegion *r, int i) {
+    int id = r->ids[i];
+    IrInstr *in = &f->ins[id];
+    int cond = res(f, in->a);
+    int take = opt_lit_truthy(f->ins[cond].lit);
+    IrRegion *keep = take ? in->then_r : in->else_r;
+    IrRegion *drop = take ? in->else_r : in->then_r;
+
+    /* a variable left undefined on the taken path has no value to forward */
+    int k;
+    for (k = i + 1; k < r->n && f->ins[r->ids[k]].owner == id; k++) {
+        const IrInstr *p = &f->ins[r->ids[k]];
+        if (p->live && p->op == IR_PHI && (take ? p->a : p->b) == IR_NONE) return 0;
+    }
+    int end = k;
+
+    int n = r->n - 1 + keep->n;
+    int *ids = (int*)malloc((size_t)(n > 0 ? n : 1) * sizeof(int));
+    if (!ids) { f->failed = 1; return 0; }
+
+    for (k = i + 1; k < end; k++) {
+        IrInstr *p = &f->ins[r->ids[k]];
+        if (p->live && p->op == IR_PHI) forward_to(f, r->ids[k], res(f, take ? p->a : p->b));
+    }
+
+    kill_region(f, drop);
+    f->ins[id].live = 0;
+
+    memcpy(ids, r->ids, (size_t)i * sizeof(int));
+    if (keep->n) memcpy(ids + i, keep->ids, (size_t)keep->n * sizeof(int));
+    memcpy(ids + i + keep->n, r->ids + i + 1, (size_t)(r->n - i - 1) * sizeof(int));
+    free(r->ids);
+    r->ids = ids;
+    r->n = r->cap = n;
+    keep->n = 0;
+    return 1;
+}
+
+static int fold_region(IrFunc *f, IrRegion *r) {
+    int changed = 0;
+
+    for (int i = 0; i < r->n; i++) {
+        int id = r->ids[i];
+        if (!f->ins[id].live) continue;
+
+        IrInstr *in = &f->ins[id];
+        int a = res(f, in->a);
+        int b = res(f, in->b);
+        LiteralValue out;
+
+        switch (in->op) {
+            case IR_UNARY:
+                if (is_const(f, a) && opt_fold_unary(in->eop, f->ins[a].lit, &out)) {
+                    to_const(f, id, &out);
+                    changed = 1;
+                }
+                break;
+
+            case IR_BINARY:
+                if (is_const(f, a) && is_const(f, b) &&
+                    opt_fold_binary(in->eop, f->ins[a].lit, f->ins[b].lit, &out)) {
+                    to_const(f, id, &out);
+                    changed = 1;
+                    break;
+                }
+                /* values of different kinds are never equal */
+                if (in->eop == OP_EQ || in->eop == OP_NE) {
+                    int ta = type_of(f, a), tb = type_of(f, b);
+                    if (ta && tb && !(ta & tb)) {
+                        memset(&out, 0, sizeof(out));
+                        out.lit_kind = LIT_BOOL;
+                        out.int_value = (in->eop == OP_NE);
+                        to_const(f, id, &out);
+                        changed = 1;
+                    }
+                }
+                break;
+
+            case IR_TRUTHY:
+                if (is_const(f, a)) {
+                    memset(&out, 0, sizeof(out));
+                    out.lit_kind = LIT_BOOL;
+                    out.int_value = opt_lit_truthy(f->ins[a].lit);
+                    to_const(f, id, &out);
+                    changed = 1;
+                } else if (type_of(f, a) == TY_BOOL) {
+                    forward_to(f, id, a);
+                    changed = 1;
+                }
+                break;
+
+            case IR_IF:
+                /* `if` already tests truthiness */
+                if (a != IR_NONE && f->ins[a].op == IR_TRUTHY) {
+                    copy_use(f, id, a, 0);
+                    in->a = res(f, f->ins[a].a);
+                    a = in->a;
+                    changed = 1;
+                }
+                if (is_const(f, a) && fold_if_const(f, r, i)) {
+                    changed = 1;
+                    i--;        /* revisit the spliced instructions */
+                    break;
+                }
+                changed |= fold_region(f, f->ins[id].then_r);
+                changed |= fold_region(f, f->ins[id].else_r);
+                break;
+
+            case IR_PHI: {
+                if (a == b && a != IR_NONE) {
+                    forward_to(f, id, a);
+                    changed = 1;
+                    break;
+                }
+                if (is_const(f, a) && is_const(f, b) &&
+                    opt_lits_equal(f->ins[a].lit, f->ins[b].lit)) {
+                    to_const(f, id, f->ins[a].lit);
+                    changed = 1;
+                    break;
+                }
+                if (in->name[0]) break;
+
+                /* et/aut whose lazy side folded away */
+                int cond = res(f, f->ins[in->owner].a);
+                if (is_const_bool(f, a, 1) && is_const_bool(f, b, 0)) {
+                    in->op = IR_TRUTHY;
+                    in->a = cond;
+                    in->b = IR_NONE;
+                    copy_use(f, id, in->owner, 0);
+                    changed = 1;
+                } else if (is_const_bool(f, a, 0) && is_const_bool(f, b, 1)) {
+                    in->op = IR_UNARY;
+                    in->eop = OP_NOT;
+                    in->a = cond;
+                    in->b = IR_NONE;
+                    copy_use(f, id, in->owner, 0);
+                    changed = 1;
+                }
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+    return changed;
+}
+
+static int pass_fold(IrFunc *f) {
+    return fold_region(f, f->body);
+}
+
+/* Available expressions: a chained hash table whose entries are pushed
+   and popped in region order, so a lookup only sees values that dominate
+   the current point (defined earlier in this or an enclosing region). */
+typedef struct {
+    int id;
+    int next;
+} CseEntry;
+
+typedef struct {
+    int *heads;
+    unsigned mask;
+    CseEntry *e;
+    int n, cap;
+} CseTable;
+
+static unsigned expr_hash(const IrFunc *f, int id) {
+    const IrInstr *in = &f->ins[id];
+    unsigned h = (unsigned)in->op * 2654435761u;
+    if (in->op == IR_CONST) {
+        h ^= (unsigned)in->lit->lit_kind * 31u + (unsigned)in->lit->int_value;
+        if (in->lit->lit_kind == LIT_STRING) {
+            for (const char *p = in->lit->text; *p; p++) h = h * 31u + (unsigned char)*p;
+        }
+        return h;
+    }
+    h = (h ^ (unsigned)in->eop) * 16777619u;
+    h = (h ^ (unsigned)res(f, in->a)) * 16777619u;
+    h = (h ^ (unsigned)res(f, in->b)) * 16777619u;
+    return h;
+}
+
+static int same_expr(const IrFunc *f, int x, int y) {
+    const IrInstr *a = &f->ins[x];
+    const IrInstr *b = &f->ins[y];
+    if (a->op != b->op) return 0;
+    if (a->op == IR_CONST) return opt_lits_equal(a->lit, b->lit);
+    return a->eop == b->eop && res(f, a->a) == res(f, b->a) && res(f, a->b) == res(f, b->b);
+}
+
+static int cse_region(IrFunc *f, IrRegion *r, CseTable *t) {
+    int changed = 0;
+    int mark = t->n;
+
+    for (int i = 0; i < r->n; i++) {
+        int id = r->ids[i];
+        IrInstr *in = &f->ins[id];
+        if (!in->live) continue;
+
+        if (in->op == IR_IF) {
+            changed |= cse_region(f, in->then_r, t);
+            changed |= cse_region(f, in->else_r, t);
+            continue;
+        }
+
+        if (in->op != IR_CONST && in->op != IR_UNARY &&
+            in->op != IR_BINARY && in->op != IR_TRUTHY) continue;
+
+        unsigned b = expr_hash(f, id) & t->mask;
+        int hit = IR_NONE;
+        for (int k = t->heads[b]; k >= 0; k = t->e[k].next) {
+            if (same_expr(f, t->e[k].id, id)) { hit = t->e[k].id; break; }
+        }
+        if (hit != IR_NONE) {
+            forward_to(f, id, hit);
+            changed = 1;
+            continue;
+        }
+
+        if (t->n == t->cap) {
+            int cap = t->cap ? t->cap * 2 : 64;
+            CseEntry *p = (CseEntry*)realloc(t->e, (size_t)cap * sizeof(CseEntry));
+            if (!p) { f->failed = 1; break; }
+            t->e = p;
+            t->cap = cap;
+        }
+        t->e[t->n].id = id;
+        t->e[t->n].next = t->heads[b];
+        t->heads[b] = t->n++;
+    }
+
+    /* leaving the region: entries come off in reverse, each at its chain head */
+    while (t->n > mark) {
+        t->n--;
+        unsigned b = expr_hash(f, t->e[t->n].id) & t->mask;
+        t->heads[b] = t->e[t->n].next;
+    }
+    return changed;
+}
+
+static int pass_cse(IrFunc *f) {
+    CseTable t;
+    memset(&t, 0, sizeof(t));
+
+    unsigned nb = 64;
+    while (nb < (unsigned)f->n * 2u) nb <<= 1;
+    t.heads = (int*)malloc(nb * sizeof(int));
+    if (!t.heads) { f->failed = 1; return 0; }
+    memset(t.heads, 0xff, nb * sizeof(int));
+    t.mask = nb - 1;
+
+    int changed = cse_region(f, f->body, &t);
+    free(t.heads);
+    free(t.e);
+    return changed;
+}
+
+static void count_uses(const IrFunc *f, int *uses, int skip_stmt_phis) {
+    memset(uses, 0, (size_t)f->n * sizeof(int));
+    for (int id = 0; id < f->n; id++) {
+        const IrInstr *in = &f->ins[id];
+        if (!in->live) continue;
+        if (skip_stmt_phis && is_stmt_phi(in)) continue;
+        int a = res(f, in->a), b = res(f, in->b);
+        if (a != IR_NONE) uses[a]++;
+        if (b != IR_NONE) uses[b]++;
+    }
+}
+
+static int pass_dce(IrFunc *f) {
+    int *uses = (int*)malloc((size_t)f->n * sizeof(int));
+    int *phis = (int*)malloc((size_t)f->n * sizeof(int));
+    if (!uses || !phis) { free(uses); free(phis); f->failed = 1; return 0; }
+
+    int changed = 0;
+    int again = 1;
+    while (again) {
+        again = 0;
+        count_uses(f, uses, 0);
+        memset(phis, 0, (size_t)f->n * sizeof(int));
+        for (int id = 0; id < f->n; id++) {
+            if (f->ins[id].live && f->ins[id].op == IR_PHI) phis[f->ins[id].owner]++;
+        }
+
+        for (int id = f->n - 1; id >= 0; id--) {
+            IrInstr *in = &f->ins[id];
+            if (!in->live) continue;
+
+            int dead = 0;
+            switch (in->op) {
+                case IR_CONST: case IR_UNARY: case IR_BINARY:
+                case IR_TRUTHY: case IR_PHI:
+                    dead = uses[id] == 0 && !can_raise(f, id);
+                    break;
+                case IR_IF:
+                    if (in->is_expr) {
+                        dead = phis[id] == 0 && !can_raise(f, id);
+                    } else {
+                        dead = phis[id] == 0 &&
+                               !region_has_live(f, in->then_r) &&
+                               !region_has_live(f, in->else_r);
+                    }
+                    break;
+                default:
+                    break;
+            }
+
+            if (dead) {
+                kill(f, id);
+                again = 1;
+                changed = 1;
+            }
+        }
+    }
+
+    free(uses);
+    free(phis);
+    return changed;
+}
+
+typedef struct {
+    const char *name;
+    int (*run)(IrFunc *f);
+} IrPass;
+
+static const IrPass ir_pipeline[] = {
+    { "typeprop", pass_typeprop },
+    { "fold",     pass_fold },
+    { "cse",      pass_cse },
+    { "dce",      pass_dce },
+};
+
+#define IR_MAX_ROUNDS 8
+
+void ir_optimize(IrFunc *f) {
+    if (!f || f->failed) return;
+
+    for (int round = 0; round < IR_MAX_ROUNDS; round++) {
+        int changed = 0;
+        for (size_t i = 0; i < sizeof(ir_pipeline) / sizeof(ir_pipeline[0]); i++) {
+            changed |= ir_pipeline[i].run(f);
+            compact_region(f, f->body);
+            if (f->failed) return;
+        }
+        if (!changed) break;
+    }
+    pass_typeprop(f);
+}
+
+/* ============================================================
+   Dump
+   ============================================================ */
+
+static const char* ir_op_name(ExprOp op) {
+    switch (op) {
+        case OP_ADD: return "add";
+        case OP_SUB: return "sub";
+        case OP_MUL: return "mul";
+        case OP_DIV: return "div";
+        case OP_MOD: return "mod";
+        case OP_EQ:  return "eq";
+        case OP_NE:  return "ne";
+        case OP_LT:  return "lt";
+        case OP_LE:  return "le";
+        case OP_GT:  return "gt";
+        case OP_GE:  return "ge";
+        case OP_NOT: return "not";
+        case OP_NEG: return "neg";
+        default:     return "?";
+    }
+}
+
+static void dump_type(int t, FILE *out) {
+    static const char *names[] = { "int", "string", "bool", "nulla" };
+    if (t == TY_ANY) { fprintf(out, "  : any"); return; }
+    if (t == 0) { fprintf(out, "  : never"); return; }
+    fprintf(out, "  :");
+    const char *sep = " ";
+    for (int i = 0; i < 4; i++) {
+        if (t & (1 << i)) { fprintf(out, "%s%s", sep, names[i]); sep = "|"; }
+    }
+}
+
+static void dump_operand(int id, FILE *out) {
+    if (id == IR_NONE) fprintf(out, "undef");
+    else fprintf(out, "%%%d", id);
+}
+
+static void dump_region(const IrFunc *f, const IrRegion *r, int ind, FILE *out) {
+    for (int i = 0; i < r->n; i++) {
+        int id = r->ids[i];
+        const IrInstr *in = &f->ins[id];
+        if (!in->live) continue;
+
+        fprintf(out, "%*s", ind, "");
+        switch (in->op) {
+            case IR_CONST:
+                fprintf(out, "%%%d = const ", id);
+                if (in->lit->lit_kind == LIT_INT) fprintf(out, "%d", in->lit->int_value);
+                else if (in->lit->lit_kind == LIT_BOOL) fprintf(out, "%s", in->lit->int_value ? "verum" : "falsum");
+                else if (in->lit->lit_kind == LIT_STRING) fprintf(out, "\"%s\"", in->lit->text);
+                else fprintf(out, "nulla");
+                break;
+            case IR_LOADVAR:
+                fprintf(out, "%%%d = load %s", id, in->name);
+                break;
+            case IR_UNARY:
+                fprintf(out, "%%%d = %s ", id, ir_op_name(in->eop));
+                dump_operand(in->a, out);
+                break;
+            case IR_BINARY:
+                fprintf(out, "%%%d = %s ", id, ir_op_name(in->eop));
+                dump_operand(in->a, out);
+                fprintf(out, ", ");
+                dump_operand(in->b, out);
+                break;
+            case IR_TRUTHY:
+                fprintf(out, "%%%d = truthy ", id);
+                dump_operand(in->a, out);
+                break;
+            case IR_PHI:
+                fprintf(out, "%%%d = phi%s%s [", id, in->name[0] ? " " : "", in->name);
+                dump_operand(in->a, out);
+                fprintf(out, ", ");
+                dump_operand(in->b, out);
+                fprintf(out, "]");
+                break;
+            case IR_IF:
+                fprintf(out, "if ");
+                dump_operand(in->a, out);
+                fprintf(out, "%s  ; #%d\n", in->is_expr ? " (et/aut)" : "", id);
+                fprintf(out, "%*sthen:\n", ind, "");
+                dump_region(f, in->then_r, ind + 4, out);
+                fprintf(out, "%*selse:\n", ind, "");
+                dump_region(f, in->else_r, ind + 4, out);
+                continue;
+            case IR_STORE:
+                fprintf(out, "store %s, ", in->name);
+                dump_operand(in->a, out);
+                break;
+            case IR_PRINT:
+                fprintf(out, "print ");
+                dump_operand(in->a, out);
+                break;
+            case IR_IMPORT:
+                fprintf(out, "import %s", in->name);
+                break;
+        }
+
+        if (in->op == IR_CONST || in->op == IR_LOADVAR || in->op == IR_UNARY ||
+            in->op == IR_BINARY || in->op == IR_TRUTHY || in->op == IR_PHI) {
+            dump_type(in->type, out);
+        }
+        fprintf(out, "\n");
+    }
+}
+
+void ir_dump(const IrFunc *f, FILE *out) {
+    if (!f) return;
+    fprintf(out, "entry:\n");
+    dump_region(f, f->body, 2, out);
+}
+
+/* ============================================================
+   Lowering (SSA -> AST)
+
+   Single-use values are rebuilt into expression trees at their use;
+   everything else lives in a variable: the user variable that currently
+   holds it, or a compiler temporary named "%<id>" (not a valid Noema
+   identifier, so it cannot clash). Values that may raise keep their
+   original evaluation order.
+   ============================================================ */
+
+enum {
+    M_NONE = 0,     /* statement, or value with no code of its own */
+    M_LEAF,         /* constant / phi: rendered from a literal or a variable */
+    M_INLINE,       /* rendered into its only consumer */
+    M_MAT,          /* computed into a temporary where it is defined */
+    M_DEAD          /* unused and harmless */
+};
+
+typedef struct {
+    const IrFunc *f;
+    int *uses;              /* uses not rendered yet (statement phis excluded) */
+    int *consumer;          /* first consumer in program order */
+    int *pos;               /* program order */
+    int *seg;               /* straight-line segment ending at a statement */
+    int *segroot;           /* segment -> the statement ending it */
+    const IrRegion **reg;   /* region holding the instruction */
+    int *phi;               /* IF -> its value phi (et/aut) */
+    unsigned char *mode;
+    unsigned char *done;    /* inline value already rendered */
+    char (*tmp)[16];        /* temporary holding a value, "" if none */
+    int *tmpk;              /* its number, -1 if none */
+    int *pool;              /* numbers free for reuse */
+    int npool;
+    int *pending;           /* freed by the statement being built */
+    int npending;
+    int ntmp;               /* distinct temporaries so far */
+    int nextpos, nextseg;
+    int failed;
+} Lower;
+
+typedef struct {
+    Stmt *head, *tail;
+} SList;
+
+static void number_region(Lower *L, const IrRegion *r) {
+    const IrFunc *f = L->f;
+    int seg = L->nextseg++;
+
+    for (int i = 0; i < r->n; i++) {
+        int id = r->ids[i];
+        const IrInstr *in = &f->ins[id];
+        if (!in->live) continue;
+
+        L->pos[id] = L->nextpos++;
+        L->seg[id] = seg;
+        L->reg[id] = r;
+
+        int a = res(f, in->a), b = res(f, in->b);
+        if (!is_stmt_phi(in)) {
+            if (a != IR_NONE && L->consumer[a] == IR_NONE) L->consumer[a] = id;
+            if (b != IR_NONE && L->consumer[b] == IR_NONE) L->consumer[b] = id;
+        }
+        if (in->op == IR_PHI && !in->name[0]) L->phi[in->owner] = id;
+
+        if (in->op == IR_IF) {
+            number_region(L, in->then_r);
+            number_region(L, in->else_r);
+        }
+        if (is_side_effect(in)) {
+            L->segroot[seg] = id;
+            seg = L->nextseg++;
+        }
+    }
+}
+
+/* The consumer of an et/aut `if` is the consumer of its value. */
+static int cons_of(const Lower *L, int id) {
+    const IrInstr *in = &L->f->ins[id];
+    if (in->op == IR_IF && in->is_expr) {
+        int p = L->phi[id];
+        return p == IR_NONE ? IR_NONE : L->consumer[p];
+    }
+    return L->consumer[id];
+}
+
+/* May `v` be rendered directly into consumer `c`? */
+static int same_tree(const Lower *L, int v, int c) {
+    const IrFunc *f = L->f;
+    if (c == IR_NONE) return 0;
+    const IrInstr *ci = &f->ins[c];
+    if (ci->op == IR_PHI && !ci->name[0]) {
+        const IrInstr *owner = &f->ins[ci->owner];
+        if (res(f, ci->a) == v) return L->reg[v] == owner->then_r;
+        return L->reg[v] == owner->else_r;
+    }
+    return L->seg[c] == L->seg[v];
+}
+
+static int logical_shape(const Lower *L, int ifid) {
+    const IrFunc *f = L->f;
+    int p = L->phi[ifid];
+    if (p == IR_NONE) return 0;
+    int a = res(f, f->ins[p].a), b = res(f, f->ins[p].b);
+    if (is_const_bool(f, b, 0) && type_of(f, a) == TY_BOOL) return OP_AND;
+    if (is_const_bool(f, a, 1) && type_of(f, b) == TY_BOOL) return OP_OR;
+    return 0;
+}
+
+static int region_is_tree(const Lower *L, const IrRegion *r) {
+    for (int i = 0; i < r->n; i++) {
+        int id = r->ids[i];
+        if (!L->f->ins[id].live) continue;
+        if (is_side_effect(&L->f->ins[id]) || L->mode[id] == M_MAT) return 0;
+    }
+    return 1;
+}
+
+/* Position at which an inline value will actually be evaluated. */
+static int emit_pos(const Lower *L, int v) {
+    const IrFunc *f = L->f;
+    int x = v;
+    while (L->mode[x] == M_INLINE) {
+        int c = cons_of(L, x);
+        if (c == IR_NONE) return L->pos[x];
+        if (f->ins[c].op == IR_PHI && !f->ins[c].name[0] && L->reg[c] != L->reg[x]) return INT_MAX;
+        if (f->ins[c].op == IR_PHI && !f->ins[c].name[0]) c = f->ins[c].owner;
+        x = c;
+    }
+    return L->pos[x];
+}
+
+static void plan_region(Lower *L, const IrRegion *r) {
+    const IrFunc *f = L->f;
+
+    for (int i = 0; i < r->n; i++) {
+        int id = r->ids[i];
+        const IrInstr *in = &f->ins[id];
+        if (in->live && in->op == IR_IF) {
+            plan_region(L, in->then_r);
+            plan_region(L, in->else_r);
+        }
+    }
+
+    for (int i = 0; i < r->n; i++) {
+        int id = r->ids[i];
+        const IrInstr *in = &f->ins[id];
+        if (!in->live) continue;
+
+        switch (in->op) {
+            case IR_CONST:
+                L->mode[id] = M_LEAF;
+                break;
+
+            case IR_PHI:
+                if (in->name[0]) L->mode[id] = M_LEAF;
+                else L->mode[id] = L->mode[in->owner];
+                break;
+
+            case IR_LOADVAR: {
+                /* `x = ...x...` reads the freshly created x, not the load */
+                int root = L->segroot[L->seg[id]];
+                int self = root != IR_NONE && f->ins[root].op == IR_STORE &&
+                           strcmp(f->ins[root].name, in->name) == 0;
+                int one = L->uses[id] == 1 && same_tree(L, id, L->consumer[id]);
+                L->mode[id] = one && !self ? M_INLINE : M_MAT;
+                break;
+            }
+
+            case IR_UNARY: case IR_BINARY: case IR_TRUTHY:
+                if (L->uses[id] == 0) L->mode[id] = can_raise(f, id) ? M_MAT : M_DEAD;
+                else if (same_tree(L, id, L->consumer[id]) &&
+                         (L->uses[id] == 1 || f->ins[L->consumer[id]].op == IR_STORE))
+                    L->mode[id] = M_INLINE;     /* a store becomes the home of later uses */
+                else L->mode[id] = M_MAT;
+                break;
+
+            case IR_IF:
+                if (!in->is_expr) break;
+                {
+                    int p = L->phi[id];
+                    int ok = p != IR_NONE && L->uses[p] == 1 &&
+                             same_tree(L, p, L->consumer[p]) &&
+                             logical_shape(L, id) &&
+                             region_is_tree(L, in->then_r) &&
+                             region_is_tree(L, in->else_r);
+                    L->mode[id] = ok ? M_INLINE : M_MAT;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+static void make_mat(Lower *L, int v) {
+    L->mode[v] = M_MAT;
+    if (L->f->ins[v].op == IR_IF && L->phi[v] != IR_NONE) L->mode[L->phi[v]] = M_MAT;
+    if (L->f->ins[v].op == IR_PHI && !L->f->ins[v].name[0]) L->mode[L->f->ins[v].owner] = M_MAT;
+}
+
+/* Post-order walk of the tree rendered for `v`: values that may raise
+   must come out in program order. */
+static int walk_tree(Lower *L, int v, int from, int *maxpos) {
+    const IrFunc *f = L->f;
+    v = res(f, v);
+    if (v == IR_NONE || L->mode[v] != M_INLINE || L->consumer[v] != from) return 0;
+
+    const IrInstr *in = &f->ins[v];
+    int changed = 0;
+
+    if (in->op == IR_PHI) {
+        const IrInstr *owner = &f->ins[in->owner];
+        changed |= walk_tree(L, owner->a, in->owner, maxpos);
+        changed |= walk_tree(L, logical_shape(L, in->owner) == OP_AND ? in->a : in->b, v, maxpos);
+    } else {
+        changed |= walk_tree(L, in->a, v, maxpos);
+        changed |= walk_tree(L, in->b, v, maxpos);
+    }
+
+    if (can_raise(f, v)) {
+        if (L->pos[v] < *maxpos) {
+            make_mat(L, v);
+            changed = 1;
+        } else {
+            *maxpos = L->pos[v];
+        }
+    }
+    return changed;
+}
+
+static int fix_region(Lower *L, const IrRegion *r) {
+    const IrFunc *f = L->f;
+    int changed = 0;
+
+    for (int i = 0; i < r->n; i++) {
+        int id = r->ids[i];
+        const IrInstr *in = &f->ins[id];
+        if (!in->live) continue;
+
+        if (in->op == IR_IF) {
+            changed |= fix_region(L, in->then_r);
+            changed |= fix_region(L, in->else_r);
+            if (in->is_expr && L->mode[id] == M_INLINE &&
+                (!region_is_tree(L, in->then_r) || !region_is_tree(L, in->else_r))) {
+                make_mat(L, id);
+                changed = 1;
+            }
+        }
+
+        /* roots of rendered trees */
+        int maxpos = -1;
+        if (is_side_effect(in) || (L->mode[id] == M_MAT && in->op != IR_PHI)) {
+            changed |= walk_tree(L, in->a, id, &maxpos);
+            if (in->op != IR_IF) changed |= walk_tree(L, in->b, id, &maxpos);
+        }
+        if (in->op == IR_PHI && !in->name[0] && L->mode[id] == M_MAT) {
+            changed |= walk_tree(L, in->a, id, &maxpos);
+            maxpos = -1;
+            changed |= walk_tree(L, in->b, id, &maxpos);
+        }
+
+        /* a value that may raise must not be evaluated after a later
+           materialized value */
+        if (L->mode[id] == M_INLINE && can_raise(f, id)) {
+            int e = emit_pos(L, id);
+            for (int k = i + 1; k < r->n; k++) {
+                int m = r->ids[k];
+                if (!f->ins[m].live || L->mode[m] != M_MAT) continue;
+                if (L->pos[m] < e && L->seg[m] == L->seg[id]) {
+                    make_mat(L, id);
+                    changed = 1;
+                    break;
+                }
+            }
+        }
+    }
+    return changed;
+}
+
+static void fix_order(Lower *L) {
+    while (fix_region(L, L->f->body)) {
+    }
+}
+
+static Expr* mk_expr(Lower *L, ExprKind kind, int line, int col) {
+    Expr *e = (Expr*)calloc(1, sizeof(Expr));
+    if (!e) { L->failed = 1; return NULL; }
+    e->kind = kind;
+    e->line = line;
+    e->col = col;
+    return e;
+}
+
+static Expr* mk_lit(Lower *L, const LiteralValue *v, int line, int col) {
+    Expr *e = mk_expr(L, EXPR_LITERAL, line, col);
+    if (e) e->as.lit = *v;
+    return e;
+}
+
+static Expr* mk_var(Lower *L, const char *name, int line, int col) {
+    Expr *e = mk_expr(L, EXPR_VAR, line, col);
+    if (e) {
+        strncpy(e->as.var.name, name, NOEMA_TOKEN_VALUE_MAX - 1);
+        e->as.var.name[NOEMA_TOKEN_VALUE_MAX - 1] = '\0';
+    }
+    return e;
+}
+
+static Expr* mk_unary(Lower *L, ExprOp op, Expr *rhs, int line, int col) {
+    Expr *e = mk_expr(L, EXPR_UNARY, line, col);
+    if (!e) { parser_free_expr(rhs); return NULL; }
+    e->as.unary.op = op;
+    e->as.unary.rhs = rhs;
+    return e;
+}
+
+static Expr* mk_binary(Lower *L, ExprOp op, Expr *lhs, Expr *rhs, int line, int col) {
+    Expr *e = mk_expr(L, EXPR_BINARY, line, col);
+    if (!e) { parser_free_expr(lhs); parser_free_expr(rhs); return NULL; }
+    e->as.binary.op = op;
+    e->as.binary.lhs = lhs;
+    e->as.binary.rhs = rhs;
+    return e;
+}
+
+static Stmt* mk_stmt(Lower *L, SList *out, StmtKind kind, int line, int col) {
+    Stmt *s = (Stmt*)calloc(1, sizeof(Stmt));
+    if (!s) { L->failed = 1; return NULL; }
+    s->kind = kind;
+    s->line = line;
+    s->col = col;
+    if (!out->head) out->head = s;
+    else out->tail->next = s;
+    out->tail = s;
+    return s;
+}
+
+/* Temporaries are variables to the runtime and count toward its limit,
+   so a number goes back to the pool once the value it held has no uses
+   left. It is reused only from the next statement on: the statement
+   that read it last may not be emitted yet. */
+static const char* tmp_name(Lower *L, int id) {
+    if (!L->tmp[id][0]) {
+        int k = L->npool ? L->pool[--L->npool] : L->ntmp++;
+        L->tmpk[id] = k;
+        snprintf(L->tmp[id], sizeof(L->tmp[id]), "%%%d", k);
+    }
+    return L->tmp[id];
+}
+
+static void tmp_release(Lower *L, int id) {
+    if (L->tmpk[id] < 0 || L->uses[id] > 0) return;
+    L->pending[L->npending++] = L->tmpk[id];
+    L->tmpk[id] = -1;
+}
+
+static void tmp_flush(Lower *L) {
+    while (L->npending) L->pool[L->npool++] = L->pending[--L->npending];
+}
+
+static const char* home_of(const Env *env, int v) {
+    for (int i = env->n - 1; i >= 0; i--) {
+        if (env->v[i].val == v) return env->v[i].name;
+    }
+    return NULL;
+}
+
+static Expr* render(Lower *L, Env *env, int v, int line, int col);
+
+static Expr* render_logical(Lower *L, Env *env, int ifid) {
+    const IrFunc *f = L->f;
+    const IrInstr *in = &f->ins[ifid];
+    const IrInstr *p = &f->ins[L->phi[ifid]];
+    int is_and = logical_shape(L, ifid) == OP_AND;
+
+    Expr *lhs = render(L, env, in->a, in->uline[0], in->ucol[0]);
+
+    const IrRegion *lazy = is_and ? in->then_r : in->else_r;
+    int y = res(f, is_and ? p->a : p->b);
+
+    Env local;
+    if (!env_copy(&local, env)) { L->failed = 1; parser_free_expr(lhs); return NULL; }
+    for (int i = 0; i < lazy->n; i++) {
+        const IrInstr *li = &f->ins[lazy->ids[i]];
+        if (li->live && li->op == IR_LOADVAR) env_set(&local, li->name, lazy->ids[i]);
+    }
+
+    /* et/aut already take the truthiness of their operand */
+    int line = f->ins[y].line, col = f->ins[y].col;
+    if (f->ins[y].op == IR_TRUTHY && L->mode[y] == M_INLINE && !L->done[y]) {
+        L->done[y] = 1;
+        L->uses[y]--;
+        line = f->ins[y].uline[0];
+        col = f->ins[y].ucol[0];
+        y = res(f, f->ins[y].a);
+    }
+    Expr *rhs = render(L, &local, y, line, col);
+    env_free(&local);
+
+    return mk_binary(L, is_and ? OP_AND : OP_OR, lhs, rhs, in->line, in->col);
+}
+
+/* The instruction's own computation. */
+static Expr* render_def(Lower *L, Env *env, int v) {
+    const IrInstr *in = &L->f->ins[v];
+
+    switch (in->op) {
+        case IR_CONST:
+            return mk_lit(L, in->lit, in->line, in->col);
+        case IR_LOADVAR:
+            return mk_var(L, in->name, in->line, in->col);
+        case IR_UNARY:
+            return mk_unary(L, in->eop, render(L, env, in->a, in->uline[0], in->ucol[0]),
+                            in->line, in->col);
+        case IR_BINARY: {
+            Expr *lhs = render(L, env, in->a, in->uline[0], in->ucol[0]);
+            Expr *rhs = render(L, env, in->b, in->uline[1], in->ucol[1]);
+            return mk_binary(L, in->eop, lhs, rhs, in->line, in->col);
+        }
+        case IR_TRUTHY:
+            return mk_unary(L, OP_NOT,
+                            mk_unary(L, OP_NOT, render(L, env, in->a, in->uline[0], in->ucol[0]),
+                                     in->line, in->col),
+                            in->line, in->col);
+        case IR_PHI:
+            return render_logical(L, env, in->owner);
+        default:
+            L->failed = 1;
+            return NULL;
+    }
+}
+
+/* A use of value `v`. */
+static Expr* render(Lower *L, Env *env, int v, int line, int col) {
+    const IrFunc *f = L->f;
+    v = res(f, v);
+    if (v == IR_NONE) { L->failed = 1; return NULL; }
+
+    const IrInstr *in = &f->ins[v];
+    L->uses[v]--;
+    tmp_release(L, v);
+
+    if (in->op == IR_CONST) return mk_lit(L, in->lit, in->line, in->col);
+
+    if (L->mode[v] == M_INLINE && !L->done[v]) {
+        L->done[v] = 1;
+        return render_def(L, env, v);
+    }
+
+    const char *home = home_of(env, v);
+    if (!home) { L->failed = 1; return NULL; }
+    return mk_var(L, home, line, col);
+}
+
+static void emit_assign(Lower *L, SList *out, const char *target, Expr *value, int line, int col) {
+    Stmt *s = mk_stmt(L, out, STMT_ASSIGN, line, col);
+    if (!s) { parser_free_expr(value); return; }
+    strncpy(s->target, target, NOEMA_TOKEN_VALUE_MAX - 1);
+    s->value = value;
+}
+
+static void materialize(Lower *L, Env *env, SList *out, int v) {
+    const IrInstr *in = &L->f->ins[v];
+    Expr *e = render_def(L, env, v);
+    const char *name = tmp_name(L, v);
+    emit_assign(L, out, name, e, in->line, in->col);
+    if (!env_set(env, name, v)) L->failed = 1;
+    tmp_release(L, v);      /* kept only for the error it may raise */
+}
+
+/* `name` is about to be overwritten: save its value if still needed. */
+static void spill(Lower *L, Env *env, SList *out, const char *name) {
+    const IrFunc *f = L->f;
+    int w = env_get(env, name);
+    if (w == IR_NONE || f->ins[w].op == IR_CONST || L->uses[w] <= 0) return;
+
+    if (maybe_undef(f, w)) { L->failed = 1; return; }
+
+    for (int i = 0; i < env->n; i++) {
+        if (env->v[i].val == w && strcmp(env->v[i].name, name) != 0) return;
+    }
+
+    const char *t = tmp_name(L, w);
+    emit_assign(L, out, t, mk_var(L, name, f->ins[w].line, f->ins[w].col),
+                f->ins[w].line, f->ins[w].col);
+    if (!env_set(env, t, w)) L->failed = 1;
+}
+
+static void spill_stores(Lower *L, Env *env, SList *out, const IrRegion *r) {
+    const IrFunc *f = L->f;
+    for (int i = 0; i < r->n; i++) {
+        const IrInstr *in = &f->ins[r->ids[i]];
+        if (!in->live) continue;
+        if (in->op == IR_STORE) spill(L, env, out, in->name);
+        if (in->op == IR_IF) {
+            spill_stores(L, env, out, in->then_r);
+            spill_stores(L, env, out, in->else_r);
+        }
+    }
+}
+
+static void lower_region(Lower *L, const IrRegion *r, Env *env, SList *out);
+
+static void add_branch(Lower *L, Stmt *s, IfBranch **tail, Expr *cond, Stmt *body) {
+    IfBranch *b = (IfBranch*)calloc(1, sizeof(IfBranch));
+    if (!b) {
+        L->failed = 1;
+        parser_free_expr(cond);
+        parser_free_program(body);
+        return;
+    }
+    b->cond = cond;
+    b->body = body;
+    if (*tail) (*tail)->next = b;
+    else s->if_branches = b;
+    *tail = b;
+}
+
+/* Emits `si cond: then alio: else`, folding a lone nested `si` in the
+   else part back into an aliosi chain. `value` (may be IR_NONE) is the
+   et/aut result assigned to its temporary at the end of each side. */
+static void emit_if(Lower *L, SList *out, int id, Expr *cond, int value,
+                    Env *tenv, Env *eenv) {
+    const IrFunc *f = L->f;
+    const IrInstr *in = &f->ins[id];
+
+    Stmt *s = mk_stmt(L, out, STMT_IF, in->line, in->col);
+    if (!s) { parser_free_expr(cond); return; }
+
+    SList tl = {0}, el = {0};
+    lower_region(L, in->then_r, tenv, &tl);
+    lower_region(L, in->else_r, eenv, &el);
+
+    if (value != IR_NONE) {
+        const IrInstr *p = &f->ins[value];
+        const char *t = tmp_name(L, value);
+        emit_assign(L, &tl, t, render(L, tenv, p->a, p->line, p->col), p->line, p->col);
+        emit_assign(L, &el, t, render(L, eenv, p->b, p->line, p->col), p->line, p->col);
+    }
+
+    IfBranch *tail = NULL;
+    add_branch(L, s, &tail, cond, tl.head);
+
+    if (el.head && el.head == el.tail && el.head->kind == STMT_IF) {
+        Stmt *inner = el.head;
+        if (tail) tail->next = inner->if_branches;
+        inner->if_branches = NULL;
+        parser_free_program(inner);
+    } else if (el.head) {
+        add_branch(L, s, &tail, NULL, el.head);
+    }
+}
+
+static void lower_if(Lower *L, const IrRegion *r, int i, Env *env, SList *out) {
+    const IrFunc *f = L->f;
+    int id = r->ids[i];
+    const IrInstr *in = &f->ins[id];
+
+    Env tenv, eenv;
+
+    if (in->is_expr) {
+        if (L->mode[id] != M_MAT) return;
+        if (!env_copy(&tenv, env) || !env_copy(&eenv, env)) { L->failed = 1; return; }
+        int p = L->phi[id];
+        emit_if(L, out, id, render(L, env, in->a, in->uline[0], in->ucol[0]), p, &tenv, &eenv);
+        if (p != IR_NONE) {
+            if (!env_set(env, tmp_name(L, p), p)) L->failed = 1;
+            tmp_release(L, p);
+        }
+        env_free(&tenv);
+        env_free(&eenv);
+        return;
+    }
+
+    Expr *cond = render(L, env, in->a, in->uline[0], in->ucol[0]);
+    spill_stores(L, env, out, in->then_r);
+    spill_stores(L, env, out, in->else_r);
+
+    if (!env_copy(&tenv, env) || !env_copy(&eenv, env)) {
+        L->failed = 1;
+        parser_free_expr(cond);
+        return;
+    }
+    emit_if(L, out, id, cond, IR_NONE, &tenv, &eenv);
+
+    /* after the merge a variable holds a known value only if both sides agree */
+    for (int side = 0; side < 2; side++) {
+        Env *se = side ? &eenv : &tenv;
+        for (int k = 0; k < se->n; k++) {
+            const char *name = se->v[k].name;
+            if (name[0] == '%') continue;
+            int tv = env_get(&tenv, name), ev = env_get(&eenv, name);
+            int before = env_get(env, name);
+            if (tv == before && ev == before) continue;
+            if (!env_set(env, name, tv == ev ? tv : IR_NONE)) L->failed = 1;
+        }
+    }
+    env_free(&tenv);
+    env_free(&eenv);
+}
+
+static void lower_region(Lower *L, const IrRegion *r, Env *env, SList *out) {
+    const IrFunc *f = L->f;
+
+    for (int i = 0; i < r->n && !L->failed; i++) {
+        int id = r->ids[i];
+        const IrInstr *in = &f->ins[id];
+        if (!in->live) continue;
+        tmp_flush(L);
+
+        switch (in->op) {
+            case IR_CONST:
+                break;
+
+            case IR_LOADVAR:
+                if (!env_set(env, in->name, id)) L->failed = 1;
+                if (L->mode[id] == M_MAT) materialize(L, env, out, id);
+                break;
+
+            case IR_UNARY: case IR_BINARY: case IR_TRUTHY:
+                if (L->mode[id] == M_MAT) materialize(L, env, out, id);
+                break;
+
+            case IR_PHI:
+                if (in->name[0] && !env_set(env, in->name, id)) L->failed = 1;
+                break;
+
+            case IR_IF:
+                lower_if(L, r, i, env, out);
+                break;
+
+            case IR_STORE: {
+                Expr *e = render(L, env, in->a, in->uline[0], in->ucol[0]);
+                spill(L, env, out, in->name);
+                emit_assign(L, out, in->name, e, in->line, in->col);
+                if (!env_set(env, in->name, res(f, in->a))) L->failed = 1;
+                break;
+            }
+
+            case IR_PRINT: {
+                Expr *e = render(L, env, in->a, in->uline[0], in->ucol[0]);
+                Stmt *s = mk_stmt(L, out, STMT_CALL_PRINT, in->line, in->col);
+                if (s) {
+                    s->callee = in->name;
+                    s->arg = e;
+                }
+                else parser_free_expr(e);
+                break;
+            }
+
+            case IR_IMPORT: {
+                Stmt *s = mk_stmt(L, out, STMT_IMPORT, in->line, in->col);
+                if (s) strcpy(s->module, in->name);
+                break;
+            }
+        }
+    }
+}
+
+#define LOWER_MAX_VARS 1000     /* the runtime's variable limit */
+
+/* Would the lowered program need more variables than the runtime has?
+   Every variable the source assigns (the stores of dead branches too,
+   so an error the source would hit is not lost) plus the temporaries. */
+static int too_many_vars(const Lower *L) {
+    const IrFunc *f = L->f;
+    Env names = {0};
+    int over = 0;
+    for (int id = 0; id < f->n && !over; id++) {
+        if (f->ins[id].op != IR_STORE || env_find(&names, f->ins[id].name)) continue;
+        if (!env_set(&names, f->ins[id].name, id)) over = 1;
+        else over = names.n + L->ntmp > LOWER_MAX_VARS;
+    }
+    env_free(&names);
+    return over;
+}
+
+int ir_lower(const IrFunc *f, Stmt **out) {
+    *out = NULL;
+    if (!f || f->failed) return 0;
+
+    size_t n = (size_t)(f->n > 0 ? f->n : 1);
+    Lower L;
+    memset(&L, 0, sizeof(L));
+    L.f = f;
+    L.uses = (int*)calloc(n, sizeof(int));
+    L.consumer = (int*)malloc(n * sizeof(int));
+    L.pos = (int*)calloc(n, sizeof(int));
+    L.seg = (int*)calloc(n, sizeof(int));
+    L.segroot = (int*)malloc(n * sizeof(int));
+    L.reg = (const IrRegion**)calloc(n, sizeof(*L.reg));
+    L.phi = (int*)malloc(n * sizeof(int));
+    L.mode = (unsigned char*)calloc(n, 1);
+    L.done = (unsigned char*)calloc(n, 1);
+    L.tmp = calloc(n, sizeof(*L.tmp));
+    L.tmpk = (int*)malloc(n * sizeof(int));
+    L.pool = (int*)malloc(n * sizeof(int));
+    L.pending = (int*)malloc(n * sizeof(int));
+
+    SList list = {0};
+    Env env = {0};
+
+    if (!L.uses || !L.consumer || !L.pos || !L.seg || !L.segroot || !L.reg || !L.phi ||
+        !L.mode || !L.done || !L.tmp || !L.tmpk || !L.pool || !L.pending) {
+        L.failed = 1;
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            L.consumer[i] = IR_NONE;
+            L.phi[i] = IR_NONE;
+            L.segroot[i] = IR_NONE;
+            L.tmpk[i] = -1;
+        }
+        count_uses(f, L.uses, 1);
+        number_region(&L, f->body);
+        plan_region(&L, f->body);
+        fix_order(&L);
+        lower_region(&L, f->body, &env, &list);
+        if (!L.failed && too_many_vars(&L)) L.failed = 1;
+    }
+
+    env_free(&env);
+    free(L.uses);
+    free(L.consumer);
+    free(L.pos);
+    free(L.seg);
+    free(L.segroot);
+    free(L.reg);
+    free(L.phi);
+    free(L.mode);
+    free(L.done);
+    free(L.tmp);
+    free(L.tmpk);
+    free(L.pool);
+    free(L.pending);
+
+    if (L.failed) {
+        parser_free_program(list.head);
+        return 0;
+    }
+    *out = list.head;
+    return 1;
+}
+
+/* ============================================================
+   Public API
+   ============================================================ */
+
+IrFunc* ir_build(const Stmt *program) {
+    IrFunc *f = (IrFunc*)calloc(1, sizeof(IrFunc));
+    if (!f) return NULL;
+
+    f->body = new_region(f);
+
+    Env env = {0}, stored = {0};
+    if (f->body) build_block(f, f->body, &env, &stored, program);
+    env_free(&env);
+    env_free(&stored);
+
+    if (f->failed) {
+        ir_free(f);
+        return NULL;
+    }
+    pass_typeprop(f);
+    return f;
+}
+
+void ir_free(IrFunc *f) {
+    if (!f) return;
+    for (int i = 0; i < f->n; i++) free(f->ins[i].lit);
+    for (int i = 0; i < f->nregions; i++) {
+        free(f->regions[i]->ids);
+        free(f->regions[i]);
+    }
+    free(f->regions);
+    free(f->ins);
+    free(f);
+}
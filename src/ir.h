@@ -0,0 +1,46 @@
+// src/ir.h
+#ifndef NOEMA_IR_H
+#define NOEMA_IR_H
+
+#include <stdio.h>
+
+#include "parser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+   Mid-level IR (SSA).
+
+   Values are numbered instructions; variables are renamed to the value
+   they hold, and control flow is kept structured: an `if` owns a then/else
+   region (its basic blocks) and is followed by one `phi` per variable it
+   may redefine. `et`/`aut` become expression-level ifs so their right
+   operand stays lazily evaluated.
+*/
+
+typedef struct IrFunc IrFunc;
+
+/* Returns NULL when the program uses a construct the IR does not model;
+   callers then keep executing the AST as is. The IR refers to names in
+   `program`, which must outlive it. */
+IrFunc* ir_build(const Stmt *program);
+void    ir_free(IrFunc *f);
+
+/* Pass manager: runs typeprop, fold, cse and dce until nothing changes. */
+void    ir_optimize(IrFunc *f);
+
+void    ir_dump(const IrFunc *f, FILE *out);
+
+/* Lowers back to a statement list for the tree evaluator. Temporaries
+   become `%N` variables, reused once dead. Returns 1 on success (*out
+   may be NULL for an empty program), 0 if the result could need more
+   variables than the runtime allows. */
+int     ir_lower(const IrFunc *f, Stmt **out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,915 @@
+// src/jit.c
+#define _DEFAULT_SOURCE
+#include "jit.h"
+#include "runtime.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) && defined(__unix__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define JIT_X86_64 1
+#endif
+
+/* Without loops a statement runs at most once per runtime_exec, so a unit
+   only pays off when the same runtime executes the same program again
+   and again (rule records, batches). Compiling one costs about as much
+   as interpreting it 15 times, so it is compiled once it has run that
+   often: never more than twice the cost of the right choice up front. */
+#define JIT_HOT_RUNS 16
+
+/* Units share executable chunks of this size (larger units get their own). */
+#define JIT_CHUNK_SIZE (64 * 1024)
+
+/* ============================================================
+   Units and the cache
+   ============================================================ */
+
+typedef void (*JitFn)(void *vars, int *live);
+
+typedef struct {
+    int slot;
+    int kind;               /* VAL_INT or VAL_BOOL required at entry */
+} JitGuard;
+
+typedef enum {
+    UNIT_COLD = 0,
+    UNIT_NONE,              /* nothing compilable starts here */
+    UNIT_STAGED,            /* compiled, not yet executable */
+    UNIT_READY
+} UnitState;
+
+typedef struct JitUnit {
+    const Stmt *first;
+    UnitState state;
+    int runs;
+
+    const Stmt *end;        /* first statement not covered */
+    JitFn fn;               /* in one of the cache's chunks */
+
+    JitGuard *guards;
+    int nguards;
+    int *writes;            /* slots the unit may assign */
+    int nwrites;
+
+    struct JitUnit *chain;
+} JitUnit;
+
+typedef struct CodeChunk {
+    unsigned char *mem;
+    size_t size, used;
+    size_t sealed;          /* [0, sealed) is RX, the rest RW */
+    struct CodeChunk *next;
+} CodeChunk;
+
+struct JitCache {
+    JitLayout lay;
+    JitUnit **buckets;
+    size_t nbuckets;
+    size_t count;
+    CodeChunk *chunks;      /* newest first; units are added to the head */
+    JitUnit **staged;       /* waiting for seal_staged() */
+    int nstaged, capstaged;
+    int broken;             /* the OS refused executable memory */
+};
+
+static void unit_free(JitUnit *u) {
+    free(u->guards);
+    free(u->writes);
+    free(u);
+}
+
+static size_t ptr_hash(const void *p) {
+    uintptr_t x = (uintptr_t)p;
+    x ^= x >> 17;
+    x *= (uintptr_t)0x9E3779B97F4A7C15ull;
+    x ^= x >> 29;
+    return (size_t)x;
+}
+
+JitCache* jit_cache_create(const JitLayout *layout) {
+#ifdef JIT_X86_64
+    if (!layout) return NULL;
+    JitCache *c = (JitCache*)calloc(1, sizeof(JitCache));
+    if (!c) return NULL;
+    c->lay = *layout;
+    c->nbuckets = 64;
+    c->buckets = (JitUnit**)calloc(c->nbuckets, sizeof(JitUnit*));
+    if (!c->buckets) { free(c); return NULL; }
+    return c;
+#else
+    (void)layout;
+    return NULL;
+#endif
+}
+
+void jit_cache_clear(JitCache *c) {
+    if (!c) return;
+    for (size_t i = 0; i < c->nbuckets; i++) {
+        JitUnit *u = c->buckets[i];
+        while (u) {
+            JitUnit *next = u->chain;
+            unit_free(u);
+            u = next;
+        }
+        c->buckets[i] = NULL;
+    }
+    c->count = 0;
+    c->nstaged = 0;
+
+    while (c->chunks) {
+        CodeChunk *next = c->chunks->next;
+#ifdef JIT_X86_64
+        munmap(c->chunks->mem, c->chunks->size);
+#endif
+        free(c->chunks);
+        c->chunks = next;
+    }
+}
+
+void jit_cache_destroy(JitCache *c) {
+    if (!c) return;
+    jit_cache_clear(c);
+    free(c->staged);
+    free(c->buckets);
+    free(c);
+}
+
+static void cache_grow(JitCache *c) {
+    size_t n = c->nbuckets * 2;
+    JitUnit **b = (JitUnit**)calloc(n, sizeof(JitUnit*));
+    if (!b) return;
+    for (size_t i = 0; i < c->nbuckets; i++) {
+        JitUnit *u = c->buckets[i];
+        while (u) {
+            JitUnit *next = u->chain;
+            size_t h = ptr_hash(u->first) & (n - 1);
+            u->chain = b[h];
+            b[h] = u;
+            u = next;
+        }
+    }
+    free(c->buckets);
+    c->buckets = b;
+    c->nbuckets = n;
+}
+
+static JitUnit* find_unit(const JitCache *c, const Stmt *s) {
+    size_t h = ptr_hash(s) & (c->nbuckets - 1);
+    for (JitUnit *u = c->buckets[h]; u; u = u->chain) {
+        if (u->first == s) return u;
+    }
+    return NULL;
+}
+
+static JitUnit* cache_unit(JitCache *c, const Stmt *s) {
+    JitUnit *u = find_unit(c, s);
+    if (u) return u;
+
+    size_t h = ptr_hash(s) & (c->nbuckets - 1);
+    u = (JitUnit*)calloc(1, sizeof(JitUnit));
+    if (!u) return NULL;
+    u->first = s;
+    u->chain = c->buckets[h];
+    c->buckets[h] = u;
+    if (++c->count > c->nbuckets * 2) cache_grow(c);
+    return u;
+}
+
+#ifdef JIT_X86_64
+
+/* ============================================================
+   Code buffer
+   ============================================================ */
+
+typedef struct {
+    unsigned char *p;
+    size_t n, cap;
+    int oom;
+} Code;
+
+static void emit(Code *c, const void *bytes, size_t n) {
+    if (c->oom) return;
+    if (c->n + n > c->cap) {
+        size_t cap = c->cap ? c->cap * 2 : 256;
+        while (cap < c->n + n) cap *= 2;
+        unsigned char *p = (unsigned char*)realloc(c->p, cap);
+        if (!p) { c->oom = 1; return; }
+        c->p = p;
+        c->cap = cap;
+    }
+    memcpy(c->p + c->n, bytes, n);
+    c->n += n;
+}
+
+static void emit1(Code *c, int b) {
+    unsigned char x = (unsigned char)b;
+    emit(c, &x, 1);
+}
+
+static void emit4(Code *c, int32_t v) {
+    unsigned char b[4];
+    uint32_t u = (uint32_t)v;
+    for (int i = 0; i < 4; i++) b[i] = (unsigned char)(u >> (8 * i));
+    emit(c, b, 4);
+}
+
+static void patch4(Code *c, size_t at, int32_t v) {
+    if (c->oom) return;
+    uint32_t u = (uint32_t)v;
+    for (int i = 0; i < 4; i++) c->p[at + i] = (unsigned char)(u >> (8 * i));
+}
+
+/* ============================================================
+   Templates
+   rdi = slot array, rsi = &live; rax/rcx/rdx scratch; operands on the
+   native stack, one 8-byte push per value (low 32 bits significant).
+   ============================================================ */
+
+static void t_push_imm(Code *c, int v)       { emit1(c, 0x68); emit4(c, v); }
+static void t_push_rax(Code *c)              { emit1(c, 0x50); }
+static void t_pop_rax(Code *c)               { emit1(c, 0x58); }
+static void t_pop_rcx(Code *c)               { emit1(c, 0x59); }
+
+static void t_load(Code *c, int32_t disp) {
+    static const unsigned char op[] = { 0x8B, 0x87 };         /* mov eax,[rdi+d32] */
+    emit(c, op, 2); emit4(c, disp);
+    t_push_rax(c);
+}
+
+static void t_setcc(Code *c, int cc) {
+    unsigned char op[] = { 0x0F, (unsigned char)(0x90 | cc), 0xC0,   /* setcc al */
+                           0x0F, 0xB6, 0xC0 };                      /* movzx eax,al */
+    emit(c, op, sizeof(op));
+}
+
+enum { CC_E = 0x4, CC_NE = 0x5, CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF };
+
+static void t_test_rax(Code *c) {
+    static const unsigned char op[] = { 0x85, 0xC0 };         /* test eax,eax */
+    emit(c, op, 2);
+}
+
+/* Emits a rel32 jump and returns the offset of its displacement. */
+static size_t t_jz(Code *c) {
+    static const unsigned char op[] = { 0x0F, 0x84 };
+    emit(c, op, 2);
+    size_t at = c->n;
+    emit4(c, 0);
+    return at;
+}
+
+static size_t t_jmp(Code *c) {
+    emit1(c, 0xE9);
+    size_t at = c->n;
+    emit4(c, 0);
+    return at;
+}
+
+static void bind_here(Code *c, size_t at) {
+    patch4(c, at, (int32_t)(c->n - (at + 4)));
+}
+
+static void t_store(Code *c, const JitLayout *lay, int slot, int kind) {
+    int32_t base = (int32_t)((size_t)slot * lay->stride);
+    static const unsigned char mov_int[]  = { 0x89, 0x87 };   /* mov [rdi+d32],eax */
+    static const unsigned char mov_imm[]  = { 0xC7, 0x87 };   /* mov dword [rdi+d32],imm32 */
+    static const unsigned char cmp_zero[] = { 0x83, 0xBF };   /* cmp dword [rdi+d32],0 */
+    static const unsigned char inc_live[] = { 0xFF, 0x06 };   /* inc dword [rsi] */
+
+    t_pop_rax(c);
+    emit(c, mov_int, 2); emit4(c, base + (int32_t)lay->off_int);
+    emit(c, mov_imm, 2); emit4(c, base + (int32_t)lay->off_kind); emit4(c, kind);
+
+    /* first assignment creates the variable */
+    emit(c, cmp_zero, 2); emit4(c, base + (int32_t)lay->off_in_use); emit1(c, 0x00);
+    emit1(c, 0x75); emit1(c, 12);                              /* jne over the next 12 bytes */
+    emit(c, mov_imm, 2); emit4(c, base + (int32_t)lay->off_in_use); emit4(c, 1);
+    emit(c, inc_live, 2);
+}
+
+/* ============================================================
+   Compiler
+   ============================================================ */
+
+enum { T_INT = 1, T_BOOL };                     /* expression result */
+enum { K_ENTRY = 0, K_INT, K_BOOL, K_UNKNOWN }; /* what a slot holds here */
+
+typedef struct {
+    int slot;
+    unsigned char old;
+} Undo;
+
+typedef struct {
+    int slot;
+    unsigned char k;
+} Change;
+
+typedef struct {
+    const JitLayout *lay;
+    const unsigned char *vars;
+    int nvars;
+    Code code;
+
+    unsigned char *known;       /* K_* per slot at the current point */
+    Undo *undo;
+    size_t nundo, capundo;
+
+    unsigned char *guard;       /* entry kind required per slot, or 0 */
+    JitGuard *guards;
+    int nguards, capguards;
+
+    unsigned char *written;
+    int *writes;
+    int nwrites, capwrites;
+
+    unsigned *stamp;            /* dedupe scratch for branch changes */
+    unsigned stamp_now;
+
+    int oom;
+} Jc;
+
+static void* grow(void *p, int *cap, size_t elem) {
+    int n = *cap ? *cap * 2 : 16;
+    void *q = realloc(p, (size_t)n * elem);
+    if (q) *cap = n;
+    return q;
+}
+
+static void set_known(Jc *j, int slot, unsigned char k) {
+    if (j->nundo == j->capundo) {
+        size_t cap = j->capundo ? j->capundo * 2 : 64;
+        Undo *u = (Undo*)realloc(j->undo, cap * sizeof(Undo));
+        if (!u) { j->oom = 1; return; }
+        j->undo = u;
+        j->capundo = cap;
+    }
+    j->undo[j->nundo].slot = slot;
+    j->undo[j->nundo].old = j->known[slot];
+    j->nundo++;
+    j->known[slot] = k;
+}
+
+static void undo_to(Jc *j, size_t mark) {
+    while (j->nundo > mark) {
+        j->nundo--;
+        j->known[j->undo[j->nundo].slot] = j->undo[j->nundo].old;
+    }
+}
+
+static const unsigned char* slot_ptr(const Jc *j, int slot) {
+    return j->vars + (size_t)slot * j->lay->stride;
+}
+
+/* Kind the slot must have on entry for the unit to run; picked from
+   its current value. 0 when it is not an int or bool right now. */
+static int entry_kind(Jc *j, int slot) {
+    if (j->guard[slot]) return j->guard[slot];
+
+    const unsigned char *v = slot_ptr(j, slot);
+    int in_use, kind;
+    memcpy(&in_use, v + j->lay->off_in_use, sizeof(int));
+    memcpy(&kind, v + j->lay->off_kind, sizeof(int));
+    if (!in_use || (kind != VAL_INT && kind != VAL_BOOL)) return 0;
+
+    if (j->nguards == j->capguards) {
+        JitGuard *g = (JitGuard*)grow(j->guards, &j->capguards, sizeof(JitGuard));
+        if (!g) { j->oom = 1; return 0; }
+        j->guards = g;
+    }
+    j->guards[j->nguards].slot = slot;
+    j->guards[j->nguards].kind = kind;
+    j->nguards++;
+    j->guard[slot] = (unsigned char)kind;
+    return kind;
+}
+
+static unsigned char resolve_known(Jc *j, int slot, unsigned char k) {
+    if (k != K_ENTRY) return k;
+    int kind = entry_kind(j, slot);
+    if (kind == VAL_INT) return K_INT;
+    if (kind == VAL_BOOL) return K_BOOL;
+    return K_UNKNOWN;
+}
+
+static int jc_expr(Jc *j, const Expr *e);
+
+static int jc_read(Jc *j, int slot) {
+    if (slot < 0 || slot >= j->nvars) return 0;
+    unsigned char k = resolve_known(j, slot, j->known[slot]);
+    if (k == K_INT) return T_INT;
+    if (k == K_BOOL) return T_BOOL;
+    return 0;
+}
+
+/* Leaves 0/1 in eax for the value on top of the stack. */
+static void t_truthy_pop(Code *c) {
+    t_pop_rax(c);
+    t_test_rax(c);
+    t_setcc(c, CC_NE);
+}
+
+static int jc_logic(Jc *j, const Expr *e) {
+    int is_and = e->as.binary.op == OP_AND;
+    if (!jc_expr(j, e->as.binary.lhs)) return 0;
+
+    t_pop_rax(&j->code);
+    t_test_rax(&j->code);
+    size_t shortcut;
+    if (is_and) {
+        shortcut = t_jz(&j->code);
+    } else {
+        static const unsigned char jnz[] = { 0x0F, 0x85 };
+        emit(&j->code, jnz, 2);
+        shortcut = j->code.n;
+        emit4(&j->code, 0);
+    }
+
+    if (!jc_expr(j, e->as.binary.rhs)) return 0;
+    t_truthy_pop(&j->code);
+    t_push_rax(&j->code);
+    size_t done = t_jmp(&j->code);
+
+    bind_here(&j->code, shortcut);
+    t_push_imm(&j->code, is_and ? 0 : 1);
+    bind_here(&j->code, done);
+    return T_BOOL;
+}
+
+/* Division/modulo by a literal, following the runtime's DivPlan; a
+   variable or zero divisor stays in the interpreter. */
+static int jc_div_const(Jc *j, const Expr *e) {
+    int plan = e->as.binary.div_plan;
+    if (plan != DIV_MAGIC && plan != DIV_SHIFT) return 0;
+    if (jc_expr(j, e->as.binary.lhs) != T_INT) return 0;
+
+    Code *c = &j->code;
+    int d = e->as.binary.rhs->as.lit.int_value;
+    static const unsigned char mov_eax_ecx[] = { 0x89, 0xC8 };
+    static const unsigned char mov_edx_eax[] = { 0x89, 0xC2 };
+    static const unsigned char add_eax_edx[] = { 0x01, 0xD0 };
+
+    t_pop_rcx(c);                                               /* n */
+    if (plan == DIV_MAGIC) {
+        int m = e->as.binary.div_magic, s = e->as.binary.div_shift;
+        static const unsigned char movsxd[] = { 0x48, 0x63, 0xC1 };     /* movsxd rax,ecx */
+        static const unsigned char imul[]   = { 0x48, 0x69, 0xC0 };     /* imul rax,rax,imm32 */
+        static const unsigned char sar32[]  = { 0x48, 0xC1, 0xF8, 32 }; /* sar rax,32 */
+        static const unsigned char add_n[]  = { 0x01, 0xC8 };
+        static const unsigned char sub_n[]  = { 0x29, 0xC8 };
+        static const unsigned char sign[]   = { 0xC1, 0xEA, 31 };       /* shr edx,31 */
+
+        emit(c, movsxd, sizeof(movsxd));
+        emit(c, imul, sizeof(imul)); emit4(c, m);
+        emit(c, sar32, sizeof(sar32));
+        if (d > 0 && m < 0) emit(c, add_n, sizeof(add_n));
+        if (d < 0 && m > 0) emit(c, sub_n, sizeof(sub_n));
+        if (s > 0) { emit1(c, 0xC1); emit1(c, 0xF8); emit1(c, s); }  /* sar eax,s */
+        emit(c, mov_edx_eax, sizeof(mov_edx_eax));
+        emit(c, sign, sizeof(sign));
+        emit(c, add_eax_edx, sizeof(add_eax_edx));
+    } else {
+        int k = e->as.binary.div_magic;
+        emit(c, mov_eax_ecx, sizeof(mov_eax_ecx));
+        if (k > 0) {
+            static const unsigned char sar_edx[] = { 0xC1, 0xFA, 31 };  /* sar edx,31 */
+            emit(c, mov_edx_eax, sizeof(mov_edx_eax));
+            emit(c, sar_edx, sizeof(sar_edx));
+            emit1(c, 0xC1); emit1(c, 0xEA); emit1(c, 32 - k);         /* shr edx,32-k */
+            emit(c, add_eax_edx, sizeof(add_eax_edx));
+            emit1(c, 0xC1); emit1(c, 0xF8); emit1(c, k);              /* sar eax,k */
+        }
+        if (d < 0) { emit1(c, 0xF7); emit1(c, 0xD8); }                /* neg eax */
+    }
+
+    if (e->as.binary.op == OP_MOD) {
+        static const unsigned char sub_q[] = { 0x29, 0xC1 };          /* sub ecx,eax */
+        emit1(c, 0x69); emit1(c, 0xC0); emit4(c, d);                  /* imul eax,eax,d */
+        emit(c, sub_q, sizeof(sub_q));
+        emit(c, mov_eax_ecx, sizeof(mov_eax_ecx));
+    }
+    t_push_rax(c);
+    return T_INT;
+}
+
+static int jc_binary(Jc *j, const Expr *e) {
+    ExprOp op = e->as.binary.op;
+    if (op == OP_AND || op == OP_OR) return jc_logic(j, e);
+    if (op == OP_DIV || op == OP_MOD) return jc_div_const(j, e);
+
+    int lt = jc_expr(j, e->as.binary.lhs);
+    if (!lt) return 0;
+    int rt = jc_expr(j, e->as.binary.rhs);
+    if (!rt) return 0;
+
+    Code *c = &j->code;
+    t_pop_rcx(c);
+    t_pop_rax(c);
+
+    static const unsigned char add[]  = { 0x01, 0xC8 };        /* add eax,ecx */
+    static const unsigned char sub[]  = { 0x29, 0xC8 };        /* sub eax,ecx */
+    static const unsigned char imul[] = { 0x0F, 0xAF, 0xC1 };  /* imul eax,ecx */
+    static const unsigned char cmp[]  = { 0x39, 0xC8 };        /* cmp eax,ecx */
+
+    switch (op) {
+        case OP_ADD: case OP_SUB: case OP_MUL:
+            if (lt != T_INT || rt != T_INT) return 0;
+            if (op == OP_ADD) emit(c, add, sizeof(add));
+            if (op == OP_SUB) emit(c, sub, sizeof(sub));
+            if (op == OP_MUL) emit(c, imul, sizeof(imul));
+            t_push_rax(c);
+            return T_INT;
+
+        case OP_EQ: case OP_NE:
+            if (lt != rt) return 0;
+            emit(c, cmp, sizeof(cmp));
+            t_setcc(c, op == OP_EQ ? CC_E : CC_NE);
+            t_push_rax(c);
+            return T_BOOL;
+
+        case OP_LT: case OP_LE: case OP_GT: case OP_GE: {
+            if (lt != T_INT || rt != T_INT) return 0;
+            int cc = op == OP_LT ? CC_L : op == OP_LE ? CC_LE : op == OP_GT ? CC_G : CC_GE;
+            emit(c, cmp, sizeof(cmp));
+            t_setcc(c, cc);
+            t_push_rax(c);
+            return T_BOOL;
+        }
+
+        default:
+            return 0;
+    }
+}
+
+static int jc_expr(Jc *j, const Expr *e) {
+    if (!e) return 0;
+    Code *c = &j->code;
+
+    switch (e->kind) {
+        case EXPR_LITERAL:
+            if (e->as.lit.lit_kind == LIT_INT) {
+                t_push_imm(c, e->as.lit.int_value);
+                return T_INT;
+            }
+            if (e->as.lit.lit_kind == LIT_BOOL) {
+                t_push_imm(c, e->as.lit.int_value ? 1 : 0);
+                return T_BOOL;
+            }
+            return 0;
+
+        case EXPR_VAR: {
+            int slot = e->as.var.slot;
+            int t = jc_read(j, slot);
+            if (!t) return 0;
+            t_load(c, (int32_t)((size_t)slot * j->lay->stride + j->lay->off_int));
+            return t;
+        }
+
+        case EXPR_UNARY: {
+            int t = jc_expr(j, e->as.unary.rhs);
+            if (!t) return 0;
+            if (e->as.unary.op == OP_NEG) {
+                static const unsigned char neg[] = { 0xF7, 0xD8 };  /* neg eax */
+                if (t != T_INT) return 0;
+                t_pop_rax(c);
+                emit(c, neg, sizeof(neg));
+                t_push_rax(c);
+                return T_INT;
+            }
+            if (e->as.unary.op == OP_NOT) {
+                t_pop_rax(c);
+                t_test_rax(c);
+                t_setcc(c, CC_E);
+                t_push_rax(c);
+                return T_BOOL;
+            }
+            return 0;
+        }
+
+        case EXPR_BINARY:
+            return jc_binary(j, e);
+
+        default:
+            return 0;
+    }
+}
+
+static int jc_block(Jc *j, const Stmt *s);
+
+static void note_write(Jc *j, int slot) {
+    if (j->written[slot]) return;
+    if (j->nwrites == j->capwrites) {
+        int *w = (int*)grow(j->writes, &j->capwrites, sizeof(int));
+        if (!w) { j->oom = 1; return; }
+        j->writes = w;
+    }
+    j->writes[j->nwrites++] = slot;
+    j->written[slot] = 1;
+}
+
+static int cmp_change(const void *a, const void *b) {
+    const Change *x = (const Change*)a, *y = (const Change*)b;
+    return (x->slot > y->slot) - (x->slot < y->slot);
+}
+
+/* Appends the slots the branch just compiled changed, with their final
+   kinds, then rolls the state back to `mark`. */
+static int take_changes(Jc *j, size_t mark, Change **out, int *n, int *cap) {
+    j->stamp_now++;
+    for (size_t i = mark; i < j->nundo; i++) {
+        int slot = j->undo[i].slot;
+        if (j->stamp[slot] == j->stamp_now) continue;
+        j->stamp[slot] = j->stamp_now;
+        if (*n == *cap) {
+            Change *c = (Change*)grow(*out, cap, sizeof(Change));
+            if (!c) { j->oom = 1; return 0; }
+            *out = c;
+        }
+        (*out)[*n].slot = slot;
+        (*out)[*n].k = j->known[slot];
+        (*n)++;
+    }
+    undo_to(j, mark);
+    return 1;
+}
+
+static int jc_if(Jc *j, const Stmt *s) {
+    Code *c = &j->code;
+    size_t mark = j->nundo;
+
+    Change *changes = NULL;
+    int nchanges = 0, capchanges = 0;
+    int paths = 0, has_else = 0;
+
+    size_t *ends = NULL;
+    int nends = 0, capends = 0;
+    int ok = 1;
+
+    for (IfBranch *b = s->if_branches; b && ok; b = b->next) {
+        size_t skip = 0;
+        if (b->cond) {
+            if (!jc_expr(j, b->cond)) { ok = 0; break; }
+            t_pop_rax(c);
+            t_test_rax(c);
+            skip = t_jz(c);
+        } else {
+            has_else = 1;
+        }
+
+        if (!jc_block(j, b->body)) { ok = 0; break; }
+        if (!take_changes(j, mark, &changes, &nchanges, &capchanges)) { ok = 0; break; }
+        paths++;
+
+        if (!b->cond) break;
+        if (b->next) {
+            if (nends == capends) {
+                size_t *e = (size_t*)grow(ends, &capends, sizeof(size_t));
+                if (!e) { j->oom = 1; ok = 0; break; }
+                ends = e;
+            }
+            ends[nends++] = t_jmp(c);
+        }
+        bind_here(c, skip);
+    }
+
+    if (ok) {
+        for (int i = 0; i < nends; i++) bind_here(c, ends[i]);
+        if (!has_else) paths++;           /* no branch taken */
+
+        /* join: a slot keeps its kind only if every path agrees */
+        qsort(changes, (size_t)nchanges, sizeof(Change), cmp_change);
+        for (int i = 0; i < nchanges; ) {
+            int slot = changes[i].slot, k = i;
+            unsigned char joined = resolve_known(j, slot, changes[i].k);
+            for (; k < nchanges && changes[k].slot == slot; k++) {
+                if (resolve_known(j, slot, changes[k].k) != joined) joined = K_UNKNOWN;
+            }
+            if (k - i < paths && resolve_known(j, slot, j->known[slot]) != joined) joined = K_UNKNOWN;
+            set_known(j, slot, joined);
+            i = k;
+        }
+    }
+
+    free(changes);
+    free(ends);
+    return ok && !j->oom;
+}
+
+static int jc_stmt(Jc *j, const Stmt *s) {
+    switch (s->kind) {
+        case STMT_IMPORT:
+            return 1;
+
+        case STMT_ASSIGN: {
+            int slot = s->target_slot;
+            if (slot < 0 || slot >= j->nvars) return 0;
+            int t = jc_expr(j, s->value);
+            if (!t) return 0;
+            int kind = t == T_INT ? VAL_INT : VAL_BOOL;
+            t_store(&j->code, j->lay, slot, kind);
+            set_known(j, slot, t == T_INT ? K_INT : K_BOOL);
+            note_write(j, slot);
+            return !j->oom;
+        }
+
+        case STMT_IF:
+            return jc_if(j, s);
+
+        default:
+            return 0;
+    }
+}
+
+static int jc_block(Jc *j, const Stmt *s) {
+    for (; s; s = s->next) {
+        if (!jc_stmt(j, s)) return 0;
+    }
+    return 1;
+}
+
+static size_t page_size(void) {
+    long page = sysconf(_SC_PAGESIZE);
+    return page > 0 ? (size_t)page : 4096;
+}
+
+/* Copies `code` into the writable tail of the cache's newest chunk, or a
+   new one. The code is not executable until seal_staged(): units made hot
+   by one run are sealed together with a single mprotect, instead of a
+   pair of them per unit. */
+static void* place_code(JitCache *cache, const Code *code) {
+    CodeChunk *k = cache->chunks;
+    size_t at = k ? (k->used + 15) & ~(size_t)15 : 0;
+    if (k && at < k->sealed) at = k->sealed;
+    if (!k || at + code->n > k->size) {
+        size_t page = page_size();
+        size_t size = code->n > JIT_CHUNK_SIZE ? code->n : JIT_CHUNK_SIZE;
+        size = (size + page - 1) & ~(page - 1);
+        k = (CodeChunk*)calloc(1, sizeof(CodeChunk));
+        if (!k) return NULL;
+        void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) { free(k); return NULL; }
+        k->mem = (unsigned char*)mem;
+        k->size = size;
+        k->next = cache->chunks;
+        cache->chunks = k;
+        at = 0;
+    }
+
+    memcpy(k->mem + at, code->p, code->n);
+    k->used = at + code->n;
+    return k->mem + at;
+}
+
+/* W^X: flips the pages holding staged code from RW to RX. Later code
+   starts on the next page, which is still RW. */
+static int seal_staged(JitCache *cache) {
+    size_t page = page_size();
+    for (CodeChunk *k = cache->chunks; k; k = k->next) {
+        if (k->used <= k->sealed) continue;
+        size_t to = (k->used + page - 1) & ~(page - 1);
+        if (mprotect(k->mem + k->sealed, to - k->sealed, PROT_READ | PROT_EXEC) != 0) {
+            cache->broken = 1;
+            return 0;
+        }
+        k->sealed = to;
+    }
+    for (int i = 0; i < cache->nstaged; i++) cache->staged[i]->state = UNIT_READY;
+    cache->nstaged = 0;
+    return 1;
+}
+
+static void unit_compile(JitCache *cache, JitUnit *u, const void *vars, int nvars) {
+    Jc j;
+    memset(&j, 0, sizeof(j));
+    j.lay = &cache->lay;
+    j.vars = (const unsigned char*)vars;
+    j.nvars = nvars;
+    j.known = (unsigned char*)calloc((size_t)nvars + 1, 1);
+    j.guard = (unsigned char*)calloc((size_t)nvars + 1, 1);
+    j.written = (unsigned char*)calloc((size_t)nvars + 1, 1);
+    j.stamp = (unsigned*)calloc((size_t)nvars + 1, sizeof(unsigned));
+    u->state = UNIT_NONE;
+    if (!j.known || !j.guard || !j.written || !j.stamp) goto done;
+
+    /* take the longest supported prefix */
+    const Stmt *s = u->first;
+    int covered = 0;
+    for (; s; s = s->next) {
+        size_t code_n = j.code.n, undo_n = j.nundo;
+        int guards_n = j.nguards, writes_n = j.nwrites;
+
+        if (jc_stmt(&j, s) && !j.oom && !j.code.oom) { covered++; continue; }
+
+        j.oom = 0;
+        j.code.oom = 0;
+        j.code.n = code_n;
+        undo_to(&j, undo_n);
+        while (j.nguards > guards_n) j.guard[j.guards[--j.nguards].slot] = 0;
+        while (j.nwrites > writes_n) j.written[j.writes[--j.nwrites]] = 0;
+        break;
+    }
+    if (covered == 0) goto done;
+
+    emit1(&j.code, 0xC3);                                      /* ret */
+    if (j.code.oom) goto done;
+
+    if (cache->nstaged == cache->capstaged) {
+        int cap = cache->capstaged ? cache->capstaged * 2 : 16;
+        JitUnit **staged = (JitUnit**)realloc(cache->staged, (size_t)cap * sizeof(JitUnit*));
+        if (!staged) goto done;
+        cache->staged = staged;
+        cache->capstaged = cap;
+    }
+
+    void *mem = place_code(cache, &j.code);
+    if (!mem) { cache->broken = 1; goto done; }
+
+    memcpy(&u->fn, &mem, sizeof(u->fn));
+    u->end = s;
+    u->guards = j.guards;   j.guards = NULL;
+    u->nguards = j.nguards;
+    u->writes = j.writes;   j.writes = NULL;
+    u->nwrites = j.nwrites;
+    u->state = UNIT_STAGED;
+    cache->staged[cache->nstaged++] = u;
+
+done:
+    free(j.code.p);
+    free(j.known);
+    free(j.undo);
+    free(j.guard);
+    free(j.guards);
+    free(j.written);
+    free(j.writes);
+    free(j.stamp);
+}
+
+/* Statements inside a new unit start over as cold: they are reached on
+   their own only when the unit's guards fail, and would otherwise all be
+   compiled in the same run as their own (overlapping) units. */
+static void cool_covered(JitCache *cache, const Stmt *s, const Stmt *end) {
+    for (; s && s != end; s = s->next) {
+        JitUnit *u = find_unit(cache, s);
+        if (u && u->state == UNIT_COLD) u->runs = 0;
+        if (s->kind == STMT_IF) {
+            for (const IfBranch *b = s->if_branches; b; b = b->next) cool_covered(cache, b->body, NULL);
+        }
+    }
+}
+
+static int unit_enterable(const JitCache *c, const JitUnit *u, const void *vars, int live, int max_live) {
+    const unsigned char *base = (const unsigned char*)vars;
+    int in_use, kind;
+
+    for (int i = 0; i < u->nguards; i++) {
+        const unsigned char *v = base + (size_t)u->guards[i].slot * c->lay.stride;
+        memcpy(&in_use, v + c->lay.off_in_use, sizeof(int));
+        memcpy(&kind, v + c->lay.off_kind, sizeof(int));
+        if (!in_use || kind != u->guards[i].kind) return 0;
+    }
+
+    /* stores never free strings nor report "too many variables" */
+    for (int i = 0; i < u->nwrites; i++) {
+        const unsigned char *v = base + (size_t)u->writes[i] * c->lay.stride;
+        memcpy(&in_use, v + c->lay.off_in_use, sizeof(int));
+        memcpy(&kind, v + c->lay.off_kind, sizeof(int));
+        if (!in_use) live++;
+        else if (kind == VAL_STRING) return 0;
+    }
+    return live <= max_live;
+}
+
+#endif /* JIT_X86_64 */
+
+/* ============================================================
+   Entry
+   ============================================================ */
+
+int jit_run(JitCache *c, const Stmt *s, void *vars, int nvars,
+            int *live, int max_live, const Stmt **next) {
+#ifdef JIT_X86_64
+    if (!c || !s || c->broken) return 0;
+
+    JitUnit *u = cache_unit(c, s);
+    if (!u || u->state == UNIT_NONE) return 0;
+
+    /* a unit is compiled on its hot run and entered from the next one */
+    if (u->state == UNIT_COLD) {
+        if (++u->runs < JIT_HOT_RUNS) return 0;
+        unit_compile(c, u, vars, nvars);
+        if (u->state == UNIT_STAGED) cool_covered(c, u->first, u->end);
+        return 0;
+    }
+    if (u->state == UNIT_STAGED && !seal_staged(c)) return 0;
+
+    if (!unit_enterable(c, u, vars, *live, max_live)) return 0;
+    u->fn(vars, live);
+    *next = u->end;
+    return 1;
+#else
+    (void)c; (void)s; (void)vars; (void)nvars; (void)live; (void)max_live; (void)next;
+    return 0;
+#endif
+}
@@ -0,0 +1,55 @@
+// src/jit.h
+#ifndef NOEMA_JIT_H
+#define NOEMA_JIT_H
+
+#include <stddef.h>
+
+#include "parser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+   Baseline template JIT (x86-64).
+
+   A unit is a run of consecutive statements starting at some statement:
+   assignments of integer/boolean expressions over slot-resolved
+   variables, and `si` chains built from them. Each operation is a fixed
+   machine-code template; templates are stitched together and `si`
+   branches become direct jumps. The code is specialized to the kinds
+   the variables had when it was compiled; those assumptions are checked
+   once at unit entry, and the caller interprets the statement instead
+   whenever they do not hold.
+*/
+
+/* How the runtime lays out its variable slots. */
+typedef struct {
+    size_t stride;          /* bytes between consecutive slots */
+    size_t off_kind;        /* int: ValueKind */
+    size_t off_int;         /* int: int_value */
+    size_t off_string;      /* char*: string_value */
+    size_t off_in_use;      /* int: nonzero once the variable exists */
+} JitLayout;
+
+typedef struct JitCache JitCache;
+
+/* NULL when the platform has no JIT support (or out of memory). */
+JitCache* jit_cache_create(const JitLayout *layout);
+void      jit_cache_destroy(JitCache *c);
+
+/* Forget every unit (the program they point into is going away). */
+void      jit_cache_clear(JitCache *c);
+
+/* Runs the unit starting at `s` if it is (or just became) hot and its
+   entry guards hold against `vars`. `live` counts slots in use and may
+   not exceed `max_live`. Returns 1 and sets *next to the first statement
+   after the unit when machine code ran; 0 means "interpret `s`". */
+int       jit_run(JitCache *c, const Stmt *s, void *vars, int nvars,
+                  int *live, int max_live, const Stmt **next);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -6,13 +6,38 @@
 
 static void print_usage(const char *prog) {
     fprintf(stderr,
-        "Usage: %s <file.noema> [--tokens] [--ast] [--trace]\n"
+        "Usage: %s <file.noema> [--tokens] [--ast] [--trace] [--no-opt] [--no-jit] [--dump-ir]\n"
+        "       %s <file.noema> [--cache <dir>]\n"
+        "       %s --rules <file.noema> --input <records.jsonl|records.csv|-> [--jobs <n|auto>]\n"
+        "       %s <file.noema> (--emit-c | --compile) [-o <output>]\n"
+        "       %s <file.noema> [--specialize] --bind name=value... [-o <output>]\n"
         "\n"
         "Options:\n"
         "  --tokens   Tokenize only (debug)\n"
         "  --ast      Parse and print AST only (debug)\n"
-        "  --trace    Trace execution (debug) (reserved)\n",
-        prog
+        "  --trace    Trace execution (debug) (reserved)\n"
+        "  --no-opt   Disable the AST and IR optimizers, and with --input the\n"
+        "             block-at-a-time evaluation of rule conditions\n"
+        "  --no-jit   Interpret --input records only; by default statements\n"
+        "             that have run for many records are compiled to machine\n"
+        "             code (a single run is always interpreted)\n"
+        "  --dump-ir  Print the optimized SSA IR and exit (unoptimized with --no-opt)\n"
+        "  --cache    Keep the parsed and optimized program in <dir>, keyed by\n"
+        "             the source; later runs of the same script skip both\n"
+        "  --rules    The program to run once per record of --input (same as\n"
+        "             giving it as <file.noema>)\n"
+        "  --input    JSON Lines or CSV (with a header) records; each record's\n"
+        "             fields set the program's inputs. Prints records/s to stderr\n"
+        "  --jobs     Run --input records on <n> threads (auto: one per CPU);\n"
+        "             the output keeps the order of the records\n"
+        "  --emit-c   Translate to a standalone C file (stdout, or -o <file>)\n"
+        "  --compile  Build a native executable with $CC (default gcc);\n"
+        "             output defaults to the source path without .noema\n"
+        "  --bind     Fix an input (a variable whose first assignment is a\n"
+        "             top-level literal) to a value; repeatable\n"
+        "  --specialize  Write the program partially evaluated for the --bind\n"
+        "             values as Noema source (stdout, or -o <file>)\n",
+        prog, prog, prog, prog, prog
     );
 }
 
@@ -45,6 +70,74 @@ static NoemaOptions parse_args(int argc, char **argv, const char **path_out) {
             continue;
         }
 
+        if (strcmp(a, "--no-opt") == 0) {
+            opt.no_opt = 1;
+            continue;
+        }
+
+        if (strcmp(a, "--no-jit") == 0) {
+            opt.no_jit = 1;
+            continue;
+        }
+
+        if (strcmp(a, "--dump-ir") == 0) {
+            opt.dump_ir = 1;
+            continue;
+        }
+
+        if (strcmp(a, "--emit-c") == 0) {
+            opt.emit_c = 1;
+            continue;
+        }
+
+        if (strcmp(a, "--compile") == 0) {
+            opt.compile = 1;
+            continue;
+        }
+
+        if (strcmp(a, "--specialize") == 0) {
+            opt.specialize = 1;
+            continue;
+        }
+
+        if (strcmp(a, "--bind") == 0 && i + 1 < argc) {
+            if (!opt.binds) opt.binds = (const char**)calloc((size_t)argc, sizeof(char*));
+            if (!opt.binds) { opt.bad_args = 1; continue; }
+            opt.binds[opt.nbinds++] = argv[++i];
+            continue;
+        }
+
+        if (strcmp(a, "--cache") == 0 && i + 1 < argc) {
+            opt.cache_dir = argv[++i];
+            continue;
+        }
+
+        if (strcmp(a, "--rules") == 0 && i + 1 < argc) {
+            if (*path_out) opt.bad_args = 1;
+            *path_out = argv[++i];
+            continue;
+        }
+
+        if (strcmp(a, "--input") == 0 && i + 1 < argc) {
+            opt.input = argv[++i];
+            continue;
+        }
+
+        if (strcmp(a, "--jobs") == 0 && i + 1 < argc) {
+            const char *n = argv[++i];
+            char *end;
+            long v = strtol(n, &end, 10);
+            if (strcmp(n, "auto") == 0) opt.jobs = -1;
+            else if (end != n && *end == '\0' && v > 0 && v <= 1024) opt.jobs = (int)v;
+            else opt.bad_args = 1;
+            continue;
+        }
+
+        if (strcmp(a, "-o") == 0 && i + 1 < argc) {
+            opt.out_path = argv[++i];
+            continue;
+        }
+
         if (a[0] != '-' && *path_out == NULL) {
             *path_out = a;
             continue;
@@ -79,6 +172,7 @@ int main(int argc, char **argv) {
     NoemaResult r = noema_run_file(f, path, &opt);
 
     fclose(f);
+    free((void*)opt.binds);
 
     if (!r.ok) {
         if (r.message[0]) fprintf(stderr, "%s\n", r.message);
@@ -1,9 +1,18 @@
 // src/noema.c
+#define _DEFAULT_SOURCE
 #include "noema.h"
 #include "lexer.h"
 #include "parser.h"
 #include "runtime.h"
-
+#include "optimize.h"
+#include "ir.h"
+#include "cgen.h"
+#include "specialize.h"
+#include "progcache.h"
+#include "rules.h"
+
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
@@ -144,7 +153,7 @@ static void dump_stmt_list(const Stmt *s, int ind) {
 
             case STMT_CALL_PRINT:
                 indent_n(ind);
-                printf("CALL sonus.dic(");
+                printf("CALL %s(", s->callee);
                 dump_expr(s->arg);
                 printf(")\n");
                 break;
@@ -165,22 +174,192 @@ static void dump_ast(const ParseResult *pr) {
     dump_stmt_list(pr->first, 0);
 }
 
+/* ============================================================
+   C backend
+   ============================================================ */
+
+/* Default executable name: the source path without its .noema suffix. */
+static void default_exe_path(const char *path, char *out, size_t cap) {
+    size_t n = strlen(path);
+    const char *ext = ".noema";
+    size_t ne = strlen(ext);
+    if (n > ne && strcmp(path + n - ne, ext) == 0) {
+        snprintf(out, cap, "%.*s", (int)(n - ne), path);
+    } else {
+        snprintf(out, cap, "%s.out", path);
+    }
+}
+
+static int backend_c(const ParseResult *pr, const char *path, const NoemaOptions *opt,
+                     char *err, int cap) {
+    if (opt->compile) {
+        char exe[1024];
+        if (opt->out_path) snprintf(exe, sizeof(exe), "%s", opt->out_path);
+        else default_exe_path(path, exe, sizeof(exe));
+        return cgen_compile(pr->first, path, exe, err, cap);
+    }
+
+    if (!opt->out_path) {
+        return cgen_emit_c(pr->first, path, stdout, err, cap);
+    }
+
+    FILE *out = fopen(opt->out_path, "w");
+    if (!out) {
+        snprintf(err, cap, "noema: cannot open '%s' for writing", opt->out_path);
+        return 0;
+    }
+    int ok = cgen_emit_c(pr->first, path, out, err, cap);
+    if (fclose(out) != 0 && ok) {
+        snprintf(err, cap, "noema: error writing '%s'", opt->out_path);
+        ok = 0;
+    }
+    return ok;
+}
+
+/* ============================================================
+   Specialization (--bind / --specialize)
+   ============================================================ */
+
+/* Applies the --bind values to the parsed program; with --specialize,
+   replaces it by its residual and writes that as Noema source. */
+static int bind_inputs(ParseResult *pr, const NoemaOptions *opt, char *err, int cap) {
+    int n = opt->nbinds;
+    SpecBinding *b = (SpecBinding*)calloc((size_t)n + 1, sizeof(SpecBinding));
+    if (!b) {
+        snprintf(err, cap, "noema: out of memory");
+        return 0;
+    }
+
+    int ok = 1;
+    for (int i = 0; i < n && ok; i++) {
+        ok = spec_parse_binding(opt->binds[i], &b[i], err, cap);
+    }
+    if (ok) ok = spec_bind(&pr->first, b, n, err, cap);
+    if (ok && opt->specialize) pr->first = spec_residual(pr->first, b, n);
+
+    free(b);
+    return ok;
+}
+
+static int write_residual(const ParseResult *pr, const NoemaOptions *opt, char *err, int cap) {
+    if (!opt->out_path) {
+        spec_write_source(pr->first, stdout);
+        return 1;
+    }
+
+    FILE *out = fopen(opt->out_path, "w");
+    if (!out) {
+        snprintf(err, cap, "noema: cannot open '%s' for writing", opt->out_path);
+        return 0;
+    }
+    spec_write_source(pr->first, out);
+    if (fclose(out) != 0) {
+        snprintf(err, cap, "noema: error writing '%s'", opt->out_path);
+        return 0;
+    }
+    return 1;
+}
+
+/* ============================================================
+   Program identity (--cache)
+   ============================================================ */
+
+/* Identifies what runs: the source bytes plus everything on the command
+   line that changes the program, NUL-separated. Returns a malloc'd
+   buffer of *len bytes, or NULL when the source cannot be re-read. */
+static char* program_ident(FILE *f, const NoemaOptions *opt, size_t *len) {
+    long start = ftell(f);
+    if (start < 0) return NULL;
+
+    size_t n = 0, cap = 4096;
+    char *b = (char*)malloc(cap);
+    if (!b) return NULL;
+    for (;;) {
+        if (n == cap) {
+            char *nb = (char*)realloc(b, cap * 2);
+            if (!nb) { free(b); return NULL; }
+            b = nb;
+            cap *= 2;
+        }
+        size_t got = fread(b + n, 1, cap - n, f);
+        n += got;
+        if (got == 0) break;
+    }
+    if (ferror(f) || fseek(f, start, SEEK_SET) != 0) { free(b); return NULL; }
+
+    size_t extra = 2;
+    for (int i = 0; i < opt->nbinds; i++) extra += strlen(opt->binds[i]) + 1;
+    char *nb = (char*)realloc(b, n + extra);
+    if (!nb) { free(b); return NULL; }
+    b = nb;
+    b[n++] = '\0';
+    b[n++] = opt->no_opt ? '1' : '0';
+    for (int i = 0; i < opt->nbinds; i++) {
+        size_t k = strlen(opt->binds[i]) + 1;
+        memcpy(b + n, opt->binds[i], k);
+        n += k;
+    }
+    *len = n;
+    return b;
+}
+
+/* ============================================================
+   Execution
+   ============================================================ */
+
+static void run_program(Stmt *program, const char *path, NoemaResult *r) {
+    Runtime *rt = runtime_create();
+    if (!rt) {
+        snprintf(r->message, sizeof(r->message), "noema: cannot create runtime");
+        return;
+    }
+
+    /* every statement runs once: nothing gets hot enough to compile, so
+       the runtime keeps its JIT off */
+
+    char rt_err[512];
+    rt_err[0] = '\0';
+
+    int ok = runtime_exec(rt, program, path, rt_err, (int)sizeof(rt_err));
+    runtime_destroy(rt);
+
+    if (!ok) {
+        snprintf(r->message, sizeof(r->message), "%s", rt_err[0] ? rt_err : "runtime error");
+        r->ok = 0;
+    } else {
+        r->ok = 1;
+    }
+}
+
+static void run_rules(ParseResult *pr, const char *path, const NoemaOptions *opt, NoemaResult *r) {
+    RulesStats st;
+    if (!rules_run(&pr->first, path, opt->input, RULES_AUTO, opt->jobs, opt->no_opt, opt->no_jit,
+                   &st, r->message, (int)sizeof(r->message))) {
+        return;
+    }
+
+    fprintf(stderr, "noema: %ld records in %.3f s (%.0f records/s)\n",
+            st.records, st.seconds, st.seconds > 0 ? (double)st.records / st.seconds : 0.0);
+    if (st.failed) {
+        snprintf(r->message, sizeof(r->message), "noema: %ld of %ld records failed", st.failed, st.records);
+        return;
+    }
+    r->ok = 1;
+}
+
 /* ============================================================
    Public entry
    ============================================================ */
 
-NoemaResult noema_run_file(FILE *f, const char *path, const NoemaOptions *opt) {
+/* Parses `f` and runs it or does what `opt` asks instead. With `ident`
+   (--cache) the optimized program is also stored under it. */
+static NoemaResult parse_and_run(FILE *f, const char *path, const NoemaOptions *opt,
+                                 const char *ident, size_t ident_len) {
     NoemaResult r;
     memset(&r, 0, sizeof(r));
     r.ok = 0;
     r.message[0] = '\0';
 
-    if (opt && opt->dump_tokens) {
-        dump_tokens(f, path);
-        r.ok = 1;
-        return r;
-    }
-
     Lexer *lx = lexer_create(f, path);
     if (!lx) {
         snprintf(r.message, sizeof(r.message), "noema: cannot create lexer");
@@ -204,6 +383,53 @@ NoemaResult noema_run_file(FILE *f, const char *path, const NoemaOptions *opt) {
         return r;
     }
 
+    if (opt && (opt->nbinds > 0 || opt->specialize)) {
+        int ok = bind_inputs(&pr, opt, r.message, (int)sizeof(r.message));
+        if (ok && opt->specialize) {
+            /* the residual is the output; the optimizer would fold unbound defaults */
+            r.ok = write_residual(&pr, opt, r.message, (int)sizeof(r.message));
+            ok = 0;
+        }
+        if (!ok) {
+            parser_free_program(pr.first);
+            parser_destroy(ps);
+            lexer_destroy(lx);
+            return r;
+        }
+    }
+
+    if (opt && opt->input) {
+        /* rules are compiled for unknown inputs; the optimizer would fold their defaults */
+        run_rules(&pr, path, opt, &r);
+        parser_free_program(pr.first);
+        parser_destroy(ps);
+        lexer_destroy(lx);
+        return r;
+    }
+
+    if (opt && opt->dump_ir) {
+        IrFunc *ir = ir_build(pr.first);
+        if (ir) {
+            if (!opt->no_opt) ir_optimize(ir);
+            ir_dump(ir, stdout);
+            ir_free(ir);
+            r.ok = 1;
+        } else {
+            snprintf(r.message, sizeof(r.message), "noema: program not representable in IR");
+        }
+        parser_free_program(pr.first);
+        parser_destroy(ps);
+        lexer_destroy(lx);
+        return r;
+    }
+
+    if (!(opt && opt->no_opt)) {
+        /* --ast shows the program as --cache keeps it */
+        int reused = ident != NULL ||
+                     (opt && (opt->dump_ast || opt->emit_c || opt->compile));
+        pr.first = optimize_program(pr.first, reused);
+    }
+
     if (opt && opt->dump_ast) {
         dump_ast(&pr);
         r.ok = 1;
@@ -213,31 +439,264 @@ NoemaResult noema_run_file(FILE *f, const char *path, const NoemaOptions *opt) {
         return r;
     }
 
-    Runtime *rt = runtime_create();
-    if (!rt) {
-        snprintf(r.message, sizeof(r.message), "noema: cannot create runtime");
+    if (opt && (opt->emit_c || opt->compile)) {
+        r.ok = backend_c(&pr, path, opt, r.message, (int)sizeof(r.message));
         parser_free_program(pr.first);
         parser_destroy(ps);
         lexer_destroy(lx);
         return r;
     }
 
-    char rt_err[512];
-    rt_err[0] = '\0';
+    if (ident) pcache_store(opt->cache_dir, ident, ident_len, pr.first);
 
-    int ok = runtime_exec(rt, pr.first, path, rt_err, (int)sizeof(rt_err));
-    runtime_destroy(rt);
+    run_program(pr.first, path, &r);
 
-    if (!ok) {
-        snprintf(r.message, sizeof(r.message), "%s", rt_err[0] ? rt_err : "runtime error");
-        r.ok = 0;
-    } else {
+    parser_free_program(pr.first);
+    parser_destroy(ps);
+    lexer_destroy(lx);
+    return r;
+}
+
+NoemaResult noema_run_file(FILE *f, const char *path, const NoemaOptions *opt) {
+    NoemaResult r;
+    memset(&r, 0, sizeof(r));
+    r.ok = 0;
+    r.message[0] = '\0';
+
+    if (opt && opt->dump_tokens) {
+        dump_tokens(f, path);
         r.ok = 1;
+        return r;
     }
 
-    parser_free_program(pr.first);
+    /* --cache only holds what runs: the optimized program */
+    int cacheable = opt && opt->cache_dir && !opt->dump_ast && !opt->dump_ir &&
+                    !opt->emit_c && !opt->compile && !opt->specialize && !opt->input;
+    size_t ident_len = 0;
+    char *ident = cacheable ? program_ident(f, opt, &ident_len) : NULL;
+
+    if (ident) {
+        Stmt *cached = pcache_load(opt->cache_dir, ident, ident_len);
+        if (cached) {
+            run_program(cached, path, &r);
+            parser_free_program(cached);
+            free(ident);
+            return r;
+        }
+    }
+
+    r = parse_and_run(f, path, opt, ident, ident_len);
+    free(ident);
+    return r;
+}
+
+/* ============================================================
+   Batch evaluation
+   ============================================================ */
+
+struct NoemaProgram {
+    Stmt *program;
+    char *path;
+    Runtime *rt;
+    SpecInput *inputs;          /* sorted by name */
+    int ninputs;
+    int *slot;                  /* per input: its variable */
+    unsigned *given;            /* per input: the last record that gave it */
+    unsigned record;
+
+    FILE *out;                  /* what the runs print */
+    char *outbuf;
+    size_t outlen;
+    FILE *errs;                 /* their error messages, NUL-terminated */
+    char *errbuf;
+    size_t errlen;
+    long *spans;                /* per record of the batch: output and error offsets */
+    size_t capspans;
+};
+
+void noema_program_free(NoemaProgram *p) {
+    if (!p) return;
+    parser_free_program(p->program);
+    runtime_destroy(p->rt);
+    if (p->out) fclose(p->out);
+    if (p->errs) fclose(p->errs);
+    free(p->outbuf);
+    free(p->errbuf);
+    free(p->inputs);
+    free(p->slot);
+    free(p->given);
+    free(p->spans);
+    free(p->path);
+    free(p);
+}
+
+NoemaProgram* noema_program_load(FILE *f, const char *path, const NoemaOptions *opt, NoemaResult *r) {
+    memset(r, 0, sizeof(*r));
+    if (!path || !path[0]) path = "<input>";
+
+    Lexer *lx = lexer_create(f, path);
+    Parser *ps = lx ? parser_create(lx) : NULL;
+    if (!ps) {
+        lexer_destroy(lx);
+        snprintf(r->message, sizeof(r->message), "noema: cannot create parser");
+        return NULL;
+    }
+    ParseResult pr = parser_parse_program(ps);
     parser_destroy(ps);
     lexer_destroy(lx);
-    return r;
+    if (!pr.ok) {
+        snprintf(r->message, sizeof(r->message), "%s", pr.message);
+        parser_free_program(pr.first);
+        return NULL;
+    }
+
+    NoemaProgram *p = (NoemaProgram*)calloc(1, sizeof(NoemaProgram));
+    if (!p) {
+        parser_free_program(pr.first);
+        snprintf(r->message, sizeof(r->message), "noema: out of memory");
+        return NULL;
+    }
+
+    /* as rules_run compiles: fold what does not depend on any input */
+    p->program = spec_residual(pr.first, NULL, 0);
+    if (!spec_take_inputs(&p->program, &p->inputs, &p->ninputs, r->message, (int)sizeof(r->message))) {
+        noema_program_free(p);
+        return NULL;
+    }
+
+    size_t n = (size_t)p->ninputs + 1;
+    p->path = (char*)malloc(strlen(path) + 1);
+    p->rt = runtime_create();
+    p->slot = (int*)malloc(n * sizeof(int));
+    p->given = (unsigned*)calloc(n, sizeof(unsigned));
+    p->out = open_memstream(&p->outbuf, &p->outlen);
+    p->errs = open_memstream(&p->errbuf, &p->errlen);
+    int ok = p->path && p->rt && p->slot && p->given && p->out && p->errs;
+    if (ok) {
+        strcpy(p->path, path);
+        runtime_set_jit(p->rt, !(opt && opt->no_jit));
+        runtime_set_output(p->rt, p->out);
+    }
+    for (int i = 0; ok && i < p->ninputs; i++) {
+        p->slot[i] = runtime_var(p->rt, p->inputs[i].name);
+        ok = p->slot[i] >= 0;
+    }
+    /* resolved now, so every input has its variable before the first batch */
+    if (ok) ok = runtime_prepare(p->rt, p->program);
+    if (!ok) {
+        noema_program_free(p);
+        snprintf(r->message, sizeof(r->message), "noema: out of memory");
+        return NULL;
+    }
+    r->ok = 1;
+    return p;
+}
+
+int noema_field(const NoemaProgram *p, const char *name) {
+    if (!p || !name) return -1;
+    int lo = 0, hi = p->ninputs - 1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        int c = strcmp(p->inputs[mid].name, name);
+        if (c == 0) {
+            SpecInputKind k = p->inputs[mid].kind;
+            return k == SPEC_INPUT || k == SPEC_FREE ? mid : -1;
+        }
+        if (c < 0) lo = mid + 1; else hi = mid - 1;
+    }
+    return -1;
 }
 
+/* Runs one record; its output goes to p->out and, if it fails, the
+   message to `err`. */
+static int eval_record(NoemaProgram *p, const NoemaRecord *rec, char *err, int cap) {
+    unsigned stamp = ++p->record;
+    if (stamp == 0) {           /* wrapped: no input counts as given */
+        memset(p->given, 0, (size_t)p->ninputs * sizeof(unsigned));
+        stamp = ++p->record;
+    }
+
+    runtime_reset(p->rt);
+    for (int i = 0; i < rec->nfields; i++) {
+        const NoemaField *fd = &rec->fields[i];
+        Value v;
+        v.kind = fd->kind == NOEMA_INT ? VAL_INT : fd->kind == NOEMA_BOOL ? VAL_BOOL
+               : fd->kind == NOEMA_STRING ? VAL_STRING : VAL_NULL;
+        v.int_value = fd->kind == NOEMA_BOOL ? fd->int_value != 0 : fd->int_value;
+        v.string_value = fd->kind == NOEMA_STRING ? (char*)(uintptr_t)fd->string_value : NULL;
+        if (!runtime_set_value(p->rt, p->slot[fd->field], &v)) {
+            snprintf(err, cap, "%s: runtime error: too many variables", p->path);
+            return 0;
+        }
+        p->given[fd->field] = stamp;
+    }
+    for (int i = 0; i < p->ninputs; i++) {
+        if (p->inputs[i].kind != SPEC_INPUT || p->given[i] == stamp) continue;
+        if (!runtime_set_var(p->rt, p->slot[i], &p->inputs[i].value)) {
+            snprintf(err, cap, "%s: runtime error: too many variables", p->path);
+            return 0;
+        }
+    }
+    return runtime_exec(p->rt, p->program, p->path, err, cap);
+}
+
+long noema_eval_batch(NoemaProgram *p, const NoemaRecord *records, size_t n, NoemaResultSink *sink) {
+    if (!p || !sink || (n && (!records || (!sink->fn && !sink->results)))) return -1;
+    for (size_t k = 0; k < n; k++) {
+        for (int i = 0; i < records[k].nfields; i++) {
+            int fd = records[k].fields[i].field;
+            if (fd < 0 || fd >= p->ninputs) return -1;
+        }
+    }
+
+    /* without `fn`, results point into the buffers once they are final */
+    if (!sink->fn && n > p->capspans) {
+        if (n > SIZE_MAX / (2 * sizeof(long))) return -1;
+        long *spans = (long*)realloc(p->spans, n * 2 * sizeof(long));
+        if (!spans) return -1;
+        p->spans = spans;
+        p->capspans = n;
+    }
+
+    /* the buffers are reused from batch to batch */
+    if (fseek(p->out, 0, SEEK_SET) != 0 || fseek(p->errs, 0, SEEK_SET) != 0) return -1;
+
+    long failed = 0;
+    for (size_t k = 0; k < n; k++) {
+        long at = ftell(p->out);
+        char err[512];
+        err[0] = '\0';
+        int ok = eval_record(p, &records[k], err, (int)sizeof(err));
+        if (!ok) failed++;
+        if (fflush(p->out) != 0) return -1;
+
+        NoemaRecordResult one;
+        NoemaRecordResult *res = sink->fn ? &one : &sink->results[k];
+        res->ok = ok;
+        res->output_len = (size_t)(ftell(p->out) - at);
+        if (sink->fn) {
+            res->output = p->outbuf + at;
+            res->error = ok ? "" : err;
+            sink->fn(sink->ctx, k, res);
+            continue;
+        }
+
+        p->spans[2 * k] = at;
+        p->spans[2 * k + 1] = -1;
+        if (!ok) {
+            p->spans[2 * k + 1] = ftell(p->errs);
+            fputs(err[0] ? err : "runtime error", p->errs);
+            fputc('\0', p->errs);
+        }
+    }
+
+    if (!sink->fn && n) {
+        if (fflush(p->out) != 0 || fflush(p->errs) != 0) return -1;
+        for (size_t k = 0; k < n; k++) {
+            NoemaRecordResult *res = &sink->results[k];
+            res->output = p->outbuf + p->spans[2 * k];
+            res->error = p->spans[2 * k + 1] < 0 ? "" : p->errbuf + p->spans[2 * k + 1];
+        }
+    }
+    return failed;
+}
@@ -11,6 +11,18 @@ typedef struct {
     int dump_tokens;  // lexer debug
     int dump_ast;     // parser debug
     int trace_exec;   // runtime debug (reserved)
+    int no_opt;       // skip AST/IR optimizations
+    int no_jit;       // interpret records only (no baseline JIT)
+    int dump_ir;      // optimizer debug
+    int emit_c;       // write C translation instead of running
+    int compile;      // build a native executable with $CC
+    const char *out_path; // -o: output for --emit-c / --compile / --specialize
+    int specialize;   // write the residual program for the --bind values
+    const char **binds;   // --bind name=value (points into argv)
+    int nbinds;
+    const char *cache_dir; // --cache: parsed+optimized programs shared by runs
+    const char *input;    // --input: records to run the program (rules) over
+    int jobs;         // --jobs: threads running --input records (-1 = one per CPU)
     int show_help;    // internal
     int bad_args;     // internal
 } NoemaOptions;
@@ -22,6 +34,62 @@ typedef struct {
 
 NoemaResult noema_run_file(FILE *f, const char *path, const NoemaOptions *opt);
 
+// Batch evaluation for embedders: a program compiled once the way
+// --input compiles rules, then run over records in memory. Each
+// record's run starts from empty variables, with the record's fields
+// in the inputs they name and the other inputs at their defaults.
+typedef struct NoemaProgram NoemaProgram;
+
+typedef enum {
+    NOEMA_NULL = 0,
+    NOEMA_INT,
+    NOEMA_BOOL,
+    NOEMA_STRING
+} NoemaKind;
+
+typedef struct {
+    int field;              // from noema_field
+    NoemaKind kind;
+    int int_value;          // NOEMA_INT, NOEMA_BOOL
+    const char *string_value; // NOEMA_STRING (copied)
+} NoemaField;
+
+typedef struct {
+    const NoemaField *fields;
+    int nfields;
+} NoemaRecord;
+
+typedef struct {
+    int ok;                 // 0 if the run ended in a runtime error
+    const char *output;     // what it printed: output_len bytes
+    size_t output_len;
+    const char *error;      // the error message, "" if ok
+} NoemaRecordResult;
+
+// Results go to `fn`, record by record in input order, with pointers
+// valid during the call; or, if `fn` is NULL, into `results` (one per
+// record), with pointers valid until the next batch on the program.
+typedef struct {
+    void (*fn)(void *ctx, size_t index, const NoemaRecordResult *result);
+    void *ctx;
+    NoemaRecordResult *results;
+} NoemaResultSink;
+
+// Compiles the program in `f`; NULL with the reason in r->message if it
+// does not parse or cannot be compiled. Uses opt->no_jit only.
+NoemaProgram* noema_program_load(FILE *f, const char *path, const NoemaOptions *opt, NoemaResult *r);
+void          noema_program_free(NoemaProgram *p);
+
+// The field index of input `name`, for NoemaField; -1 if the program
+// has no such input.
+int           noema_field(const NoemaProgram *p, const char *name);
+
+// Runs `p` once per record. Returns how many runs ended in a runtime
+// error, or -1 (and nothing is run) if `sink` is NULL, a field index is
+// out of range or memory runs out. An empty batch returns 0.
+long          noema_eval_batch(NoemaProgram *p, const NoemaRecord *records, size_t n,
+                               NoemaResultSink *sink);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,388 @@
+// src/optimize.c
+#include "optimize.h"
+#include "ir.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdio.h>
+
+/*
+   AST optimizer.
+
+   Every rewrite here must be invisible to the program: a folded
+   expression yields exactly what runtime.c would have computed, and an
+   expression whose evaluation would raise a runtime error (type mismatch,
+   division by zero, ...) is left untouched so the error still surfaces
+   at run time with its original line/column.
+*/
+
+/* ============================================================
+   Literal helpers (mirror runtime.c semantics)
+   ============================================================ */
+
+static void lit_set(LiteralValue *out, LiteralKind k, int v, const char *text) {
+    memset(out, 0, sizeof(*out));
+    out->lit_kind = k;
+    out->int_value = v;
+    if (text) {
+        snprintf(out->text, sizeof(out->text), "%s", text);
+    }
+}
+
+int opt_lit_truthy(const LiteralValue *v) {
+    switch (v->lit_kind) {
+        case LIT_NULL:   return 0;
+        case LIT_BOOL:   return v->int_value ? 1 : 0;
+        case LIT_INT:    return v->int_value != 0;
+        case LIT_STRING: return v->text[0] ? 1 : 0;
+        default:         return 0;
+    }
+}
+
+int opt_lits_equal(const LiteralValue *a, const LiteralValue *b) {
+    if (a->lit_kind != b->lit_kind) return 0;
+    switch (a->lit_kind) {
+        case LIT_NULL:   return 1;
+        case LIT_INT:
+        case LIT_BOOL:   return a->int_value == b->int_value;
+        case LIT_STRING: return strcmp(a->text, b->text) == 0;
+        default:         return 0;
+    }
+}
+
+int opt_fold_unary(ExprOp op, const LiteralValue *a, LiteralValue *out) {
+    if (op == OP_NOT) {
+        lit_set(out, LIT_BOOL, !opt_lit_truthy(a), NULL);
+        return 1;
+    }
+    if (op == OP_NEG && a->lit_kind == LIT_INT && a->int_value != INT_MIN) {
+        lit_set(out, LIT_INT, -a->int_value, NULL);
+        return 1;
+    }
+    return 0;
+}
+
+int opt_fold_binary(ExprOp op, const LiteralValue *x, const LiteralValue *y, LiteralValue *out) {
+    if (op == OP_AND) {
+        lit_set(out, LIT_BOOL, opt_lit_truthy(x) && opt_lit_truthy(y), NULL);
+        return 1;
+    }
+    if (op == OP_OR) {
+        lit_set(out, LIT_BOOL, opt_lit_truthy(x) || opt_lit_truthy(y), NULL);
+        return 1;
+    }
+
+    if (op == OP_EQ || op == OP_NE) {
+        int eq = opt_lits_equal(x, y);
+        lit_set(out, LIT_BOOL, op == OP_EQ ? eq : !eq, NULL);
+        return 1;
+    }
+
+    if (op == OP_ADD && x->lit_kind == LIT_STRING && y->lit_kind == LIT_STRING) {
+        size_t na = strlen(x->text), nb = strlen(y->text);
+        if (na + nb >= NOEMA_TOKEN_VALUE_MAX) return 0;   /* literal would truncate */
+        char buf[NOEMA_TOKEN_VALUE_MAX];
+        memcpy(buf, x->text, na);
+        memcpy(buf + na, y->text, nb);
+        buf[na + nb] = '\0';
+        lit_set(out, LIT_STRING, 0, buf);
+        return 1;
+    }
+
+    /* everything below is int-only; anything else is a runtime error */
+    if (x->lit_kind != LIT_INT || y->lit_kind != LIT_INT) return 0;
+
+    long long a = x->int_value;
+    long long b = y->int_value;
+    long long r;
+
+    switch (op) {
+        case OP_ADD: r = a + b; break;
+        case OP_SUB: r = a - b; break;
+        case OP_MUL: r = a * b; break;
+        case OP_DIV:
+            if (b == 0 || (a == INT_MIN && b == -1)) return 0;
+            r = a / b;
+            break;
+        case OP_MOD:
+            if (b == 0 || (a == INT_MIN && b == -1)) return 0;
+            r = a % b;
+            break;
+        case OP_LT: lit_set(out, LIT_BOOL, a <  b, NULL); return 1;
+        case OP_LE: lit_set(out, LIT_BOOL, a <= b, NULL); return 1;
+        case OP_GT: lit_set(out, LIT_BOOL, a >  b, NULL); return 1;
+        case OP_GE: lit_set(out, LIT_BOOL, a >= b, NULL); return 1;
+        default: return 0;
+    }
+
+    /* do not bake overflow into the program */
+    if (r < INT_MIN || r > INT_MAX) return 0;
+    lit_set(out, LIT_INT, (int)r, NULL);
+    return 1;
+}
+
+int opt_is_lit(const Expr *e) {
+    return e && e->kind == EXPR_LITERAL;
+}
+
+/* Expressions that always evaluate to a VAL_BOOL (or raise). */
+static int yields_bool(const Expr *e) {
+    if (!e) return 0;
+    if (e->kind == EXPR_LITERAL) return e->as.lit.lit_kind == LIT_BOOL;
+    if (e->kind == EXPR_UNARY) return e->as.unary.op == OP_NOT;
+    if (e->kind == EXPR_BINARY) {
+        switch (e->as.binary.op) {
+            case OP_EQ: case OP_NE:
+            case OP_LT: case OP_LE: case OP_GT: case OP_GE:
+            case OP_AND: case OP_OR:
+                return 1;
+            default:
+                return 0;
+        }
+    }
+    return 0;
+}
+
+/* ============================================================
+   In-place node rewriting
+   ============================================================ */
+
+static void free_children(Expr *e) {
+    if (e->kind == EXPR_UNARY) {
+        parser_free_expr(e->as.unary.rhs);
+    } else if (e->kind == EXPR_BINARY) {
+        parser_free_expr(e->as.binary.lhs);
+        parser_free_expr(e->as.binary.rhs);
+    }
+}
+
+void opt_become_lit(Expr *e, const LiteralValue *v) {
+    LiteralValue copy = *v;     /* v may live inside a child we free */
+    free_children(e);
+    memset(&e->as, 0, sizeof(e->as));
+    e->kind = EXPR_LITERAL;
+    e->as.lit = copy;
+}
+
+static void become_bool(Expr *e, int b) {
+    LiteralValue v;
+    lit_set(&v, LIT_BOOL, b ? 1 : 0, NULL);
+    opt_become_lit(e, &v);
+}
+
+/* Replace `e` by its operand `keep` (which must be one of its children). */
+static void become_child(Expr *e, Expr *keep) {
+    if (e->kind == EXPR_BINARY) {
+        if (e->as.binary.lhs != keep) parser_free_expr(e->as.binary.lhs);
+        if (e->as.binary.rhs != keep) parser_free_expr(e->as.binary.rhs);
+    } else if (e->kind == EXPR_UNARY) {
+        if (e->as.unary.rhs != keep) parser_free_expr(e->as.unary.rhs);
+    }
+    *e = *keep;
+    free(keep);
+}
+
+/* ============================================================
+   Constant folding
+   ============================================================ */
+
+static void fold_expr(Expr *e);
+
+static void fold_unary(Expr *e) {
+    Expr *rhs = e->as.unary.rhs;
+    LiteralValue out;
+
+    fold_expr(rhs);
+    if (!opt_is_lit(rhs)) return;
+
+    if (opt_fold_unary(e->as.unary.op, &rhs->as.lit, &out)) opt_become_lit(e, &out);
+}
+
+static void fold_logical(Expr *e) {
+    Expr *lhs = e->as.binary.lhs;
+    Expr *rhs = e->as.binary.rhs;
+    int is_and = (e->as.binary.op == OP_AND);
+
+    if (!opt_is_lit(lhs)) return;
+
+    int lt = opt_lit_truthy(&lhs->as.lit);
+
+    /* falsum et X -> falsum ; verum aut X -> verum (X is never evaluated) */
+    if (is_and ? !lt : lt) {
+        become_bool(e, lt);
+        return;
+    }
+
+    /* verum et X -> truthy(X) ; falsum aut X -> truthy(X) */
+    if (opt_is_lit(rhs)) {
+        become_bool(e, opt_lit_truthy(&rhs->as.lit));
+        return;
+    }
+    if (yields_bool(rhs)) become_child(e, rhs);
+}
+
+static void fold_binary(Expr *e) {
+    Expr *lhs = e->as.binary.lhs;
+    Expr *rhs = e->as.binary.rhs;
+    LiteralValue out;
+
+    fold_expr(lhs);
+    fold_expr(rhs);
+
+    if (e->as.binary.op == OP_AND || e->as.binary.op == OP_OR) {
+        fold_logical(e);
+        return;
+    }
+
+    if (!opt_is_lit(lhs) || !opt_is_lit(rhs)) return;
+
+    if (opt_fold_binary(e->as.binary.op, &lhs->as.lit, &rhs->as.lit, &out)) opt_become_lit(e, &out);
+}
+
+static void fold_expr(Expr *e) {
+    if (!e) return;
+    switch (e->kind) {
+        case EXPR_UNARY:  fold_unary(e);  break;
+        case EXPR_BINARY: fold_binary(e); break;
+        default: break;
+    }
+}
+
+/* ============================================================
+   Statements (dead branch elimination)
+   ============================================================ */
+
+static Stmt* optimize_list(Stmt *first);
+
+static void free_branch(IfBranch *b) {
+    b->next = NULL;
+    parser_free_branches(b);
+}
+
+void opt_prune_if(Stmt *s, int *drop, Stmt **splice) {
+    IfBranch **link = &s->if_branches;
+
+    *drop = 0;
+    *splice = NULL;
+
+    while (*link) {
+        IfBranch *b = *link;
+
+        if (opt_is_lit(b->cond)) {
+            if (!opt_lit_truthy(&b->cond->as.lit)) {
+                *link = b->next;
+                free_branch(b);
+                continue;
+            }
+            /* always taken: it becomes the final 'alio' */
+            parser_free_expr(b->cond);
+            b->cond = NULL;
+            IfBranch *rest = b->next;
+            b->next = NULL;
+            while (rest) {
+                IfBranch *n = rest->next;
+                free_branch(rest);
+                rest = n;
+            }
+        }
+        link = &b->next;
+    }
+
+    if (!s->if_branches) {
+        *drop = 1;
+        return;
+    }
+
+    if (s->if_branches->cond == NULL) {
+        *splice = s->if_branches->body;
+        s->if_branches->body = NULL;
+        *drop = 1;
+    }
+}
+
+/* Folds every condition, drops branches that can never run, then
+   optimizes what is left; same *drop / *splice as opt_prune_if. */
+static void optimize_if(Stmt *s, int *drop, Stmt **splice) {
+    for (IfBranch *b = s->if_branches; b; b = b->next) {
+        if (b->cond) fold_expr(b->cond);
+    }
+
+    opt_prune_if(s, drop, splice);
+    if (*drop) {
+        *splice = optimize_list(*splice);
+        return;
+    }
+    for (IfBranch *b = s->if_branches; b; b = b->next) {
+        b->body = optimize_list(b->body);
+    }
+}
+
+static Stmt* optimize_list(Stmt *first) {
+    Stmt *head = NULL;
+    Stmt *tail = NULL;
+
+    Stmt *s = first;
+    while (s) {
+        Stmt *next = s->next;
+        s->next = NULL;
+
+        int drop = 0;
+        Stmt *splice = NULL;
+
+        switch (s->kind) {
+            case STMT_ASSIGN:
+                fold_expr(s->value);
+                break;
+            case STMT_CALL_PRINT:
+                fold_expr(s->arg);
+                break;
+            case STMT_IF:
+                optimize_if(s, &drop, &splice);
+                break;
+            default:
+                break;
+        }
+
+        if (drop) {
+            parser_free_program(s);
+            s = splice;     /* may be NULL or a (already optimized) list */
+        }
+
+        while (s) {
+            Stmt *n = s->next;
+            s->next = NULL;
+            if (!head) head = s;
+            else tail->next = s;
+            tail = s;
+            s = n;
+        }
+
+        s = next;
+    }
+
+    return head;
+}
+
+/* ============================================================
+   Public API
+   ============================================================ */
+
+Stmt* optimize_program(Stmt *first, int reused) {
+    first = optimize_list(first);
+    if (!reused) return first;
+
+    /* round trip through the SSA IR; on any failure keep the AST as is */
+    IrFunc *ir = ir_build(first);
+    if (!ir) return first;
+
+    ir_optimize(ir);
+
+    Stmt *lowered = NULL;
+    if (ir_lower(ir, &lowered)) {
+        parser_free_program(first);
+        first = lowered;
+    }
+    ir_free(ir);
+    return first;
+}
@@ -0,0 +1,43 @@
+// src/optimize.h
+#ifndef NOEMA_OPTIMIZE_H
+#define NOEMA_OPTIMIZE_H
+
+#include "parser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Rewrites the AST in place before execution.
+   Returns the (possibly new) head of the statement list; statements
+   removed by the passes are freed here. With `reused` (the result is
+   kept and run again: --cache, compiled C) it also goes through the SSA
+   IR, whose cost, about 1.7 us per statement, a single run does not
+   make back. */
+Stmt* optimize_program(Stmt *first, int reused);
+
+/* Literal arithmetic shared by the optimization passes. Each mirrors the
+   runtime exactly; fold_* return 0 when the operation must be left to
+   run time (it would raise, overflow, or not fit in a literal). */
+int opt_lit_truthy(const LiteralValue *v);
+int opt_lits_equal(const LiteralValue *a, const LiteralValue *b);
+int opt_fold_unary(ExprOp op, const LiteralValue *a, LiteralValue *out);
+int opt_fold_binary(ExprOp op, const LiteralValue *a, const LiteralValue *b, LiteralValue *out);
+
+/* AST rewriting shared with the specializer. opt_become_lit replaces `e`
+   (and frees its operands) with literal `v`, keeping its position.
+   opt_prune_if drops the branches of `s` whose condition is a false
+   literal, and turns the first one that is a true literal into the final
+   'alio'. It sets *drop when the statement must go away; *splice then
+   holds the body to put in its place (the chain collapsed to one
+   unconditional block) or NULL (no branch can ever run). Conditions are
+   not folded here, so callers fold them first. */
+int   opt_is_lit(const Expr *e);
+void  opt_become_lit(Expr *e, const LiteralValue *v);
+void  opt_prune_if(Stmt *s, int *drop, Stmt **splice);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
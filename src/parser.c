@@ -2,6 +2,7 @@
 #include "parser.h"
 #include "diag.h"
 
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -349,6 +350,46 @@ static Expr* parse_expr(Parser *p) {
     return parse_or(p);
 }
 
+/* ============================================================
+   Names
+   Call sites name one of a handful of members; rather than a buffer
+   per statement they share one copy of each name.
+   ============================================================ */
+
+typedef struct Interned {
+    struct Interned *next;
+    char name[];
+} Interned;
+
+static pthread_mutex_t intern_mu = PTHREAD_MUTEX_INITIALIZER;
+static Interned *interned;
+
+const char* parser_intern(const char *name) {
+    pthread_mutex_lock(&intern_mu);
+    Interned *n = interned;
+    while (n && strcmp(n->name, name) != 0) n = n->next;
+    if (!n) {
+        size_t len = strlen(name);
+        n = (Interned*)malloc(sizeof(Interned) + len + 1);
+        if (n) {
+            memcpy(n->name, name, len + 1);
+            n->next = interned;
+            interned = n;
+        }
+    }
+    pthread_mutex_unlock(&intern_mu);
+    return n ? n->name : NULL;
+}
+
+size_t parser_name_hash(const char *name) {
+    size_t h = 1469598103934665603ull;
+    for (; *name; name++) {
+        h ^= (unsigned char)*name;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
 /* ============================================================
    Statement allocation
    ============================================================ */
@@ -488,8 +529,10 @@ static void parse_print_call(Parser *p, ParseResult *r, Token ident) {
     expect(p, TOKEN_PAREN, "(", "expected '(' after sonus.dic");
     Stmt *s = new_stmt(STMT_CALL_PRINT, ident.line, ident.column);
     if (s) {
-        s->arg = parse_expr(p);
+        s->callee = parser_intern(ident.value);
+        if (!s->callee) { free(s); s = NULL; }
     }
+    if (s) s->arg = parse_expr(p);
     expect(p, TOKEN_PAREN, ")", "expected ')' after argument");
     append_stmt(r, s, p, &ident);
 }
@@ -609,6 +652,10 @@ static Stmt* parse_stmt(Parser *p) {
             /* print call statement */
             expect(p, TOKEN_PAREN, "(", "expected '(' after sonus.dic");
             Stmt *s = new_stmt(STMT_CALL_PRINT, ident.line, ident.column);
+            if (s) {
+                s->callee = parser_intern(ident.value);
+                if (!s->callee) { free(s); s = NULL; }
+            }
             if (s) s->arg = parse_expr(p);
             expect(p, TOKEN_PAREN, ")", "expected ')' after argument");
             return s;
@@ -743,6 +790,8 @@ static void free_stmt_list(Stmt *first) {
         } else if (s->kind == STMT_IF) {
             free_if_branches(s->if_branches);
             s->if_branches = NULL;
+            free(s->dispatch);
+            s->dispatch = NULL;
         }
 
         free(s);
@@ -754,3 +803,11 @@ void parser_free_program(Stmt *first) {
     free_stmt_list(first);
 }
 
+void parser_free_expr(Expr *e) {
+    expr_free(e);
+}
+
+void parser_free_branches(IfBranch *b) {
+    free_if_branches(b);
+}
+
@@ -59,6 +59,12 @@ typedef enum {
     OP_NEG
 } ExprOp;
 
+typedef struct {
+    LiteralKind lit_kind;
+    int int_value;                          // for int/bool
+    char text[NOEMA_TOKEN_VALUE_MAX];       // for string
+} LiteralValue;
+
 typedef struct Expr Expr;
 
 struct Expr {
@@ -67,14 +73,11 @@ struct Expr {
     int col;
 
     union {
-        struct {
-            LiteralKind lit_kind;
-            int int_value;                          // for int/bool
-            char text[NOEMA_TOKEN_VALUE_MAX];       // for string
-        } lit;
+        LiteralValue lit;
 
         struct {
             char name[NOEMA_TOKEN_VALUE_MAX];       // variable name
+            int slot;                               // resolved by the runtime
         } var;
 
         struct {
@@ -86,6 +89,9 @@ struct Expr {
             ExprOp op;
             Expr *lhs;
             Expr *rhs;
+            int div_plan;                   // runtime: constant divisor strategy, 0 = generic
+            int div_magic;                  // multiplier (DIV_MAGIC) or log2|d| (DIV_SHIFT)
+            int div_shift;                  // post-shift (DIV_MAGIC)
         } binary;
 
     } as;
@@ -97,6 +103,7 @@ struct Expr {
 
 typedef struct IfBranch {
     Expr *cond;                 // NULL means 'alio' (else)
+    int cond_shape;             // runtime superinstruction for cond, 0 = generic
     struct Stmt *body;          // linked list of statements in this block
     struct IfBranch *next;
 } IfBranch;
@@ -114,14 +121,25 @@ typedef struct Stmt {
 
     // assign
     char target[NOEMA_TOKEN_VALUE_MAX];
+    int target_slot;                        // resolved by the runtime
+    unsigned slot_stamp;                    // first statement of a program only: the
+                                            // runtime slot numbering its slots hold
     Expr *value;
 
     // print call
+    const char *callee;                     // dotted module member, e.g. "sonus.dic"
+                                            // (interned: see parser_intern)
     Expr *arg;
+    void *call_target;                      // inline cache: resolved member, valid
+    unsigned call_stamp;                    // while the module registry stamp matches
 
     // if
     IfBranch *if_branches;
 
+    int shape;                              // runtime superinstruction, 0 = generic
+    void *dispatch;                         // runtime lookup table for an si chain
+                                            // (one block, freed with the node)
+
     struct Stmt *next;
 } Stmt;
 
@@ -141,6 +159,17 @@ void        parser_destroy(Parser *p);
 
 ParseResult parser_parse_program(Parser *p);
 void        parser_free_program(Stmt *first);
+void        parser_free_expr(Expr *e);
+void        parser_free_branches(IfBranch *b);
+
+// Returns the copy of `name` shared by all programs for the life of the
+// process, or NULL if out of memory. Equal names give the same pointer.
+// Thread-safe.
+const char* parser_intern(const char *name);
+
+// FNV-1a hash of a variable name, for the name tables of the runtime and
+// the specializer.
+size_t      parser_name_hash(const char *name);
 
 #ifdef __cplusplus
 }
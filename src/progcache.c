@@ -0,0 +1,464 @@
+// src/progcache.c
+#define _DEFAULT_SOURCE
+#include "progcache.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#if defined(__unix__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define PCACHE_POSIX 1
+#endif
+
+/*
+   File layout (host byte order):
+
+     "NOEMAPC1"  u32 version  u32 root  u64 key  u64 words  u64 checksum
+     u64 ident
+     identity: `ident` bytes, padded to a word
+     payload: `words` u32 words
+
+   Payload records, each referenced by its word offset; a record only
+   refers to records before it (so decoding always terminates):
+
+     string  len  bytes (padded to a word)
+     expr    kind line col, then
+               literal: lit_kind int_value text
+               var:     name
+               unary:   op rhs
+               binary:  op lhs rhs
+     stmt    kind line col, then
+               import: module
+               assign: target value
+               print:  callee arg
+               si:     nbranches (cond body)*     cond NONE for alio
+     block   count stmt*
+
+   The key is the FNV-1a hash of the identity (it names the file), the
+   checksum the FNV-1a hash of everything after the header.
+*/
+
+#define PC_MAGIC "NOEMAPC1"
+#define PC_VERSION 2u
+#define PC_HEADER 48u
+#define PC_NONE 0xFFFFFFFFu
+#define PC_MAX_DEPTH 4096
+
+static uint64_t fnv(const void *p, size_t n) {
+    const unsigned char *b = (const unsigned char*)p;
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < n; i++) {
+        h ^= b[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static void cache_path(char *out, size_t cap, const char *dir, uint64_t key) {
+    snprintf(out, cap, "%s/%016llx.nprog", dir, (unsigned long long)key);
+}
+
+/* ============================================================
+   Encoding
+   ============================================================ */
+
+typedef struct {
+    uint32_t *w;
+    size_t n, cap;
+    int oom;
+} Words;
+
+static uint32_t put(Words *b, uint32_t v) {
+    if (b->oom) return PC_NONE;
+    if (b->n == b->cap) {
+        size_t cap = b->cap ? b->cap * 2 : 1024;
+        uint32_t *w = cap < PC_NONE ? (uint32_t*)realloc(b->w, cap * sizeof(uint32_t)) : NULL;
+        if (!w) { b->oom = 1; return PC_NONE; }
+        b->w = w;
+        b->cap = cap;
+    }
+    b->w[b->n] = v;
+    return (uint32_t)b->n++;
+}
+
+static uint32_t put_str(Words *b, const char *s) {
+    size_t len = strlen(s);
+    uint32_t at = put(b, (uint32_t)len);
+    for (size_t i = 0; i < len; i += 4) {
+        uint32_t v = 0;
+        memcpy(&v, s + i, len - i < 4 ? len - i : 4);
+        put(b, v);
+    }
+    return at;
+}
+
+static uint32_t enc_expr(Words *b, const Expr *e) {
+    if (!e) return PC_NONE;
+
+    uint32_t a = PC_NONE, c = PC_NONE;
+    switch (e->kind) {
+        case EXPR_LITERAL: a = put_str(b, e->as.lit.text); break;
+        case EXPR_VAR:     a = put_str(b, e->as.var.name); break;
+        case EXPR_UNARY:   a = enc_expr(b, e->as.unary.rhs); break;
+        case EXPR_BINARY:
+            a = enc_expr(b, e->as.binary.lhs);
+            c = enc_expr(b, e->as.binary.rhs);
+            break;
+    }
+
+    uint32_t at = put(b, (uint32_t)e->kind);
+    put(b, (uint32_t)e->line);
+    put(b, (uint32_t)e->col);
+    switch (e->kind) {
+        case EXPR_LITERAL:
+            put(b, (uint32_t)e->as.lit.lit_kind);
+            put(b, (uint32_t)e->as.lit.int_value);
+            put(b, a);
+            break;
+        case EXPR_VAR:
+            put(b, a);
+            break;
+        case EXPR_UNARY:
+            put(b, (uint32_t)e->as.unary.op);
+            put(b, a);
+            break;
+        case EXPR_BINARY:
+            put(b, (uint32_t)e->as.binary.op);
+            put(b, a);
+            put(b, c);
+            break;
+    }
+    return at;
+}
+
+static uint32_t enc_block(Words *b, const Stmt *first);
+
+static uint32_t enc_stmt(Words *b, const Stmt *s) {
+    uint32_t a = PC_NONE, c = PC_NONE;
+    uint32_t *refs = NULL;
+    int nb = 0;
+
+    switch (s->kind) {
+        case STMT_IMPORT:
+            a = put_str(b, s->module);
+            break;
+        case STMT_ASSIGN:
+            a = put_str(b, s->target);
+            c = enc_expr(b, s->value);
+            break;
+        case STMT_CALL_PRINT:
+            a = put_str(b, s->callee);
+            c = enc_expr(b, s->arg);
+            break;
+        case STMT_IF:
+            for (const IfBranch *br = s->if_branches; br; br = br->next) nb++;
+            refs = (uint32_t*)malloc(((size_t)nb * 2 + 1) * sizeof(uint32_t));
+            if (!refs) { b->oom = 1; return PC_NONE; }
+            nb = 0;
+            for (const IfBranch *br = s->if_branches; br; br = br->next, nb++) {
+                refs[2 * nb] = enc_expr(b, br->cond);
+                refs[2 * nb + 1] = enc_block(b, br->body);
+            }
+            break;
+    }
+
+    uint32_t at = put(b, (uint32_t)s->kind);
+    put(b, (uint32_t)s->line);
+    put(b, (uint32_t)s->col);
+    if (s->kind == STMT_IF) {
+        put(b, (uint32_t)nb);
+        for (int i = 0; i < 2 * nb; i++) put(b, refs[i]);
+    } else {
+        put(b, a);
+        if (s->kind != STMT_IMPORT) put(b, c);
+    }
+    free(refs);
+    return at;
+}
+
+static uint32_t enc_block(Words *b, const Stmt *first) {
+    int n = 0;
+    for (const Stmt *s = first; s; s = s->next) n++;
+
+    uint32_t *refs = (uint32_t*)malloc(((size_t)n + 1) * sizeof(uint32_t));
+    if (!refs) { b->oom = 1; return PC_NONE; }
+    n = 0;
+    for (const Stmt *s = first; s; s = s->next) refs[n++] = enc_stmt(b, s);
+
+    uint32_t at = put(b, (uint32_t)n);
+    for (int i = 0; i < n; i++) put(b, refs[i]);
+    free(refs);
+    return at;
+}
+
+/* ============================================================
+   Decoding
+   ============================================================ */
+
+typedef struct {
+    const uint32_t *w;
+    uint32_t n;
+    int depth;
+    int bad;
+} Dec;
+
+/* Word `i` of the record at `at`, which must come before `before`. */
+static uint32_t word(Dec *d, uint32_t at, uint32_t i, uint32_t before) {
+    if (d->bad || at >= before || i >= d->n - at) { d->bad = 1; return 0; }
+    return d->w[at + i];
+}
+
+static void dec_str(Dec *d, uint32_t at, uint32_t before, char *out) {
+    uint32_t len = word(d, at, 0, before);
+    if (d->bad || len >= NOEMA_TOKEN_VALUE_MAX || (len + 3) / 4 >= d->n - at) {
+        d->bad = 1;
+        out[0] = '\0';
+        return;
+    }
+    memcpy(out, d->w + at + 1, len);
+    out[len] = '\0';
+    if (memchr(out, '\0', len)) d->bad = 1;
+}
+
+static int valid_op(uint32_t op, int binary) {
+    if (binary) return op >= OP_ADD && op <= OP_OR;
+    return op == OP_NOT || op == OP_NEG;
+}
+
+static Expr* dec_expr(Dec *d, uint32_t at, uint32_t before) {
+    if (d->bad || ++d->depth > PC_MAX_DEPTH) { d->bad = 1; return NULL; }
+
+    Expr *e = (Expr*)calloc(1, sizeof(Expr));
+    if (!e) { d->bad = 1; return NULL; }
+    uint32_t kind = word(d, at, 0, before);
+    e->kind = (ExprKind)kind;
+    e->line = (int)word(d, at, 1, before);
+    e->col = (int)word(d, at, 2, before);
+
+    switch (kind) {
+        case EXPR_LITERAL: {
+            uint32_t lk = word(d, at, 3, before);
+            if (lk < LIT_INT || lk > LIT_NULL) d->bad = 1;
+            e->as.lit.lit_kind = (LiteralKind)lk;
+            e->as.lit.int_value = (int)word(d, at, 4, before);
+            dec_str(d, word(d, at, 5, before), at, e->as.lit.text);
+            break;
+        }
+        case EXPR_VAR:
+            dec_str(d, word(d, at, 3, before), at, e->as.var.name);
+            break;
+        case EXPR_UNARY:
+            e->as.unary.op = (ExprOp)word(d, at, 3, before);
+            if (!valid_op(e->as.unary.op, 0)) d->bad = 1;
+            e->as.unary.rhs = dec_expr(d, word(d, at, 4, before), at);
+            break;
+        case EXPR_BINARY:
+            e->as.binary.op = (ExprOp)word(d, at, 3, before);
+            if (!valid_op(e->as.binary.op, 1)) d->bad = 1;
+            e->as.binary.lhs = dec_expr(d, word(d, at, 4, before), at);
+            e->as.binary.rhs = dec_expr(d, word(d, at, 5, before), at);
+            break;
+        default:
+            d->bad = 1;
+            break;
+    }
+
+    d->depth--;
+    if (d->bad) {
+        parser_free_expr(e);
+        return NULL;
+    }
+    return e;
+}
+
+static Stmt* dec_block(Dec *d, uint32_t at, uint32_t before);
+
+static Stmt* dec_stmt(Dec *d, uint32_t at, uint32_t before) {
+    Stmt *s = (Stmt*)calloc(1, sizeof(Stmt));
+    if (!s) { d->bad = 1; return NULL; }
+    uint32_t kind = word(d, at, 0, before);
+    s->kind = (StmtKind)kind;
+    s->line = (int)word(d, at, 1, before);
+    s->col = (int)word(d, at, 2, before);
+
+    switch (kind) {
+        case STMT_IMPORT:
+            dec_str(d, word(d, at, 3, before), at, s->module);
+            break;
+        case STMT_ASSIGN:
+            dec_str(d, word(d, at, 3, before), at, s->target);
+            s->value = dec_expr(d, word(d, at, 4, before), at);
+            break;
+        case STMT_CALL_PRINT: {
+            char callee[NOEMA_TOKEN_VALUE_MAX];
+            dec_str(d, word(d, at, 3, before), at, callee);
+            s->callee = parser_intern(callee);
+            if (!s->callee) d->bad = 1;
+            s->arg = dec_expr(d, word(d, at, 4, before), at);
+            break;
+        }
+        case STMT_IF: {
+            uint32_t nb = word(d, at, 3, before);
+            IfBranch **tail = &s->if_branches;
+            for (uint32_t i = 0; i < nb && !d->bad; i++) {
+                IfBranch *br = (IfBranch*)calloc(1, sizeof(IfBranch));
+                if (!br) { d->bad = 1; break; }
+                *tail = br;
+                tail = &br->next;
+
+                uint32_t cond = word(d, at, 4 + 2 * i, before);
+                int is_alio = cond == PC_NONE;
+                if (is_alio && i + 1 != nb) d->bad = 1;     /* alio comes last */
+                if (!is_alio) br->cond = dec_expr(d, cond, at);
+                br->body = dec_block(d, word(d, at, 5 + 2 * i, before), at);
+            }
+            if (nb == 0) d->bad = 1;
+            break;
+        }
+        default:
+            d->bad = 1;
+            break;
+    }
+    return s;
+}
+
+static Stmt* dec_block(Dec *d, uint32_t at, uint32_t before) {
+    if (d->bad || ++d->depth > PC_MAX_DEPTH) { d->bad = 1; return NULL; }
+
+    Stmt *first = NULL, **tail = &first;
+    uint32_t n = word(d, at, 0, before);
+    for (uint32_t i = 0; i < n && !d->bad; i++) {
+        Stmt *s = dec_stmt(d, word(d, at, 1 + i, before), at);
+        if (!s) break;
+        *tail = s;
+        tail = &s->next;
+    }
+
+    d->depth--;
+    if (d->bad) {
+        parser_free_program(first);
+        return NULL;
+    }
+    return first;
+}
+
+/* ============================================================
+   Files
+   ============================================================ */
+
+#ifdef PCACHE_POSIX
+
+Stmt* pcache_load(const char *dir, const void *ident, size_t len) {
+    char path[4096];
+    if (!dir) return NULL;
+    uint64_t key = fnv(ident, len);
+    cache_path(path, sizeof(path), dir, key);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)PC_HEADER || (st.st_size - PC_HEADER) % 4 != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = (size_t)st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    const unsigned char *p = (const unsigned char*)map;
+    uint32_t version, root;
+    uint64_t fkey, words, sum, flen;
+    memcpy(&version, p + 8, 4);
+    memcpy(&root, p + 12, 4);
+    memcpy(&fkey, p + 16, 8);
+    memcpy(&words, p + 24, 8);
+    memcpy(&sum, p + 32, 8);
+    memcpy(&flen, p + 40, 8);
+
+    /* the identity must match in full: the key is only a hash of it */
+    size_t padded = (len + 3) & ~(size_t)3;
+    Stmt *program = NULL;
+    if (memcmp(p, PC_MAGIC, 8) == 0 && version == PC_VERSION && fkey == key &&
+        flen == len && padded <= size - PC_HEADER && words < PC_NONE &&
+        words == (size - PC_HEADER - padded) / 4 &&
+        memcmp(p + PC_HEADER, ident, len) == 0 &&
+        sum == fnv(p + PC_HEADER, size - PC_HEADER)) {
+        Dec d;
+        memset(&d, 0, sizeof(d));
+        d.w = (const uint32_t*)(const void*)(p + PC_HEADER + padded);
+        d.n = (uint32_t)words;
+        program = dec_block(&d, root, d.n);
+        if (d.bad) program = NULL;      /* dec_block already freed it */
+    }
+
+    munmap(map, size);
+    return program;
+}
+
+int pcache_store(const char *dir, const void *ident, size_t len, const Stmt *program) {
+    if (!dir) return 0;
+
+    Words b;
+    memset(&b, 0, sizeof(b));
+    uint32_t root = enc_block(&b, program);
+    if (b.oom) { free(b.w); return 0; }
+
+    /* identity and payload, as the checksum covers them */
+    size_t padded = (len + 3) & ~(size_t)3;
+    size_t body_n = padded + b.n * sizeof(uint32_t);
+    unsigned char *body = (unsigned char*)calloc(1, body_n ? body_n : 1);
+    if (!body) { free(b.w); return 0; }
+    memcpy(body, ident, len);
+    memcpy(body + padded, b.w, b.n * sizeof(uint32_t));
+    free(b.w);
+
+    unsigned char header[PC_HEADER];
+    uint32_t version = PC_VERSION;
+    uint64_t key = fnv(ident, len), words = b.n, sum = fnv(body, body_n), flen = len;
+    memcpy(header, PC_MAGIC, 8);
+    memcpy(header + 8, &version, 4);
+    memcpy(header + 12, &root, 4);
+    memcpy(header + 16, &key, 8);
+    memcpy(header + 24, &words, 8);
+    memcpy(header + 32, &sum, 8);
+    memcpy(header + 40, &flen, 8);
+
+    char path[4096], tmp[4200];
+    cache_path(path, sizeof(path), dir, key);
+    snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", path, (long)getpid());
+    mkdir(dir, 0777);
+
+    int ok = 0;
+    FILE *out = fopen(tmp, "wb");
+    if (out) {
+        ok = fwrite(header, 1, PC_HEADER, out) == PC_HEADER &&
+             fwrite(body, 1, body_n, out) == body_n;
+        if (fclose(out) != 0) ok = 0;
+        if (ok && rename(tmp, path) != 0) ok = 0;
+        if (!ok) remove(tmp);
+    }
+
+    free(body);
+    return ok;
+}
+
+#else
+
+Stmt* pcache_load(const char *dir, const void *ident, size_t len) {
+    (void)dir; (void)ident; (void)len; (void)dec_block;
+    return NULL;
+}
+
+int pcache_store(const char *dir, const void *ident, size_t len, const Stmt *program) {
+    (void)dir; (void)ident; (void)len; (void)program; (void)enc_block; (void)cache_path; (void)fnv;
+    return 0;
+}
+
+#endif
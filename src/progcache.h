@@ -0,0 +1,40 @@
+// src/progcache.h
+#ifndef NOEMA_PROGCACHE_H
+#define NOEMA_PROGCACHE_H
+
+#include <stddef.h>
+
+#include "parser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+   Cross-process cache of parsed and optimized programs.
+
+   Each program is one file in a cache directory, named after a hash of
+   its identity: the source and the options that change the program, as
+   bytes. The file also holds the identity in full, and a load compares
+   it, so two programs whose hashes collide never share an entry.
+   The file holds the AST in a flat encoding whose references are
+   offsets, so it is read straight from an mmap of the file. Writers
+   build the file under a private name and rename it into place, so a
+   reader needs no lock: it sees the old file, the new one, or none.
+   Every offset, kind and length is checked before it is followed; a
+   file that does not check out is a miss.
+*/
+
+/* The cached program for the `len` bytes of `ident`, as a fresh AST
+   (free it with parser_free_program), or NULL on a miss. */
+Stmt* pcache_load(const char *dir, const void *ident, size_t len);
+
+/* Stores `program` under `ident`, creating `dir` if needed. Returns 1 on
+   success; a failure only means the next run parses again. */
+int   pcache_store(const char *dir, const void *ident, size_t len, const Stmt *program);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,1020 @@
+// src/rules.c
+#define _DEFAULT_SOURCE
+#include "rules.h"
+#include "runtime.h"
+#include "specialize.h"
+#include "columns.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RULES_BATCH COLUMNS_BLOCK /* records per batch */
+#define RULES_QUEUE 4           /* batches parsed ahead */
+#define RULES_CHUNK (256 << 10) /* bytes of input per chunk, with several threads */
+#define RULES_MAX_JOBS 1024
+
+/* ============================================================
+   Batches
+   ============================================================ */
+
+typedef struct {
+    int input;                  /* index into the input table */
+    LiteralValue value;
+} Field;
+
+typedef struct {
+    Field *fields;
+    int nfields, capfields;
+    int *ends;                  /* per record: one past its last field */
+    long *lines;                /* per record: line in the input */
+    int nrecs, caprecs;
+    int last;                   /* nothing follows this batch */
+    char err[512];              /* why reading stopped, if it failed */
+} Batch;
+
+static void batch_clear(Batch *b) {
+    b->nfields = 0;
+    b->nrecs = 0;
+    b->last = 0;
+    b->err[0] = '\0';
+}
+
+static void batch_free(Batch *b) {
+    free(b->fields);
+    free(b->ends);
+    free(b->lines);
+}
+
+static Field* batch_field(Batch *b) {
+    if (b->nfields == b->capfields) {
+        int cap = b->capfields ? b->capfields * 2 : 1024;
+        Field *f = (Field*)realloc(b->fields, (size_t)cap * sizeof(Field));
+        if (!f) return NULL;
+        b->fields = f;
+        b->capfields = cap;
+    }
+    return &b->fields[b->nfields++];
+}
+
+static int batch_end_record(Batch *b, long line) {
+    if (b->nrecs == b->caprecs) {
+        int cap = b->caprecs ? b->caprecs * 2 : RULES_BATCH;
+        int *e = (int*)realloc(b->ends, (size_t)cap * sizeof(int));
+        if (!e) return 0;
+        b->ends = e;
+        long *l = (long*)realloc(b->lines, (size_t)cap * sizeof(long));
+        if (!l) return 0;
+        b->lines = l;
+        b->caprecs = cap;
+    }
+    b->ends[b->nrecs] = b->nfields;
+    b->lines[b->nrecs] = line;
+    b->nrecs++;
+    return 1;
+}
+
+/* ============================================================
+   Reader
+   ============================================================ */
+
+/* How records are parsed. Each thread that parses has its own copy;
+   only `lineno` changes after the header is read. */
+typedef struct {
+    const char *name;
+    int format;
+    const SpecInput *inputs;
+    int ninputs;
+    int *cols;                  /* CSV: input per column, -1 = unused */
+    int ncols;
+    long lineno;                /* line being parsed */
+} Reader;
+
+/* Input index for a field name; -1 if the program does not use it. */
+static int field_input(Reader *r, const char *name, char *err, int cap) {
+    int lo = 0, hi = r->ninputs - 1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        int c = strcmp(r->inputs[mid].name, name);
+        if (c == 0) {
+            SpecInputKind k = r->inputs[mid].kind;
+            if (k == SPEC_INPUT || k == SPEC_FREE) return mid;
+            snprintf(err, cap, "%s:%ld: field '%s' is not an input of the rules (%s)", r->name, r->lineno, name,
+                     k == SPEC_LATE ? "its default is assigned after other statements"
+                                    : "it is first assigned from an expression");
+            return -2;
+        }
+        if (c < 0) lo = mid + 1; else hi = mid - 1;
+    }
+    return -1;
+}
+
+static void set_text(LiteralValue *v, const char *s, size_t n) {
+    v->lit_kind = LIT_STRING;
+    v->int_value = 0;
+    memcpy(v->text, s, n);
+    v->text[n] = '\0';
+}
+
+/* Splits one CSV line in place. Calls `cell` with each field; returns 0
+   with a message in err on malformed input. */
+static int csv_split(Reader *r, char *p, char *err, int cap,
+                     int (*cell)(Reader*, int, const char*, size_t, int, void*, char*, int), void *ctx) {
+    int col = 0;
+    for (;;) {
+        const char *start = p;
+        size_t n;
+        int quoted = *p == '"';
+
+        if (quoted) {
+            char *w = p;
+            const char *q = p + 1;
+            start = w;
+            for (;;) {
+                if (*q == '\0') {
+                    snprintf(err, cap, "%s:%ld: unterminated quoted field", r->name, r->lineno);
+                    return 0;
+                }
+                if (*q == '"') {
+                    if (q[1] != '"') break;
+                    q++;
+                }
+                *w++ = *q++;
+            }
+            n = (size_t)(w - start);
+            p = (char*)q + 1;
+            if (*p != ',' && *p != '\0') {
+                snprintf(err, cap, "%s:%ld: text after a quoted field", r->name, r->lineno);
+                return 0;
+            }
+        } else {
+            while (*p && *p != ',') p++;
+            n = (size_t)(p - start);
+        }
+
+        if (n >= NOEMA_TOKEN_VALUE_MAX) {
+            snprintf(err, cap, "%s:%ld: field %d is longer than %d bytes",
+                     r->name, r->lineno, col + 1, NOEMA_TOKEN_VALUE_MAX - 1);
+            return 0;
+        }
+        if (!cell(r, col, start, n, quoted, ctx, err, cap)) return 0;
+        col++;
+
+        if (*p == '\0') return 1;
+        p++;
+    }
+}
+
+static int csv_header_cell(Reader *r, int col, const char *s, size_t n, int quoted,
+                           void *ctx, char *err, int cap) {
+    (void)quoted; (void)ctx;
+    int *cols = (int*)realloc(r->cols, (size_t)(col + 1) * sizeof(int));
+    if (!cols) {
+        snprintf(err, cap, "noema: out of memory");
+        return 0;
+    }
+    r->cols = cols;
+    r->ncols = col + 1;
+
+    char name[NOEMA_TOKEN_VALUE_MAX];
+    memcpy(name, s, n);
+    name[n] = '\0';
+    cols[col] = field_input(r, name, err, cap);
+    return cols[col] != -2;
+}
+
+static int csv_record_cell(Reader *r, int col, const char *s, size_t n, int quoted,
+                           void *ctx, char *err, int cap) {
+    if (col >= r->ncols) {
+        snprintf(err, cap, "%s:%ld: more fields than the header has", r->name, r->lineno);
+        return 0;
+    }
+    if (r->cols[col] < 0) return 1;
+
+    Field *f = batch_field((Batch*)ctx);
+    if (!f) {
+        snprintf(err, cap, "noema: out of memory");
+        return 0;
+    }
+    f->input = r->cols[col];
+    if (quoted) {
+        memset(&f->value, 0, sizeof(f->value));
+        set_text(&f->value, s, n);
+    } else if (!spec_parse_value(s, n, &f->value)) {
+        snprintf(err, cap, "%s:%ld: field %d: only integers that fit 32 bits are supported",
+                 r->name, r->lineno, col + 1);
+        return 0;
+    }
+    return 1;
+}
+
+/* ---- JSON Lines ---- */
+
+static const char* json_ws(const char *p) {
+    while (*p == ' ' || *p == '\t' || *p == '\r') p++;
+    return p;
+}
+
+static void put_utf8(char *out, size_t *n, unsigned c) {
+    if (c < 0x80) {
+        out[(*n)++] = (char)c;
+    } else if (c < 0x800) {
+        out[(*n)++] = (char)(0xC0 | (c >> 6));
+        out[(*n)++] = (char)(0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+        out[(*n)++] = (char)(0xE0 | (c >> 12));
+        out[(*n)++] = (char)(0x80 | ((c >> 6) & 0x3F));
+        out[(*n)++] = (char)(0x80 | (c & 0x3F));
+    } else {
+        out[(*n)++] = (char)(0xF0 | (c >> 18));
+        out[(*n)++] = (char)(0x80 | ((c >> 12) & 0x3F));
+        out[(*n)++] = (char)(0x80 | ((c >> 6) & 0x3F));
+        out[(*n)++] = (char)(0x80 | (c & 0x3F));
+    }
+}
+
+static int hex4(const char *p, unsigned *out) {
+    unsigned v = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        v <<= 4;
+        if (c >= '0' && c <= '9') v |= (unsigned)(c - '0');
+        else if (c >= 'a' && c <= 'f') v |= (unsigned)(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') v |= (unsigned)(c - 'A' + 10);
+        else return 0;
+    }
+    *out = v;
+    return 1;
+}
+
+/* A JSON string at p (after the opening quote) into out; NULL if malformed
+   or too long for a Noema string. */
+static const char* json_string(const char *p, char *out, size_t *len) {
+    size_t n = 0;
+    while (*p != '"') {
+        if (*p == '\0' || (unsigned char)*p < 0x20) return NULL;
+        if (n + 4 >= NOEMA_TOKEN_VALUE_MAX) return NULL;
+
+        if (*p != '\\') { out[n++] = *p++; continue; }
+        p++;
+        switch (*p) {
+            case '"':  out[n++] = '"'; break;
+            case '\\': out[n++] = '\\'; break;
+            case '/':  out[n++] = '/'; break;
+            case 'b':  out[n++] = '\b'; break;
+            case 'f':  out[n++] = '\f'; break;
+            case 'n':  out[n++] = '\n'; break;
+            case 'r':  out[n++] = '\r'; break;
+            case 't':  out[n++] = '\t'; break;
+            case 'u': {
+                unsigned c;
+                if (!hex4(p + 1, &c) || c == 0) return NULL;
+                p += 4;
+                if (c >= 0xD800 && c < 0xDC00) {            /* surrogate pair */
+                    unsigned lo;
+                    if (p[1] != '\\' || p[2] != 'u' || !hex4(p + 3, &lo) || lo < 0xDC00 || lo > 0xDFFF) {
+                        return NULL;
+                    }
+                    c = 0x10000 + ((c - 0xD800) << 10) + (lo - 0xDC00);
+                    p += 6;
+                } else if (c >= 0xDC00 && c <= 0xDFFF) {
+                    return NULL;
+                }
+                put_utf8(out, &n, c);
+                break;
+            }
+            default:
+                return NULL;
+        }
+        p++;
+    }
+    out[n] = '\0';
+    *len = n;
+    return p + 1;
+}
+
+static int json_record(Reader *r, const char *p, Batch *b, char *err, int cap) {
+    char key[NOEMA_TOKEN_VALUE_MAX];
+    size_t klen;
+
+    p = json_ws(p);
+    if (*p++ != '{') goto bad;
+    p = json_ws(p);
+    if (*p == '}') {
+        if (*json_ws(p + 1) != '\0') goto bad;
+        return 1;
+    }
+
+    for (;;) {
+        if (*p++ != '"' || !(p = json_string(p, key, &klen))) goto bad;
+        p = json_ws(p);
+        if (*p++ != ':') goto bad;
+        p = json_ws(p);
+
+        LiteralValue v;
+        memset(&v, 0, sizeof(v));
+        if (*p == '"') {
+            size_t n;
+            v.lit_kind = LIT_STRING;
+            if (!(p = json_string(p + 1, v.text, &n))) goto bad;
+        } else if (strncmp(p, "true", 4) == 0) {
+            v.lit_kind = LIT_BOOL;
+            v.int_value = 1;
+            p += 4;
+        } else if (strncmp(p, "false", 5) == 0) {
+            v.lit_kind = LIT_BOOL;
+            p += 5;
+        } else if (strncmp(p, "null", 4) == 0) {
+            v.lit_kind = LIT_NULL;
+            p += 4;
+        } else if (*p == '-' || (*p >= '0' && *p <= '9')) {
+            const char *s = p;
+            if (*p == '-') p++;
+            while (*p >= '0' && *p <= '9') p++;
+            if (*p == '.' || *p == 'e' || *p == 'E' || !spec_parse_value(s, (size_t)(p - s), &v) ||
+                v.lit_kind != LIT_INT) {
+                snprintf(err, cap, "%s:%ld: field '%s': only integers that fit 32 bits are supported",
+                         r->name, r->lineno, key);
+                return 0;
+            }
+        } else {
+            snprintf(err, cap, "%s:%ld: field '%s': only strings, integers, true, false and null are supported",
+                     r->name, r->lineno, key);
+            return 0;
+        }
+
+        int in = field_input(r, key, err, cap);
+        if (in == -2) return 0;
+        if (in >= 0) {
+            Field *f = batch_field(b);
+            if (!f) {
+                snprintf(err, cap, "noema: out of memory");
+                return 0;
+            }
+            f->input = in;
+            f->value = v;
+        }
+
+        p = json_ws(p);
+        if (*p == ',') { p = json_ws(p + 1); continue; }
+        if (*p++ != '}') goto bad;
+        if (*json_ws(p) != '\0') goto bad;
+        return 1;
+    }
+
+bad:
+    snprintf(err, cap, "%s:%ld: expected one flat JSON object per line", r->name, r->lineno);
+    return 0;
+}
+
+/* Next non-blank line of `in` without its line break; NULL at end of input. */
+static char* next_line(FILE *in, char **line, size_t *cap, long *lineno) {
+    for (;;) {
+        ssize_t n = getline(line, cap, in);
+        if (n < 0) return NULL;
+        (*lineno)++;
+        char *l = *line;
+        while (n > 0 && (l[n - 1] == '\n' || l[n - 1] == '\r')) l[--n] = '\0';
+        if (n > 0) return l;
+    }
+}
+
+/* Adds the record on `line` to `b`. On failure the batch is left as it
+   was, with the reason in b->err. */
+static int parse_record(Reader *r, char *line, Batch *b) {
+    int start = b->nfields;
+    int ok = r->format == RULES_CSV
+        ? csv_split(r, line, b->err, (int)sizeof(b->err), csv_record_cell, b)
+        : json_record(r, line, b, b->err, (int)sizeof(b->err));
+    if (!ok || !batch_end_record(b, r->lineno)) {
+        if (!b->err[0]) snprintf(b->err, sizeof(b->err), "noema: out of memory");
+        b->nfields = start;
+        return 0;
+    }
+    return 1;
+}
+
+/* ============================================================
+   Evaluation
+   ============================================================ */
+
+static int pick_format(const char *input, FILE *in, int format) {
+    if (format != RULES_AUTO) return format;
+
+    const char *dot = strrchr(input, '.');
+    if (dot && strcmp(dot, ".csv") == 0) return RULES_CSV;
+    if (dot && (strcmp(dot, ".jsonl") == 0 || strcmp(dot, ".ndjson") == 0)) return RULES_JSONL;
+
+    int c;
+    while ((c = fgetc(in)) == ' ' || c == '\t' || c == '\r' || c == '\n') { }
+    if (c != EOF) ungetc(c, in);
+    return c == '{' ? RULES_JSONL : RULES_CSV;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+typedef struct {
+    Stmt *program;
+    const char *path;           /* of the rules, for runtime errors */
+    const char *input;          /* of the records */
+    const SpecInput *inputs;
+    int ninputs;
+    const int *slot;            /* per input: its variable, the same in every runtime */
+    int columns;                /* settle conditions a block at a time (see columns.h) */
+} Rules;
+
+/* Where each runtime error was reported: how much had been printed to
+   `out` before it, and the end of its message in `errs`. */
+typedef struct {
+    long *at;                   /* pairs */
+    int n, cap;
+} Marks;
+
+static int mark(Marks *m, FILE *out, FILE *errs) {
+    if (m->n == m->cap) {
+        int cap = m->cap ? m->cap * 2 : 64;
+        long *at = (long*)realloc(m->at, (size_t)cap * 2 * sizeof(long));
+        if (!at) return 0;
+        m->at = at;
+        m->cap = cap;
+    }
+    m->at[2 * m->n] = ftell(out);
+    m->at[2 * m->n + 1] = ftell(errs);
+    m->n++;
+    return 1;
+}
+
+/* Runs the records of `b` in `rt`, which prints to `out`; runtime errors
+   go to `errs` and, if `m` is given, are marked there. With `cols`, a
+   record whose rules it settles runs only the bodies of those that
+   fire. `val` has room for a value per input. Returns how many records
+   failed, or -1 if out of memory. */
+static long run_batch(const Rules *ru, Runtime *rt, Columns *cols, const Batch *b,
+                      const LiteralValue **val, FILE *out, FILE *errs, Marks *m) {
+    if (cols) {
+        columns_begin(cols, b->nrecs);
+        int f = 0;
+        for (int k = 0; k < b->nrecs; k++) {
+            for (; f < b->ends[k]; f++) columns_set(cols, k, b->fields[f].input, &b->fields[f].value);
+        }
+        columns_select(cols);
+    }
+
+    long failed = 0;
+    int f = 0;
+    for (int k = 0; k < b->nrecs; k++) {
+        Stmt *const *bodies = NULL;
+        int nbodies = cols ? columns_fired(cols, k, &bodies) : -1;
+        if (nbodies == 0) {
+            f = b->ends[k];
+            continue;
+        }
+
+        for (int i = 0; i < ru->ninputs; i++) {
+            val[i] = ru->inputs[i].kind == SPEC_INPUT ? &ru->inputs[i].value : NULL;
+        }
+        for (; f < b->ends[k]; f++) val[b->fields[f].input] = &b->fields[f].value;
+
+        runtime_reset(rt);
+        char rt_err[512];
+        rt_err[0] = '\0';
+        int run = 1;
+        for (int i = 0; i < ru->ninputs && run; i++) {
+            if (val[i] && !runtime_set_var(rt, ru->slot[i], val[i])) {
+                snprintf(rt_err, sizeof(rt_err), "%s: runtime error: too many variables", ru->path);
+                run = 0;
+            }
+        }
+        if (run && nbodies < 0) run = runtime_exec(rt, ru->program, ru->path, rt_err, (int)sizeof(rt_err));
+        for (int i = 0; run && i < nbodies; i++) {
+            run = runtime_exec_block(rt, ru->program, bodies[i], ru->path, rt_err, (int)sizeof(rt_err));
+        }
+
+        if (!run) {
+            failed++;
+            fflush(out);
+            fprintf(errs, "%s:%ld: %s\n", ru->input, b->lines[k], rt_err[0] ? rt_err : "runtime error");
+            if (m && !mark(m, out, errs)) return -1;
+        }
+    }
+    return failed;
+}
+
+/* ---- One thread: the reader parses the next batch meanwhile ---- */
+
+typedef struct {
+    Reader r;
+    FILE *in;
+    char *line;
+    size_t linecap;
+
+    pthread_mutex_t mu;
+    pthread_cond_t can_put, can_take;
+    Batch q[RULES_QUEUE];
+    int head, count;
+} Feed;
+
+/* Fills `b` with up to RULES_BATCH records. */
+static void read_batch(Feed *f, Batch *b) {
+    batch_clear(b);
+    while (b->nrecs < RULES_BATCH) {
+        char *line = next_line(f->in, &f->line, &f->linecap, &f->r.lineno);
+        if (!line) {
+            if (ferror(f->in)) snprintf(b->err, sizeof(b->err), "%s: read error", f->r.name);
+            b->last = 1;
+            return;
+        }
+        if (!parse_record(&f->r, line, b)) {
+            b->last = 1;
+            return;
+        }
+    }
+}
+
+static void* feed_main(void *arg) {
+    Feed *f = (Feed*)arg;
+    for (;;) {
+        pthread_mutex_lock(&f->mu);
+        while (f->count == RULES_QUEUE) pthread_cond_wait(&f->can_put, &f->mu);
+        Batch *b = &f->q[(f->head + f->count) % RULES_QUEUE];
+        pthread_mutex_unlock(&f->mu);
+
+        read_batch(f, b);          /* the slot is ours until it is counted */
+        int last = b->last;
+
+        pthread_mutex_lock(&f->mu);
+        f->count++;
+        pthread_cond_signal(&f->can_take);
+        pthread_mutex_unlock(&f->mu);
+        if (last) return NULL;
+    }
+}
+
+static Batch* take_batch(Feed *f) {
+    pthread_mutex_lock(&f->mu);
+    while (f->count == 0) pthread_cond_wait(&f->can_take, &f->mu);
+    Batch *b = &f->q[f->head];
+    pthread_mutex_unlock(&f->mu);
+    return b;
+}
+
+static void release_batch(Feed *f) {
+    pthread_mutex_lock(&f->mu);
+    f->head = (f->head + 1) % RULES_QUEUE;
+    f->count--;
+    pthread_cond_signal(&f->can_put);
+    pthread_mutex_unlock(&f->mu);
+}
+
+static int run_serial(const Rules *ru, const Reader *r, FILE *in, Runtime *rt,
+                      RulesStats *st, char *err, int cap) {
+    Feed f;
+    memset(&f, 0, sizeof(f));
+    f.r = *r;
+    f.in = in;
+
+    const LiteralValue **val = (const LiteralValue**)malloc(((size_t)ru->ninputs + 1) * sizeof(*val));
+    Columns *cols = ru->columns ? columns_build(ru->program, ru->inputs, ru->ninputs) : NULL;
+    if (!val) {
+        columns_free(cols);
+        snprintf(err, cap, "noema: out of memory");
+        return 0;
+    }
+
+    pthread_t reader;
+    pthread_mutex_init(&f.mu, NULL);
+    pthread_cond_init(&f.can_put, NULL);
+    pthread_cond_init(&f.can_take, NULL);
+    int started = pthread_create(&reader, NULL, feed_main, &f) == 0;
+    int ok = started;
+    if (!started) snprintf(err, cap, "noema: cannot start the record reader");
+
+    double t0 = now_seconds();
+    while (started) {
+        Batch *b = take_batch(&f);
+        st->failed += run_batch(ru, rt, cols, b, val, stdout, stderr, NULL);
+        st->records += b->nrecs;
+
+        int last = b->last;
+        if (b->err[0]) {
+            snprintf(err, cap, "%s", b->err);
+            ok = 0;
+        }
+        release_batch(&f);
+        if (last) break;
+    }
+    st->seconds = now_seconds() - t0;
+    fflush(stdout);
+
+    if (started) pthread_join(reader, NULL);
+    pthread_mutex_destroy(&f.mu);
+    pthread_cond_destroy(&f.can_put);
+    pthread_cond_destroy(&f.can_take);
+    for (int i = 0; i < RULES_QUEUE; i++) batch_free(&f.q[i]);
+    free(f.line);
+    free((void*)val);
+    columns_free(cols);
+    return ok;
+}
+
+/* ---- Several threads ----
+   The reader only cuts the input into chunks of whole lines. Workers
+   take the chunks in order, each parsing and running its chunk in its
+   own runtime (a clone of the first, sharing the program) and printing
+   into the chunk's buffers; the calling thread writes the buffers out
+   in input order, so the output is what one thread would print. */
+
+typedef struct {
+    char *text;                 /* whole lines */
+    size_t ntext, captext;
+    long line;                  /* lines before the first of them */
+    int last;                   /* nothing follows this chunk */
+    int done;                   /* run; the buffers are ready */
+    char *out, *errs;           /* what its records printed, and their errors */
+    size_t nout, nerrs;
+    Marks marks;                /* where the errors go between the output */
+    long records, failed;
+    char err[512];              /* why reading stopped, if it failed */
+} Chunk;
+
+typedef struct {
+    FILE *in;
+    const char *name;
+    char *carry;                /* the partial line after the last chunk */
+    size_t ncarry, capcarry;
+    long lineno;
+
+    pthread_mutex_t mu;
+    pthread_cond_t can_put, can_take, can_write;
+    Chunk *q;                   /* chunk i is q[i % nq] */
+    int nq;
+    long produced, claimed, written;
+    int finished;               /* the last chunk has been claimed */
+    int stop;                   /* the writer is done; drop the rest */
+} Pool;
+
+typedef struct {
+    Pool *pool;
+    const Rules *rules;
+    Reader r;                   /* this worker's copy */
+    Runtime *rt;
+    Columns *cols;
+    Batch b;
+    const LiteralValue **val;
+    pthread_t thread;
+} Worker;
+
+static int reserve(char **buf, size_t *cap, size_t need) {
+    if (need <= *cap) return 1;
+    size_t n = *cap ? *cap : RULES_CHUNK;
+    while (n < need) n *= 2;
+    char *p = (char*)realloc(*buf, n);
+    if (!p) return 0;
+    *buf = p;
+    *cap = n;
+    return 1;
+}
+
+/* Fills `c` with about RULES_CHUNK bytes of whole lines. */
+static void read_chunk(Pool *p, Chunk *c) {
+    c->ntext = 0;
+    c->last = 0;
+    c->err[0] = '\0';
+    c->line = p->lineno;
+
+    if (!reserve(&c->text, &c->captext, p->ncarry + RULES_CHUNK + 1)) {
+        snprintf(c->err, sizeof(c->err), "noema: out of memory");
+        c->last = 1;
+        return;
+    }
+    if (p->ncarry) memcpy(c->text, p->carry, p->ncarry);
+    c->ntext = p->ncarry;
+    p->ncarry = 0;
+
+    for (;;) {
+        size_t want = c->captext - c->ntext - 1;
+        size_t got = fread(c->text + c->ntext, 1, want, p->in);
+        size_t from = c->ntext;
+        c->ntext += got;
+        if (got < want) {
+            if (ferror(p->in)) snprintf(c->err, sizeof(c->err), "%s: read error", p->name);
+            c->last = 1;
+            break;
+        }
+
+        size_t end = c->ntext;
+        while (end > from && c->text[end - 1] != '\n') end--;
+        if (end > from) {
+            size_t rest = c->ntext - end;
+            if (!reserve(&p->carry, &p->capcarry, rest)) {
+                snprintf(c->err, sizeof(c->err), "noema: out of memory");
+                c->last = 1;
+                break;
+            }
+            if (rest) memcpy(p->carry, c->text + end, rest);
+            p->ncarry = rest;
+            c->ntext = end;
+            break;
+        }
+        if (!reserve(&c->text, &c->captext, c->ntext + RULES_CHUNK + 1)) {
+            snprintf(c->err, sizeof(c->err), "noema: out of memory");
+            c->last = 1;
+            break;
+        }
+    }
+    c->text[c->ntext] = '\0';
+
+    for (const char *q = c->text; (q = memchr(q, '\n', (size_t)(c->text + c->ntext - q))); q++) p->lineno++;
+}
+
+static void* pool_reader(void *arg) {
+    Pool *p = (Pool*)arg;
+    for (;;) {
+        pthread_mutex_lock(&p->mu);
+        while (p->produced - p->written == p->nq && !p->stop) pthread_cond_wait(&p->can_put, &p->mu);
+        if (p->stop) {
+            pthread_mutex_unlock(&p->mu);
+            return NULL;
+        }
+        Chunk *c = &p->q[p->produced % p->nq];
+        pthread_mutex_unlock(&p->mu);
+
+        read_chunk(p, c);          /* the slot is ours until it is produced */
+        int last = c->last;
+
+        pthread_mutex_lock(&p->mu);
+        p->produced++;
+        pthread_cond_signal(&p->can_take);
+        pthread_mutex_unlock(&p->mu);
+        if (last) return NULL;
+    }
+}
+
+/* Parses and runs the lines of `c`, RULES_BATCH records at a time. */
+static void run_chunk(Worker *w, Chunk *c) {
+    c->out = c->errs = NULL;
+    c->nout = c->nerrs = 0;
+    c->records = c->failed = 0;
+    c->marks.n = 0;
+    FILE *out = open_memstream(&c->out, &c->nout);
+    FILE *errs = open_memstream(&c->errs, &c->nerrs);
+    if (!out || !errs) {
+        if (out) fclose(out);
+        if (errs) fclose(errs);
+        snprintf(c->err, sizeof(c->err), "noema: out of memory");
+        return;
+    }
+    runtime_set_output(w->rt, out);
+
+    w->r.lineno = c->line;
+    char *p = c->text, *end = c->text + c->ntext;
+    int more = 1;
+    while (more) {
+        batch_clear(&w->b);
+        while (w->b.nrecs < RULES_BATCH && p < end) {
+            char *line = p;
+            char *nl = (char*)memchr(p, '\n', (size_t)(end - p));
+            size_t n = nl ? (size_t)(nl - p) : (size_t)(end - p);
+            p = nl ? nl + 1 : end;
+            w->r.lineno++;
+            while (n > 0 && line[n - 1] == '\r') n--;
+            line[n] = '\0';
+            if (n == 0) continue;
+            if (!parse_record(&w->r, line, &w->b)) {
+                snprintf(c->err, sizeof(c->err), "%s", w->b.err);
+                more = 0;
+                break;
+            }
+        }
+        if (p == end) more = 0;
+        long failed = run_batch(w->rules, w->rt, w->cols, &w->b, w->val, out, errs, &c->marks);
+        if (failed < 0) {
+            snprintf(c->err, sizeof(c->err), "noema: out of memory");
+            break;
+        }
+        c->records += w->b.nrecs;
+        c->failed += failed;
+    }
+    fclose(out);
+    fclose(errs);
+}
+
+static void* worker_main(void *arg) {
+    Worker *w = (Worker*)arg;
+    Pool *p = w->pool;
+    for (;;) {
+        pthread_mutex_lock(&p->mu);
+        while (p->claimed == p->produced && !p->finished && !p->stop) pthread_cond_wait(&p->can_take, &p->mu);
+        if (p->stop || p->claimed == p->produced) {
+            pthread_mutex_unlock(&p->mu);
+            return NULL;
+        }
+        Chunk *c = &p->q[p->claimed++ % p->nq];
+        if (c->last) {
+            p->finished = 1;
+            pthread_cond_broadcast(&p->can_take);
+        }
+        pthread_mutex_unlock(&p->mu);
+
+        run_chunk(w, c);
+
+        pthread_mutex_lock(&p->mu);
+        c->done = 1;
+        pthread_cond_signal(&p->can_write);
+        pthread_mutex_unlock(&p->mu);
+    }
+}
+
+static int run_parallel(const Rules *ru, const Reader *r, FILE *in, Runtime *rt, int jobs,
+                        RulesStats *st, char *err, int cap) {
+    Pool p;
+    memset(&p, 0, sizeof(p));
+    p.in = in;
+    p.name = r->name;
+    p.lineno = r->lineno;
+    p.nq = 4 * jobs;
+    p.q = (Chunk*)calloc((size_t)p.nq, sizeof(Chunk));
+    Worker *w = (Worker*)calloc((size_t)jobs, sizeof(Worker));
+    int ok = p.q && w;
+    for (int i = 0; ok && i < jobs; i++) {
+        w[i].pool = &p;
+        w[i].rules = ru;
+        w[i].r = *r;
+        w[i].rt = runtime_clone(rt, ru->program);
+        w[i].val = (const LiteralValue**)malloc(((size_t)ru->ninputs + 1) * sizeof(*w[i].val));
+        ok = w[i].rt && w[i].val;
+        if (ok && ru->columns) w[i].cols = columns_build(ru->program, ru->inputs, ru->ninputs);
+    }
+    if (!ok) {
+        snprintf(err, cap, "noema: out of memory");
+    }
+
+    pthread_t reader;
+    int reading = 0, workers = 0;
+    pthread_mutex_init(&p.mu, NULL);
+    pthread_cond_init(&p.can_put, NULL);
+    pthread_cond_init(&p.can_take, NULL);
+    pthread_cond_init(&p.can_write, NULL);
+    if (ok) reading = pthread_create(&reader, NULL, pool_reader, &p) == 0;
+    while (reading && workers < jobs && pthread_create(&w[workers].thread, NULL, worker_main, &w[workers]) == 0) {
+        workers++;
+    }
+    if (ok && !workers) {
+        snprintf(err, cap, "noema: cannot start the record %s", reading ? "workers" : "reader");
+        ok = 0;
+    }
+
+    double t0 = now_seconds();
+    while (ok) {
+        pthread_mutex_lock(&p.mu);
+        while (p.written == p.produced || !p.q[p.written % p.nq].done) pthread_cond_wait(&p.can_write, &p.mu);
+        Chunk *c = &p.q[p.written % p.nq];
+        pthread_mutex_unlock(&p.mu);
+
+        long done_out = 0, done_errs = 0;
+        for (int i = 0; i < c->marks.n; i++) {
+            long at = c->marks.at[2 * i], end = c->marks.at[2 * i + 1];
+            fwrite(c->out + done_out, 1, (size_t)(at - done_out), stdout);
+            fflush(stdout);
+            fwrite(c->errs + done_errs, 1, (size_t)(end - done_errs), stderr);
+            done_out = at;
+            done_errs = end;
+        }
+        fwrite(c->out + done_out, 1, c->nout - (size_t)done_out, stdout);
+        free(c->out);
+        free(c->errs);
+        st->records += c->records;
+        st->failed += c->failed;
+
+        int end = c->last;
+        if (c->err[0]) {
+            snprintf(err, cap, "%s", c->err);
+            ok = 0;
+            end = 1;
+        }
+
+        pthread_mutex_lock(&p.mu);
+        c->done = 0;
+        p.written++;
+        if (end) p.stop = 1;
+        pthread_cond_broadcast(&p.can_put);
+        if (end) pthread_cond_broadcast(&p.can_take);
+        pthread_mutex_unlock(&p.mu);
+        if (end) break;
+    }
+    st->seconds = now_seconds() - t0;
+    fflush(stdout);
+
+    if (reading && !workers) {
+        pthread_mutex_lock(&p.mu);
+        p.stop = 1;
+        pthread_cond_broadcast(&p.can_put);
+        pthread_mutex_unlock(&p.mu);
+    }
+    if (reading) pthread_join(reader, NULL);
+    for (int i = 0; i < workers; i++) pthread_join(w[i].thread, NULL);
+    pthread_mutex_destroy(&p.mu);
+    pthread_cond_destroy(&p.can_put);
+    pthread_cond_destroy(&p.can_take);
+    pthread_cond_destroy(&p.can_write);
+
+    for (int i = 0; p.q && i < p.nq; i++) {
+        if (p.q[i].done) {          /* run, but dropped after a failure */
+            free(p.q[i].out);
+            free(p.q[i].errs);
+        }
+        free(p.q[i].text);
+        free(p.q[i].marks.at);
+    }
+    for (int i = 0; w && i < jobs; i++) {
+        runtime_destroy(w[i].rt);
+        columns_free(w[i].cols);
+        free((void*)w[i].val);
+        batch_free(&w[i].b);
+    }
+    free(p.q);
+    free(w);
+    free(p.carry);
+    return ok;
+}
+
+int rules_run(Stmt **program, const char *path, const char *input, int format,
+              int jobs, int no_opt, int no_jit, RulesStats *st, char *err, int cap) {
+    memset(st, 0, sizeof(*st));
+
+    /* compile once: fold what does not depend on any input */
+    *program = spec_residual(*program, NULL, 0);
+    SpecInput *inputs;
+    int ninputs;
+    if (!spec_take_inputs(program, &inputs, &ninputs, err, cap)) return 0;
+
+    int from_stdin = strcmp(input, "-") == 0;
+    FILE *in = from_stdin ? stdin : fopen(input, "rb");
+    if (!in) {
+        snprintf(err, cap, "noema: cannot open '%s'", input);
+        free(inputs);
+        return 0;
+    }
+
+    Reader r;
+    memset(&r, 0, sizeof(r));
+    r.name = input;
+    r.format = pick_format(input, in, format);
+    r.inputs = inputs;
+    r.ninputs = ninputs;
+
+    Runtime *rt = runtime_create();
+    int *slot = (int*)malloc(((size_t)ninputs + 1) * sizeof(int));
+    int ok = rt && slot;
+    if (!ok) snprintf(err, cap, "noema: out of memory");
+    if (rt) runtime_set_jit(rt, !no_jit);
+    for (int i = 0; ok && i < ninputs; i++) {
+        slot[i] = runtime_var(rt, inputs[i].name);
+        if (slot[i] < 0) { snprintf(err, cap, "noema: out of memory"); ok = 0; }
+    }
+
+    if (ok && r.format == RULES_CSV) {
+        char *line = NULL;
+        size_t linecap = 0;
+        char *header = next_line(in, &line, &linecap, &r.lineno);
+        if (!header) {
+            if (ferror(in)) { snprintf(err, cap, "%s: read error", input); ok = 0; }
+        } else if (!csv_split(&r, header, err, cap, csv_header_cell, NULL)) {
+            ok = 0;
+        }
+        free(line);
+    }
+
+    Rules ru;
+    ru.program = *program;
+    ru.path = path;
+    ru.input = input;
+    ru.inputs = inputs;
+    ru.ninputs = ninputs;
+    ru.slot = slot;
+    ru.columns = !no_opt;
+
+    if (jobs < 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = n > 0 && n < RULES_MAX_JOBS ? (int)n : n > 0 ? RULES_MAX_JOBS : 1;
+    }
+    if (jobs > RULES_MAX_JOBS) jobs = RULES_MAX_JOBS;
+    if (ok) {
+        ok = jobs > 1 ? run_parallel(&ru, &r, in, rt, jobs, st, err, cap)
+                      : run_serial(&ru, &r, in, rt, st, err, cap);
+    }
+
+    free(r.cols);
+    free(slot);
+    runtime_destroy(rt);
+    if (!from_stdin) fclose(in);
+    free(inputs);
+    return ok;
+}
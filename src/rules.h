@@ -0,0 +1,61 @@
+// src/rules.h
+#ifndef NOEMA_RULES_H
+#define NOEMA_RULES_H
+
+#include "parser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+   Rule mode: one program, run once per input record.
+
+   The program is compiled once, partially evaluated with its inputs
+   unknown (see specialize.h), and the input definitions it starts with
+   are taken out. Each record then runs in an empty runtime where each
+   of those inputs holds the record's field of the same name, or its
+   default, and each variable the program only reads holds the field if
+   there is one. Fields the program never mentions are ignored; a field
+   naming any other variable is an error. The output of the run is the
+   record's result.
+
+   Records are JSON Lines (one flat object per line; integers, strings,
+   true, false, null) or CSV with a header row (unquoted fields are typed
+   like --bind values by spec_parse_value, quoted fields are text). An
+   integer that does not fit 32 bits is an error in either format. A
+   reader thread parses the next batch of records while the current one
+   is evaluated.
+
+   With more than one job, records run on a pool of threads, one
+   runtime each, all sharing the compiled program: the reader cuts the
+   input into chunks of lines, a worker parses and runs a whole chunk
+   into buffers of its own, and the buffers are written in input order,
+   so the output is the same as with one job.
+
+   Unless optimizations are off, a rule set of top-level `si` rules over
+   the inputs has its conditions evaluated a block of records at a time
+   first (see columns.h), and each record runs only the rules that fire.
+*/
+
+enum { RULES_AUTO = 0, RULES_JSONL, RULES_CSV };
+
+typedef struct {
+    long records;           /* records run */
+    long failed;            /* of which ended in a runtime error */
+    double seconds;         /* wall time from the first record to the last */
+} RulesStats;
+
+/* Runs `*program` (from `path`) over the records in `input` ("-" is
+   stdin; RULES_AUTO picks the format from the file name, then from the
+   first character) on `jobs` threads (below 0: one per CPU). Runtime
+   errors are reported per record on stderr and do not stop the stream.
+   Returns 0 with a message in err if the records cannot be read. */
+int rules_run(Stmt **program, const char *path, const char *input, int format,
+              int jobs, int no_opt, int no_jit, RulesStats *st, char *err, int cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,14 +1,19 @@
 // src/runtime.c
+#define _DEFAULT_SOURCE
 #include "runtime.h"
 #include "parser.h"
 #include "diag.h"
+#include "jit.h"
 
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
 #define MAX_VARS 1000
-#define NAME_MAX NOEMA_TOKEN_VALUE_MAX
 
 /* ============================================================
    Helpers
@@ -23,16 +28,67 @@ static char* xstrdup(const char *s) {
     return p;
 }
 
+/* One slot per distinct name seen by runtime_exec; expressions and
+   assignments carry the slot index, so lookups never compare names.
+   At most MAX_VARS slots are in use (assigned) at a time. */
 typedef struct {
-    char name[NAME_MAX];
     Value v;
     int in_use;
+    char *name;
+    unsigned char listed;       // LISTED_* lists it is on
 } Var;
 
+/* runtime_reset only visits the slots that can be in use: those the
+   attached program assigns and those set from outside since the last
+   reset. */
+enum { LISTED_WRITTEN = 1, LISTED_TOUCHED = 2 };
+
+typedef struct {
+    int *v;
+    int n, cap;
+} SlotList;
+
 struct Runtime {
-    Var vars[MAX_VARS];
+    Var *vars;
+    int nvars, capvars;
+    int live;                   // slots in use
+
+    int *index;                 // open addressing: slot + 1, 0 = empty
+    size_t index_cap;
+
+    JitCache *jit;              // NULL when disabled or unsupported
+    const Stmt *program;        // what the JIT units point into
+    int resolved;               // `program` has its slots and shapes
+    unsigned layout;            // slot numbering, shared with clones
+
+    struct Module *modules;     // registry for dotted calls
+    int nmodules, capmodules;
+    unsigned module_stamp;      // changes whenever the registry does
+
+    FILE *out;                  // where sonus.dic writes
+
+    struct Incr *incr;          // incremental runs, NULL when off
+
+    SlotList written;           // assigned by `program`
+    SlotList touched;           // set by runtime_set_var since the last reset
+    int reset_all;              // some other slot may be in use
 };
 
+/* Puts `slot` on `list` unless its `flag` says it is there already. */
+static void list_slot(Runtime *rt, SlotList *list, int flag, int slot) {
+    Var *var = &rt->vars[slot];
+    if (var->listed & flag) return;
+    if (list->n == list->cap) {
+        int cap = list->cap ? list->cap * 2 : 16;
+        int *v = (int*)realloc(list->v, (size_t)cap * sizeof(int));
+        if (!v) { rt->reset_all = 1; return; }
+        list->v = v;
+        list->cap = cap;
+    }
+    list->v[list->n++] = slot;
+    var->listed |= flag;
+}
+
 static void value_free(Value *v) {
     if (!v) return;
     if (v->kind == VAL_STRING && v->string_value) {
@@ -55,31 +111,384 @@ static Value value_copy(const Value *src) {
     return out;
 }
 
-static Var* find_var(Runtime *rt, const char *name) {
-    for (int i = 0; i < MAX_VARS; i++) {
-        if (rt->vars[i].in_use && strcmp(rt->vars[i].name, name) == 0) {
-            return &rt->vars[i];
+/* ============================================================
+   Slot resolution
+   ============================================================ */
+
+static int index_grow(Runtime *rt) {
+    size_t cap = rt->index_cap ? rt->index_cap * 2 : 256;
+    int *idx = (int*)calloc(cap, sizeof(int));
+    if (!idx) return 0;
+    for (int i = 0; i < rt->nvars; i++) {
+        size_t h = parser_name_hash(rt->vars[i].name) & (cap - 1);
+        while (idx[h]) h = (h + 1) & (cap - 1);
+        idx[h] = i + 1;
+    }
+    free(rt->index);
+    rt->index = idx;
+    rt->index_cap = cap;
+    return 1;
+}
+
+/* Returns the slot for `name`, creating an unused one; -1 if out of memory. */
+static int slot_of(Runtime *rt, const char *name) {
+    if ((size_t)(rt->nvars + 1) * 2 > rt->index_cap && !index_grow(rt)) return -1;
+
+    size_t h = parser_name_hash(name) & (rt->index_cap - 1);
+    while (rt->index[h]) {
+        int i = rt->index[h] - 1;
+        if (strcmp(rt->vars[i].name, name) == 0) return i;
+        h = (h + 1) & (rt->index_cap - 1);
+    }
+
+    if (rt->nvars == rt->capvars) {
+        int cap = rt->capvars ? rt->capvars * 2 : 64;
+        Var *v = (Var*)realloc(rt->vars, (size_t)cap * sizeof(Var));
+        if (!v) return -1;
+        rt->vars = v;
+        rt->capvars = cap;
+    }
+
+    Var *var = &rt->vars[rt->nvars];
+    memset(var, 0, sizeof(*var));
+    var->v.kind = VAL_NULL;
+    var->name = xstrdup(name);
+    if (!var->name) return -1;
+
+    rt->index[h] = ++rt->nvars;
+    return rt->nvars - 1;
+}
+
+static int resolve_block(Runtime *rt, Stmt *s);
+static void plan_division(Expr *e);
+static void* call_target(Runtime *rt, Stmt *s);
+
+static int resolve_expr(Runtime *rt, Expr *e) {
+    if (!e) return 1;
+    switch (e->kind) {
+        case EXPR_VAR:
+            e->as.var.slot = slot_of(rt, e->as.var.name);
+            return e->as.var.slot >= 0;
+        case EXPR_UNARY:
+            return resolve_expr(rt, e->as.unary.rhs);
+        case EXPR_BINARY:
+            plan_division(e);
+            return resolve_expr(rt, e->as.binary.lhs) && resolve_expr(rt, e->as.binary.rhs);
+        default:
+            return 1;
+    }
+}
+
+/* ============================================================
+   Division by constants
+   `x / c` and `x % c` with a literal c avoid the hardware divide and
+   the zero check: powers of two become a biased shift, any other c a
+   multiply-high by a magic number (Hacker's Delight, 10-1). Truncation
+   toward zero matches C. c == -1 and INT_MIN keep the generic path.
+   ============================================================ */
+
+static void plan_division(Expr *e) {
+    e->as.binary.div_plan = DIV_GENERIC;
+    if (e->as.binary.op != OP_DIV && e->as.binary.op != OP_MOD) return;
+
+    const Expr *r = e->as.binary.rhs;
+    if (!r || r->kind != EXPR_LITERAL || r->as.lit.lit_kind != LIT_INT) return;
+    int d = r->as.lit.int_value;
+    if (d == 0 || d == -1 || d == INT_MIN) return;
+
+    uint32_t ad = d < 0 ? (uint32_t)-d : (uint32_t)d;
+    if ((ad & (ad - 1)) == 0) {
+        int k = 0;
+        while ((1u << k) != ad) k++;
+        e->as.binary.div_plan = DIV_SHIFT;
+        e->as.binary.div_magic = k;
+        return;
+    }
+
+    const uint32_t two31 = 0x80000000u;
+    uint32_t t = two31 + ((uint32_t)d >> 31);
+    uint32_t anc = t - 1 - t % ad;
+    uint32_t q1 = two31 / anc, r1 = two31 - q1 * anc;
+    uint32_t q2 = two31 / ad, r2 = two31 - q2 * ad;
+    uint32_t delta;
+    int p = 31;
+    do {
+        p++;
+        q1 *= 2; r1 *= 2;
+        if (r1 >= anc) { q1++; r1 -= anc; }
+        q2 *= 2; r2 *= 2;
+        if (r2 >= ad) { q2++; r2 -= ad; }
+        delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+
+    uint32_t m = q2 + 1;
+    e->as.binary.div_plan = DIV_MAGIC;
+    e->as.binary.div_magic = (int32_t)(d < 0 ? 0u - m : m);
+    e->as.binary.div_shift = p - 32;
+}
+
+/* n / c for a planned divisor c. */
+static int div_by_const(const Expr *e, int n) {
+    int d = e->as.binary.rhs->as.lit.int_value;
+    int32_t q;
+
+    if (e->as.binary.div_plan == DIV_SHIFT) {
+        int k = e->as.binary.div_magic;
+        q = n;
+        if (k > 0) {
+            uint32_t bias = (uint32_t)(n >> 31) >> (32 - k);       /* 2^k - 1 when n < 0 */
+            q = (int32_t)((uint32_t)n + bias) >> k;
         }
+        return d < 0 ? -q : q;
     }
-    return NULL;
+
+    int32_t m = e->as.binary.div_magic;
+    q = (int32_t)(((int64_t)m * n) >> 32);
+    if (d > 0 && m < 0) q += n;
+    if (d < 0 && m > 0) q -= n;
+    q >>= e->as.binary.div_shift;
+    return q + (int32_t)((uint32_t)q >> 31);
+}
+
+/* ============================================================
+   Superinstructions
+   The dominant statement shapes run in one dispatch, without
+   eval_expr recursion or Value copies, whenever their operands have
+   the expected kinds; otherwise they take the generic path, which
+   also reports any error.
+   ============================================================ */
+
+typedef enum {
+    SHAPE_GENERIC = 0,
+    SHAPE_ADD_INT,      // x = x + <int>
+    SHAPE_STORE_LIT,    // x = <literal>
+    SHAPE_PRINT_VAR,    // sonus.dic(x)
+    SHAPE_CMP_INT,      // si x <cmp> <int>:
+    SHAPE_DISPATCH      // si x == c1: ... aliosi x == c2: ...
+} Shape;
+
+static int is_int_lit(const Expr *e) {
+    return e && e->kind == EXPR_LITERAL && e->as.lit.lit_kind == LIT_INT;
+}
+
+static int stmt_shape(const Stmt *s) {
+    const Expr *v = s->kind == STMT_ASSIGN ? s->value : s->arg;
+    if (!v) return SHAPE_GENERIC;
+
+    if (s->kind == STMT_CALL_PRINT) {
+        return v->kind == EXPR_VAR ? SHAPE_PRINT_VAR : SHAPE_GENERIC;
+    }
+    if (s->kind != STMT_ASSIGN) return SHAPE_GENERIC;
+
+    if (v->kind == EXPR_LITERAL) return SHAPE_STORE_LIT;
+    if (v->kind == EXPR_BINARY && v->as.binary.op == OP_ADD &&
+        v->as.binary.lhs->kind == EXPR_VAR && v->as.binary.lhs->as.var.slot == s->target_slot &&
+        is_int_lit(v->as.binary.rhs)) {
+        return SHAPE_ADD_INT;
+    }
+    return SHAPE_GENERIC;
+}
+
+static int cond_shape(const Expr *c) {
+    if (!c || c->kind != EXPR_BINARY) return SHAPE_GENERIC;
+    switch (c->as.binary.op) {
+        case OP_EQ: case OP_NE: case OP_LT: case OP_LE: case OP_GT: case OP_GE:
+            break;
+        default:
+            return SHAPE_GENERIC;
+    }
+    if (c->as.binary.lhs->kind == EXPR_VAR && is_int_lit(c->as.binary.rhs)) return SHAPE_CMP_INT;
+    return SHAPE_GENERIC;
+}
+
+/* ============================================================
+   Equality dispatch
+   A chain whose conditions all compare one variable with int or
+   string constants finds its branch with a single lookup: a jump
+   table for dense ints, binary search otherwise.
+   ============================================================ */
+
+#define DISPATCH_MIN_CASES 4
+
+typedef struct {
+    int key;
+    int order;                  // position in the chain
+    IfBranch *branch;
+} IntCase;
+
+typedef struct {
+    const char *key;            // literal text in the AST
+    int order;
+    IfBranch *branch;
+} StrCase;
+
+typedef struct {
+    const Expr *subject;        // the variable in the first condition
+    IfBranch *fallback;         // alio, or NULL
+    int lo, span;               // dense: table[v - lo], lo <= v < lo + span
+    IfBranch **table;
+    IntCase *ints;              // sorted by key (when not dense)
+    int nints;
+    StrCase *strs;              // sorted by key
+    int nstrs;
+} Dispatch;
+
+/* For `x == c` or `c == x` with an int/string constant: x, and c in *lit. */
+static const Expr* eq_case(const Expr *c, const LiteralValue **lit) {
+    if (!c || c->kind != EXPR_BINARY || c->as.binary.op != OP_EQ) return NULL;
+    const Expr *v = c->as.binary.lhs, *k = c->as.binary.rhs;
+    if (v->kind == EXPR_LITERAL) { const Expr *t = v; v = k; k = t; }
+    if (v->kind != EXPR_VAR || k->kind != EXPR_LITERAL) return NULL;
+    if (k->as.lit.lit_kind != LIT_INT && k->as.lit.lit_kind != LIT_STRING) return NULL;
+    *lit = &k->as.lit;
+    return v;
+}
+
+/* by key, then chain order: the first case for a key is the one taken */
+static int cmp_int_case(const void *a, const void *b) {
+    const IntCase *x = (const IntCase*)a, *y = (const IntCase*)b;
+    if (x->key != y->key) return (x->key > y->key) - (x->key < y->key);
+    return x->order - y->order;
+}
+
+static int cmp_str_case(const void *a, const void *b) {
+    const StrCase *x = (const StrCase*)a, *y = (const StrCase*)b;
+    int c = strcmp(x->key, y->key);
+    return c ? c : x->order - y->order;
 }
 
-static Var* upsert_var(Runtime *rt, const char *name) {
-    Var *v = find_var(rt, name);
-    if (v) return v;
+/* Returns one malloc'd block (Dispatch followed by its arrays), or NULL
+   when the chain does not qualify. */
+static void* build_dispatch(const Stmt *s) {
+    int n = 0, nints = 0, nstrs = 0;
+    const Expr *subject = NULL;
+    IfBranch *fallback = NULL;
 
-    for (int i = 0; i < MAX_VARS; i++) {
-        if (!rt->vars[i].in_use) {
-            rt->vars[i].in_use = 1;
-            strncpy(rt->vars[i].name, name, NAME_MAX - 1);
-            rt->vars[i].name[NAME_MAX - 1] = '\0';
-            rt->vars[i].v.kind = VAL_NULL;
-            rt->vars[i].v.int_value = 0;
-            rt->vars[i].v.string_value = NULL;
-            return &rt->vars[i];
+    for (IfBranch *b = s->if_branches; b; b = b->next) {
+        if (!b->cond) { fallback = b; break; }
+        const LiteralValue *lit;
+        const Expr *v = eq_case(b->cond, &lit);
+        if (!v || (subject && v->as.var.slot != subject->as.var.slot)) return NULL;
+        if (!subject) subject = v;
+        if (lit->lit_kind == LIT_INT) nints++; else nstrs++;
+        n++;
+    }
+    if (n < DISPATCH_MIN_CASES) return NULL;
+
+    IntCase *ints = (IntCase*)malloc((size_t)(nints + 1) * sizeof(IntCase));
+    StrCase *strs = (StrCase*)malloc((size_t)(nstrs + 1) * sizeof(StrCase));
+    if (!ints || !strs) { free(ints); free(strs); return NULL; }
+
+    int ni = 0, ns = 0, order = 0;
+    for (IfBranch *b = s->if_branches; b && b->cond; b = b->next, order++) {
+        const LiteralValue *lit = NULL;
+        eq_case(b->cond, &lit);
+        if (lit->lit_kind == LIT_INT) {
+            ints[ni].key = lit->int_value; ints[ni].order = order; ints[ni].branch = b; ni++;
+        } else {
+            strs[ns].key = lit->text; strs[ns].order = order; strs[ns].branch = b; ns++;
         }
     }
-    return NULL;
+    qsort(ints, (size_t)ni, sizeof(IntCase), cmp_int_case);
+    qsort(strs, (size_t)ns, sizeof(StrCase), cmp_str_case);
+
+    /* drop shadowed duplicates */
+    int ki = 0, ks = 0;
+    for (int i = 0; i < ni; i++) {
+        if (ki == 0 || ints[ki - 1].key != ints[i].key) ints[ki++] = ints[i];
+    }
+    for (int i = 0; i < ns; i++) {
+        if (ks == 0 || strcmp(strs[ks - 1].key, strs[i].key) != 0) strs[ks++] = strs[i];
+    }
+
+    long long span = ki ? (long long)ints[ki - 1].key - ints[0].key + 1 : 0;
+    int dense = ki >= DISPATCH_MIN_CASES && span <= 2LL * ki + 16;
+
+    size_t ints_size = dense ? (size_t)span * sizeof(IfBranch*) : (size_t)ki * sizeof(IntCase);
+    size_t size = sizeof(Dispatch) + ints_size + (size_t)ks * sizeof(StrCase);
+    Dispatch *d = (Dispatch*)calloc(1, size);
+    if (!d) { free(ints); free(strs); return NULL; }
+
+    unsigned char *p = (unsigned char*)(d + 1);
+    d->subject = subject;
+    d->fallback = fallback;
+    if (dense) {
+        d->lo = ints[0].key;
+        d->span = (int)span;
+        d->table = (IfBranch**)p;
+        for (int i = 0; i < ki; i++) d->table[ints[i].key - d->lo] = ints[i].branch;
+    } else {
+        d->ints = (IntCase*)p;
+        d->nints = ki;
+        memcpy(d->ints, ints, (size_t)ki * sizeof(IntCase));
+    }
+    p += ints_size;
+    d->strs = (StrCase*)p;
+    d->nstrs = ks;
+    memcpy(d->strs, strs, (size_t)ks * sizeof(StrCase));
+
+    free(ints);
+    free(strs);
+    return d;
+}
+
+/* The branch the chain takes for `v`; NULL when none is. */
+static IfBranch* dispatch_find(const Dispatch *d, const Value *v) {
+    if (v->kind == VAL_INT) {
+        int x = v->int_value;
+        if (d->table) {
+            long long i = (long long)x - d->lo;
+            if (i >= 0 && i < d->span && d->table[i]) return d->table[i];
+            return d->fallback;
+        }
+        int lo = 0, hi = d->nints - 1;
+        while (lo <= hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (d->ints[mid].key == x) return d->ints[mid].branch;
+            if (d->ints[mid].key < x) lo = mid + 1; else hi = mid - 1;
+        }
+        return d->fallback;
+    }
+
+    if (v->kind == VAL_STRING && v->string_value) {
+        int lo = 0, hi = d->nstrs - 1;
+        while (lo <= hi) {
+            int mid = lo + (hi - lo) / 2;
+            int c = strcmp(d->strs[mid].key, v->string_value);
+            if (c == 0) return d->strs[mid].branch;
+            if (c < 0) lo = mid + 1; else hi = mid - 1;
+        }
+    }
+    return d->fallback;
+}
+
+static int resolve_block(Runtime *rt, Stmt *s) {
+    for (; s; s = s->next) {
+        switch (s->kind) {
+            case STMT_ASSIGN:
+                s->target_slot = slot_of(rt, s->target);
+                if (s->target_slot < 0 || !resolve_expr(rt, s->value)) return 0;
+                s->shape = stmt_shape(s);
+                list_slot(rt, &rt->written, LISTED_WRITTEN, s->target_slot);
+                break;
+            case STMT_CALL_PRINT:
+                if (!resolve_expr(rt, s->arg)) return 0;
+                s->shape = stmt_shape(s);
+                call_target(rt, s);     /* an unknown callee is reported when reached */
+                break;
+            case STMT_IF:
+                for (IfBranch *b = s->if_branches; b; b = b->next) {
+                    if (!resolve_expr(rt, b->cond) || !resolve_block(rt, b->body)) return 0;
+                    b->cond_shape = cond_shape(b->cond);
+                }
+                if (!s->dispatch) s->dispatch = build_dispatch(s);
+                s->shape = s->dispatch ? SHAPE_DISPATCH : SHAPE_GENERIC;
+                break;
+            default:
+                break;
+        }
+    }
+    return 1;
 }
 
 static int value_truthy(const Value *v) {
@@ -157,6 +566,16 @@ static Value make_string_owned(char *s) {
     return v;
 }
 
+static Value literal_value(const LiteralValue *lit) {
+    switch (lit->lit_kind) {
+        case LIT_INT:    return make_int(lit->int_value);
+        case LIT_BOOL:   return make_bool(lit->int_value ? 1 : 0);
+        case LIT_STRING: return make_string(lit->text);
+        case LIT_NULL:
+        default:         return make_null();
+    }
+}
+
 /* ============================================================
    Expression evaluation
    ============================================================ */
@@ -221,6 +640,20 @@ static Value eval_binary(Runtime *rt, const Expr *e, const char *path, char *err
         return make_bool(b);
     }
 
+    if (e->as.binary.div_plan != DIV_GENERIC) {
+        Value lhs = eval_expr(rt, e->as.binary.lhs, path, err, cap);
+        if (err[0]) { value_free(&lhs); return make_null(); }
+        if (lhs.kind != VAL_INT) {
+            runtime_error(err, cap, path, e->line, e->col, "arithmetic operators expect integers");
+            value_free(&lhs);
+            return make_null();
+        }
+        int n = lhs.int_value;
+        int q = div_by_const(e, n);
+        if (e->as.binary.op == OP_DIV) return make_int(q);
+        return make_int((int)((uint32_t)n - (uint32_t)q * (uint32_t)e->as.binary.rhs->as.lit.int_value));
+    }
+
     Value lhs = eval_expr(rt, e->as.binary.lhs, path, err, cap);
     if (err[0]) { value_free(&lhs); return make_null(); }
 
@@ -345,16 +778,15 @@ static Value eval_expr(Runtime *rt, const Expr *e, const char *path, char *err,
 
     switch (e->kind) {
         case EXPR_LITERAL:
-            if (e->as.lit.lit_kind == LIT_INT)   return make_int(e->as.lit.int_value);
-            if (e->as.lit.lit_kind == LIT_BOOL)  return make_bool(e->as.lit.int_value ? 1 : 0);
-            if (e->as.lit.lit_kind == LIT_NULL)  return make_null();
-            if (e->as.lit.lit_kind == LIT_STRING) return make_string(e->as.lit.text);
-            runtime_error(err, cap, path, e->line, e->col, "unknown literal kind");
-            return make_null();
+            if (e->as.lit.lit_kind < LIT_INT || e->as.lit.lit_kind > LIT_NULL) {
+                runtime_error(err, cap, path, e->line, e->col, "unknown literal kind");
+                return make_null();
+            }
+            return literal_value(&e->as.lit);
 
         case EXPR_VAR: {
-            Var *var = find_var(rt, e->as.var.name);
-            if (!var) {
+            Var *var = &rt->vars[e->as.var.slot];
+            if (!var->in_use) {
                 char msg[320];
                 snprintf(msg, sizeof(msg), "undefined variable '%s'", e->as.var.name);
                 runtime_error(err, cap, path, e->line, e->col, msg);
@@ -379,31 +811,346 @@ static Value eval_expr(Runtime *rt, const Expr *e, const char *path, char *err,
    Statement execution (Phase 2: IF)
    ============================================================ */
 
-static void print_value(const Value *v) {
+static void print_value(Runtime *rt, const Value *v) {
     switch (v->kind) {
-        case VAL_STRING: printf("%s\n", v->string_value ? v->string_value : ""); break;
-        case VAL_INT:    printf("%d\n", v->int_value); break;
-        case VAL_BOOL:   printf("%s\n", v->int_value ? "verum" : "falsum"); break;
+        case VAL_STRING: fprintf(rt->out, "%s\n", v->string_value ? v->string_value : ""); break;
+        case VAL_INT:    fprintf(rt->out, "%d\n", v->int_value); break;
+        case VAL_BOOL:   fprintf(rt->out, "%s\n", v->int_value ? "verum" : "falsum"); break;
         case VAL_NULL:
-        default:         printf("nulla\n"); break;
+        default:         fprintf(rt->out, "nulla\n"); break;
+    }
+}
+
+/* ============================================================
+   Modules
+   A call `mod.member(arg)` is resolved against the registry once per
+   call site; the site keeps the target and the registry stamp it was
+   resolved under, and resolves again only when the stamp differs.
+   Stamps come from one process-wide counter, so a site resolved by
+   one runtime never matches another runtime's registry; a clone (see
+   runtime_clone) shares its original's stamp, and sites are resolved
+   with the program, so runtimes sharing a program only read them.
+   ============================================================ */
+
+typedef void (*Builtin)(Runtime *rt, const Value *arg);
+
+typedef struct {
+    char *name;
+    Builtin fn;
+} Member;
+
+typedef struct Module {
+    char *name;
+    Member *members;
+    int nmembers, capmembers;
+} Module;
+
+static _Atomic unsigned next_module_stamp = 0;
+
+static Module* find_module(Runtime *rt, const char *name, size_t len) {
+    for (int i = 0; i < rt->nmodules; i++) {
+        const char *m = rt->modules[i].name;
+        if (strncmp(m, name, len) == 0 && m[len] == '\0') return &rt->modules[i];
     }
+    return NULL;
+}
+
+/* Adds or replaces `module.member`. Returns 0 if out of memory. */
+static int define_builtin(Runtime *rt, const char *module, const char *member, Builtin fn) {
+    Module *m = find_module(rt, module, strlen(module));
+    if (!m) {
+        if (rt->nmodules == rt->capmodules) {
+            int cap = rt->capmodules ? rt->capmodules * 2 : 4;
+            Module *mods = (Module*)realloc(rt->modules, (size_t)cap * sizeof(Module));
+            if (!mods) return 0;
+            rt->modules = mods;
+            rt->capmodules = cap;
+        }
+        m = &rt->modules[rt->nmodules];
+        memset(m, 0, sizeof(*m));
+        m->name = xstrdup(module);
+        if (!m->name) return 0;
+        rt->nmodules++;
+    }
+
+    Member *f = NULL;
+    for (int i = 0; i < m->nmembers; i++) {
+        if (strcmp(m->members[i].name, member) == 0) { f = &m->members[i]; break; }
+    }
+    if (!f) {
+        if (m->nmembers == m->capmembers) {
+            int cap = m->capmembers ? m->capmembers * 2 : 4;
+            Member *mem = (Member*)realloc(m->members, (size_t)cap * sizeof(Member));
+            if (!mem) return 0;
+            m->members = mem;
+            m->capmembers = cap;
+        }
+        f = &m->members[m->nmembers];
+        f->name = xstrdup(member);
+        if (!f->name) return 0;
+        m->nmembers++;
+    }
+    f->fn = fn;
+
+    /* runtimes are created on many threads at once; 0 marks an empty cache */
+    unsigned stamp;
+    do stamp = atomic_fetch_add(&next_module_stamp, 1) + 1; while (stamp == 0);
+    rt->module_stamp = stamp;
+    return 1;
+}
+
+static Builtin resolve_member(Runtime *rt, const char *callee) {
+    const char *dot = strrchr(callee, '.');
+    if (!dot) return NULL;
+    Module *m = find_module(rt, callee, (size_t)(dot - callee));
+    if (!m) return NULL;
+    for (int i = 0; i < m->nmembers; i++) {
+        if (strcmp(m->members[i].name, dot + 1) == 0) return m->members[i].fn;
+    }
+    return NULL;
+}
+
+/* The call site's target, through its inline cache; NULL if unknown. */
+static void* call_target(Runtime *rt, Stmt *s) {
+    if (s->call_stamp == rt->module_stamp) return s->call_target;
+    Builtin fn = resolve_member(rt, s->callee);
+    if (!fn) return NULL;
+    s->call_target = (void*)(uintptr_t)fn;
+    s->call_stamp = rt->module_stamp;
+    return s->call_target;
 }
 
 static int exec_block(Runtime *rt, Stmt *first, const char *path, char *err, int cap);
 
-static int exec_if(Runtime *rt, Stmt *s, const char *path, char *err, int cap) {
+/* ============================================================
+   Conditions (control-flow context)
+   Only the truth of an si condition matters: et/aut short-circuit,
+   non swaps the outcome and comparisons decide from their operands,
+   so no intermediate bool Value is built. Errors and evaluation
+   order are exactly those of eval_expr.
+   ============================================================ */
+
+typedef struct {
+    Value tmp;                  // holds an evaluated operand (freed)
+    Value lit;                  // literal operand, borrows AST text
+    const Value *v;
+} Operand;
+
+/* Variables are read in place and literals borrowed from the AST;
+   anything else is evaluated into o->tmp. */
+static int load_operand(Runtime *rt, const Expr *e, Operand *o, const char *path, char *err, int cap) {
+    o->tmp = make_null();
+    o->v = &o->tmp;
+
+    if (e->kind == EXPR_VAR && rt->vars[e->as.var.slot].in_use) {
+        o->v = &rt->vars[e->as.var.slot].v;
+        return 1;
+    }
+    if (e->kind == EXPR_LITERAL) {
+        memset(&o->lit, 0, sizeof(o->lit));
+        switch (e->as.lit.lit_kind) {
+            case LIT_INT:    o->lit.kind = VAL_INT;    o->lit.int_value = e->as.lit.int_value; break;
+            case LIT_BOOL:   o->lit.kind = VAL_BOOL;   o->lit.int_value = e->as.lit.int_value ? 1 : 0; break;
+            case LIT_STRING: o->lit.kind = VAL_STRING; o->lit.string_value = (char*)e->as.lit.text; break;
+            default:         o->lit.kind = VAL_NULL;   break;
+        }
+        o->v = &o->lit;
+        return 1;
+    }
+
+    o->tmp = eval_expr(rt, e, path, err, cap);
+    if (err[0]) { value_free(&o->tmp); return 0; }
+    return 1;
+}
+
+static int eval_compare(Runtime *rt, const Expr *e, int *take, const char *path, char *err, int cap) {
+    Operand l, r;
+    if (!load_operand(rt, e->as.binary.lhs, &l, path, err, cap)) return 0;
+    if (!load_operand(rt, e->as.binary.rhs, &r, path, err, cap)) { value_free(&l.tmp); return 0; }
+
+    ExprOp op = e->as.binary.op;
+    int ok = 1;
+    if (op == OP_EQ || op == OP_NE) {
+        int eq = values_equal(l.v, r.v);
+        *take = op == OP_EQ ? eq : !eq;
+    } else if (l.v->kind != VAL_INT || r.v->kind != VAL_INT) {
+        runtime_error(err, cap, path, e->line, e->col, "comparison operators expect integers");
+        ok = 0;
+    } else {
+        int a = l.v->int_value, b = r.v->int_value;
+        if (op == OP_LT) *take = a <  b;
+        if (op == OP_LE) *take = a <= b;
+        if (op == OP_GT) *take = a >  b;
+        if (op == OP_GE) *take = a >= b;
+    }
+
+    value_free(&l.tmp);
+    value_free(&r.tmp);
+    return ok;
+}
+
+/* Sets *take to the truth of `e`; returns 0 on a runtime error. */
+static int eval_cond(Runtime *rt, const Expr *e, int *take, const char *path, char *err, int cap) {
+    if (e->kind == EXPR_UNARY && e->as.unary.op == OP_NOT) {
+        if (!eval_cond(rt, e->as.unary.rhs, take, path, err, cap)) return 0;
+        *take = !*take;
+        return 1;
+    }
+
+    if (e->kind == EXPR_BINARY) {
+        switch (e->as.binary.op) {
+            case OP_AND:
+                if (!eval_cond(rt, e->as.binary.lhs, take, path, err, cap)) return 0;
+                return *take ? eval_cond(rt, e->as.binary.rhs, take, path, err, cap) : 1;
+            case OP_OR:
+                if (!eval_cond(rt, e->as.binary.lhs, take, path, err, cap)) return 0;
+                return *take ? 1 : eval_cond(rt, e->as.binary.rhs, take, path, err, cap);
+            case OP_EQ: case OP_NE: case OP_LT: case OP_LE: case OP_GT: case OP_GE:
+                return eval_compare(rt, e, take, path, err, cap);
+            default:
+                break;
+        }
+    }
+
+    if (e->kind == EXPR_VAR && rt->vars[e->as.var.slot].in_use) {
+        *take = value_truthy(&rt->vars[e->as.var.slot].v);
+        return 1;
+    }
+
+    Value v = eval_expr(rt, e, path, err, cap);
+    if (err[0]) { value_free(&v); return 0; }
+    *take = value_truthy(&v);
+    value_free(&v);
+    return 1;
+}
+
+/* SHAPE_CMP_INT on an int variable; 0 = use the generic path. */
+static int cmp_int_cond(Runtime *rt, const Expr *c, int *take) {
+    const Var *var = &rt->vars[c->as.binary.lhs->as.var.slot];
+    if (!var->in_use || var->v.kind != VAL_INT) return 0;
+
+    int a = var->v.int_value;
+    int k = c->as.binary.rhs->as.lit.int_value;
+    switch (c->as.binary.op) {
+        case OP_EQ: *take = a == k; break;
+        case OP_NE: *take = a != k; break;
+        case OP_LT: *take = a <  k; break;
+        case OP_LE: *take = a <= k; break;
+        case OP_GT: *take = a >  k; break;
+        case OP_GE: *take = a >= k; break;
+        default:    return 0;
+    }
+    return 1;
+}
+
+/* The branch of si chain `s` the current state takes (NULL: none); 0 on
+   a runtime error. */
+static int pick_branch(Runtime *rt, Stmt *s, IfBranch **taken, const char *path, char *err, int cap) {
     for (IfBranch *b = s->if_branches; b; b = b->next) {
         if (b->cond == NULL) {
-            return exec_block(rt, b->body, path, err, cap);
+            *taken = b;
+            return 1;
         }
 
-        Value cv = eval_expr(rt, b->cond, path, err, cap);
-        if (err[0]) { value_free(&cv); return 0; }
+        int take;
+        if (b->cond_shape == SHAPE_CMP_INT && cmp_int_cond(rt, b->cond, &take)) {
+            if (take) { *taken = b; return 1; }
+            continue;
+        }
 
-        int take = value_truthy(&cv);
-        value_free(&cv);
+        if (!eval_cond(rt, b->cond, &take, path, err, cap)) return 0;
+        if (take) { *taken = b; return 1; }
+    }
+    *taken = NULL;
+    return 1;
+}
+
+static int exec_if(Runtime *rt, Stmt *s, const char *path, char *err, int cap) {
+    IfBranch *b;
+    if (!pick_branch(rt, s, &b, path, err, cap)) return 0;
+    return b ? exec_block(rt, b->body, path, err, cap) : 1;
+}
 
-        if (take) return exec_block(rt, b->body, path, err, cap);
+static int exec_dispatch(Runtime *rt, Stmt *s, const char *path, char *err, int cap) {
+    const Dispatch *d = (const Dispatch*)s->dispatch;
+    const Var *var = &rt->vars[d->subject->as.var.slot];
+    if (!var->in_use) return exec_if(rt, s, path, err, cap);    /* reports it */
+
+    IfBranch *b = dispatch_find(d, &var->v);
+    return b ? exec_block(rt, b->body, path, err, cap) : 1;
+}
+
+/* One statement, interpreted. */
+static int exec_stmt(Runtime *rt, Stmt *s, const char *path, char *err, int cap) {
+    switch (s->kind) {
+        case STMT_IMPORT:
+            /* still no-op (sonus is builtin for now) */
+            break;
+
+        case STMT_ASSIGN: {
+            Var *var = &rt->vars[s->target_slot];
+
+            if (s->shape == SHAPE_ADD_INT && var->in_use && var->v.kind == VAL_INT) {
+                var->v.int_value = var->v.int_value + s->value->as.binary.rhs->as.lit.int_value;
+                break;
+            }
+
+            if (!var->in_use) {
+                if (rt->live == MAX_VARS) {
+                    runtime_error(err, cap, path, s->line, s->col, "too many variables");
+                    return 0;
+                }
+                var->in_use = 1;
+                rt->live++;
+            }
+
+            if (s->shape == SHAPE_STORE_LIT) {
+                value_free(&var->v);
+                var->v = literal_value(&s->value->as.lit);
+                break;
+            }
+
+            Value rhs = eval_expr(rt, s->value, path, err, cap);
+            if (err[0]) { value_free(&rhs); return 0; }
+
+            value_free(&var->v);
+            var->v = rhs;          /* store owned value (do NOT free rhs after) */
+            break;
+        }
+
+        case STMT_CALL_PRINT: {
+            void *target = call_target(rt, s);
+            if (!target) {
+                char msg[NOEMA_TOKEN_VALUE_MAX + 32];
+                snprintf(msg, sizeof(msg), "unknown function '%s'", s->callee);
+                runtime_error(err, cap, path, s->line, s->col, msg);
+                return 0;
+            }
+
+            Builtin fn = (Builtin)(uintptr_t)target;
+            if (s->shape == SHAPE_PRINT_VAR && rt->vars[s->arg->as.var.slot].in_use) {
+                fn(rt, &rt->vars[s->arg->as.var.slot].v);
+                break;
+            }
+
+            Value v = eval_expr(rt, s->arg, path, err, cap);
+            if (err[0]) { value_free(&v); return 0; }
+            fn(rt, &v);
+            value_free(&v);
+            break;
+        }
+
+        case STMT_IF:
+            if (s->shape == SHAPE_DISPATCH) {
+                if (!exec_dispatch(rt, s, path, err, cap)) return 0;
+                break;
+            }
+            if (!exec_if(rt, s, path, err, cap)) return 0;
+            break;
+
+        default:
+            runtime_error(err, cap, path, s->line, s->col, "unknown statement kind");
+            return 0;
     }
     return 1;
 }
@@ -411,73 +1158,660 @@ static int exec_if(Runtime *rt, Stmt *s, const char *path, char *err, int cap) {
 static int exec_block(Runtime *rt, Stmt *first, const char *path, char *err, int cap) {
     for (Stmt *s = first; s; s = s->next) {
 
+        /* machine code for the run of statements starting here, if any */
+        if (rt->jit) {
+            const Stmt *next;
+            while (s && jit_run(rt->jit, s, rt->vars, rt->nvars, &rt->live, MAX_VARS, &next)) {
+                s = (Stmt*)next;
+            }
+            if (!s) break;
+        }
+
+        if (!exec_stmt(rt, s, path, err, cap)) return 0;
+    }
+    return 1;
+}
+
+/* ============================================================
+   Incremental runs
+   Each statement of the program has a Track: the variables it reads
+   and may write, and what it did in the last run (the value it stored,
+   the text it printed, the branch it took). A run starts from the
+   bindings and walks the program in order, keeping `changed` for each
+   variable: whether its value at this point may differ from the last
+   run's at the same point. A statement that was completed in the last
+   run and reads nothing changed would do the same again, so it is
+   replayed from its Track; any other one runs. An si chain whose
+   branch stays the same is walked the same way; one that takes another
+   branch runs it in full and marks everything either could write.
+   ============================================================ */
+
+typedef struct {
+    int *v;
+    int n, cap;
+    int oom;
+} Slots;
+
+static void slots_push(Slots *l, int slot) {
+    if (l->oom) return;
+    if (l->n == l->cap) {
+        int nc = l->cap ? l->cap * 2 : 4;
+        int *nv = (int*)realloc(l->v, (size_t)nc * sizeof(int));
+        if (!nv) { l->oom = 1; return; }
+        l->v = nv;
+        l->cap = nc;
+    }
+    l->v[l->n++] = slot;
+}
+
+static void slots_add(Slots *l, int slot) {
+    for (int i = 0; i < l->n; i++) if (l->v[i] == slot) return;
+    slots_push(l, slot);
+}
+
+static void reads_of(Slots *l, const Expr *e) {
+    if (!e) return;
+    switch (e->kind) {
+        case EXPR_VAR:    slots_add(l, e->as.var.slot); break;
+        case EXPR_UNARY:  reads_of(l, e->as.unary.rhs); break;
+        case EXPR_BINARY: reads_of(l, e->as.binary.lhs); reads_of(l, e->as.binary.rhs); break;
+        default:          break;
+    }
+}
+
+static void writes_of(Slots *l, const Stmt *s) {
+    for (; s; s = s->next) {
+        if (s->kind == STMT_ASSIGN) slots_add(l, s->target_slot);
+        if (s->kind == STMT_IF) {
+            for (const IfBranch *b = s->if_branches; b; b = b->next) writes_of(l, b->body);
+        }
+    }
+}
+
+/* The fields a run reads first; the dependency lists are ranges of
+   Incr.deps, laid out in program order. */
+typedef struct {
+    int kind;                   // of the statement
+    int target;                 // assign: its slot
+    int next;                   // next Track of the same block, -1 at its end
+    int reads, nreads;
+    int writes, nwrites;        // si: of every branch
+    int first;                  // si: first Track of each branch body (-1 if
+                                // empty), nbranches of them in deps
+    int nbranches;
+
+    unsigned run;               // last run that reached it
+    int ok;                     // ... and completed it
+    int taken;                  // si: branch index, -1 for none
+    Value value;                // assign: the value stored
+    long out_at, out_len;       // print: its text in that run's output
+    Stmt *s;
+} Track;
+
+typedef struct Incr {
+    Stmt *program;              // what the Tracks describe
+    Track *tracks;
+    int ntracks, captracks;
+    Slots deps;
+    int root;
+    unsigned run;
+
+    Value *binds;               // value of each variable at the start of a run
+    unsigned char *bound;
+    unsigned char *dirty;       // binding changed since the last run
+    unsigned char *changed;
+    int nslots, nbound;
+
+    char *out;                  // the last run's output
+    size_t outlen;
+    long outpos;                // bytes written in this one
+} Incr;
+
+static void incr_drop_tracks(Incr *in) {
+    for (int i = 0; i < in->ntracks; i++) value_free(&in->tracks[i].value);
+    free(in->tracks);
+    free(in->deps.v);
+    memset(&in->deps, 0, sizeof(in->deps));
+    in->tracks = NULL;
+    in->ntracks = in->captracks = 0;
+    in->program = NULL;
+}
+
+static void incr_free(Incr *in) {
+    if (!in) return;
+    incr_drop_tracks(in);
+    for (int i = 0; i < in->nslots; i++) value_free(&in->binds[i]);
+    free(in->binds);
+    free(in->bound);
+    free(in->dirty);
+    free(in->changed);
+    free(in->out);
+    free(in);
+}
+
+static int incr_grow(Incr *in, int nslots) {
+    if (nslots <= in->nslots) return 1;
+    Value *binds = (Value*)realloc(in->binds, (size_t)nslots * sizeof(Value));
+    if (binds) in->binds = binds;
+    unsigned char *bound = (unsigned char*)realloc(in->bound, (size_t)nslots);
+    if (bound) in->bound = bound;
+    unsigned char *dirty = (unsigned char*)realloc(in->dirty, (size_t)nslots);
+    if (dirty) in->dirty = dirty;
+    unsigned char *changed = (unsigned char*)realloc(in->changed, (size_t)nslots);
+    if (changed) in->changed = changed;
+    if (!binds || !bound || !dirty || !changed) return 0;
+
+    for (int i = in->nslots; i < nslots; i++) {
+        memset(&in->binds[i], 0, sizeof(Value));
+        in->binds[i].kind = VAL_NULL;
+        in->bound[i] = 0;
+        in->dirty[i] = 0;
+    }
+    in->nslots = nslots;
+    return 1;
+}
+
+/* Appends `l` to deps and frees it; returns where it starts. */
+static int incr_deps(Incr *in, Slots *l) {
+    int at = in->deps.n;
+    for (int i = 0; i < l->n; i++) slots_push(&in->deps, l->v[i]);
+    if (l->oom) in->deps.oom = 1;
+    free(l->v);
+    return at;
+}
+
+/* Tracks for the block starting at `s`; the index of the first one
+   (-1 for an empty block), or -2 if out of memory. */
+static int incr_build(Incr *in, Stmt *s) {
+    int first = -1, prev = -1;
+    for (; s; s = s->next) {
+        if (in->ntracks == in->captracks) {
+            int nc = in->captracks ? in->captracks * 2 : 64;
+            Track *nt = (Track*)realloc(in->tracks, (size_t)nc * sizeof(Track));
+            if (!nt) return -2;
+            in->tracks = nt;
+            in->captracks = nc;
+        }
+        int i = in->ntracks++;
+        Track *t = &in->tracks[i];
+        memset(t, 0, sizeof(*t));
+        t->s = s;
+        t->kind = s->kind;
+        t->next = -1;
+        t->value.kind = VAL_NULL;
+
+        Slots reads = {0}, writes = {0};
         switch (s->kind) {
-            case STMT_IMPORT:
-                /* still no-op (sonus is builtin for now) */
+            case STMT_ASSIGN:
+                t->target = s->target_slot;
+                reads_of(&reads, s->value);
+                slots_add(&writes, s->target_slot);
                 break;
-
-            case STMT_ASSIGN: {
-                Var *var = upsert_var(rt, s->target);
-                if (!var) {
-                    runtime_error(err, cap, path, s->line, s->col, "too many variables");
-                    return 0;
+            case STMT_CALL_PRINT:
+                reads_of(&reads, s->arg);
+                break;
+            case STMT_IF:
+                for (const IfBranch *b = s->if_branches; b; b = b->next) {
+                    reads_of(&reads, b->cond);
+                    t->nbranches++;
                 }
+                writes_of(&writes, s);
+                break;
+            default:
+                break;
+        }
+        t->nreads = reads.n;
+        t->reads = incr_deps(in, &reads);
+        t->nwrites = writes.n;
+        t->writes = incr_deps(in, &writes);
+
+        if (s->kind == STMT_IF) {
+            Slots firsts = {0};
+            for (IfBranch *b = s->if_branches; b; b = b->next) {
+                int f = incr_build(in, b->body);
+                if (f == -2) { free(firsts.v); return -2; }
+                slots_push(&firsts, f);
+            }
+            in->tracks[i].first = incr_deps(in, &firsts);       /* tracks may have moved */
+        }
+        if (in->deps.oom) return -2;
+
+        if (prev >= 0) in->tracks[prev].next = i;
+        else first = i;
+        prev = i;
+    }
+    return first;
+}
 
-                Value rhs = eval_expr(rt, s->value, path, err, cap);
-                if (err[0]) { value_free(&rhs); return 0; }
+static int incr_block(Runtime *rt, Incr *in, int i, const char *path, char *err, int cap) {
+    for (; i >= 0; i = in->tracks[i].next) {
+        Track *t = &in->tracks[i];
 
-                value_free(&var->v);
-                var->v = rhs;          /* store owned value (do NOT free rhs after) */
+        int valid = t->ok && t->run == in->run - 1;
+        int fresh = !valid;
+        const int *reads = in->deps.v + t->reads;
+        for (int k = 0; !fresh && k < t->nreads; k++) fresh = in->changed[reads[k]];
+        t->run = in->run;
+        t->ok = 0;
+
+        switch (t->kind) {
+            case STMT_ASSIGN: {
+                Var *var = &rt->vars[t->target];
+                if (fresh) {
+                    if (!exec_stmt(rt, t->s, path, err, cap)) return 0;
+                    in->changed[t->target] = !valid || !values_equal(&var->v, &t->value);
+                    value_free(&t->value);
+                    t->value = value_copy(&var->v);
+                    break;
+                }
+                if (!var->in_use) {
+                    var->in_use = 1;
+                    rt->live++;
+                }
+                if (var->v.kind != VAL_STRING && t->value.kind != VAL_STRING) {
+                    var->v = t->value;
+                } else {
+                    value_free(&var->v);
+                    var->v = value_copy(&t->value);
+                }
+                in->changed[t->target] = 0;
                 break;
             }
 
             case STMT_CALL_PRINT: {
-                Value v = eval_expr(rt, s->arg, path, err, cap);
-                if (err[0]) { value_free(&v); return 0; }
-                print_value(&v);
-                value_free(&v);
+                long at = in->outpos;
+                if (fresh) {
+                    if (!exec_stmt(rt, t->s, path, err, cap)) return 0;
+                    in->outpos = ftell(rt->out);
+                } else {
+                    fwrite(in->out + t->out_at, 1, (size_t)t->out_len, rt->out);
+                    in->outpos += t->out_len;
+                }
+                t->out_at = at;
+                t->out_len = in->outpos - at;
                 break;
             }
 
-            case STMT_IF:
-                if (!exec_if(rt, s, path, err, cap)) return 0;
+            case STMT_IF: {
+                int taken = t->taken;
+                if (fresh) {
+                    IfBranch *b;
+                    if (!pick_branch(rt, t->s, &b, path, err, cap)) return 0;
+                    taken = -1;
+                    for (IfBranch *x = t->s->if_branches; b && x; x = x->next) {
+                        taken++;
+                        if (x == b) break;
+                    }
+                }
+
+                int body = taken >= 0 ? in->deps.v[t->first + taken] : -1;
+                if (valid && taken == t->taken) {
+                    if (!incr_block(rt, in, body, path, err, cap)) return 0;
+                    break;
+                }
+
+                const int *writes = in->deps.v + t->writes;
+                for (int k = 0; k < t->nwrites; k++) in->changed[writes[k]] = 1;
+                t->taken = taken;
+                if (!incr_block(rt, in, body, path, err, cap)) return 0;
+                for (int k = 0; k < t->nwrites; k++) in->changed[writes[k]] = 1;
                 break;
+            }
 
             default:
-                runtime_error(err, cap, path, s->line, s->col, "unknown statement kind");
-                return 0;
+                if (!exec_stmt(rt, t->s, path, err, cap)) return 0;
+                break;
         }
+        t->ok = 1;
     }
     return 1;
 }
 
+static int incr_exec(Runtime *rt, Stmt *program, const char *path, char *err, int cap) {
+    Incr *in = rt->incr;
+
+    if (in->program != program) {
+        incr_drop_tracks(in);
+        in->root = incr_build(in, program);
+        if (in->root == -2) {
+            incr_drop_tracks(in);
+            runtime_error(err, cap, path, 0, 0, "out of memory tracking dependencies");
+            return 0;
+        }
+        in->program = program;
+    }
+    if (!incr_grow(in, rt->nvars)) {
+        runtime_error(err, cap, path, 0, 0, "out of memory tracking dependencies");
+        return 0;
+    }
+
+    char *buf = NULL;
+    size_t len = 0;
+    FILE *mem = open_memstream(&buf, &len);
+    if (!mem) {
+        runtime_error(err, cap, path, 0, 0, "out of memory buffering output");
+        return 0;
+    }
+
+    /* the state a fresh runtime given the bindings starts in */
+    for (int i = 0; i < rt->nvars; i++) {
+        Var *v = &rt->vars[i];
+        value_free(&v->v);
+        v->in_use = in->bound[i];
+        if (v->in_use) v->v = value_copy(&in->binds[i]);
+    }
+    rt->live = in->nbound;
+    memcpy(in->changed, in->dirty, (size_t)in->nslots);
+    memset(in->dirty, 0, (size_t)in->nslots);
+    in->run++;
+    in->outpos = 0;
+
+    FILE *out = rt->out;
+    rt->out = mem;
+    int ok = incr_block(rt, in, in->root, path, err, cap);
+    rt->out = out;
+
+    fclose(mem);
+    fwrite(buf, 1, len, out);
+    free(in->out);
+    in->out = buf;
+    in->outlen = len;
+    return ok;
+}
+
 /* ============================================================
    Public API
    ============================================================ */
 
+static JitCache* new_jit(void) {
+    JitLayout lay;
+    lay.stride = sizeof(Var);
+    lay.off_kind = offsetof(Var, v.kind);
+    lay.off_int = offsetof(Var, v.int_value);
+    lay.off_string = offsetof(Var, v.string_value);
+    lay.off_in_use = offsetof(Var, in_use);
+    return jit_cache_create(&lay);
+}
+
+/* Numbers runtimes apart for attach_program; 0 marks an unresolved program. */
+static _Atomic unsigned next_layout = 0;
+
 Runtime* runtime_create(void) {
     Runtime *rt = (Runtime*)calloc(1, sizeof(Runtime));
+    if (!rt) return NULL;
+
+    rt->out = stdout;
+    do rt->layout = atomic_fetch_add(&next_layout, 1) + 1; while (rt->layout == 0);
+
+    if (!define_builtin(rt, "sonus", "dic", print_value)) {
+        runtime_destroy(rt);
+        return NULL;
+    }
     return rt;
 }
 
+void runtime_set_jit(Runtime *rt, int enabled) {
+    if (!rt || !enabled == !rt->jit) return;
+    if (enabled) {
+        rt->jit = new_jit();
+        return;
+    }
+    jit_cache_destroy(rt->jit);
+    rt->jit = NULL;
+}
+
+void runtime_set_output(Runtime *rt, FILE *out) {
+    if (rt) rt->out = out ? out : stdout;
+}
+
+static int attach_program(Runtime *rt, Stmt *program);
+
+int runtime_prepare(Runtime *rt, Stmt *program) {
+    return rt && attach_program(rt, program);
+}
+
+Runtime* runtime_clone(Runtime *rt, Stmt *program) {
+    if (!rt || !attach_program(rt, program)) return NULL;
+
+    Runtime *c = (Runtime*)calloc(1, sizeof(Runtime));
+    if (!c) return NULL;
+    c->out = rt->out;
+    c->program = program;
+    c->resolved = 1;
+    c->layout = rt->layout;
+    c->module_stamp = rt->module_stamp;
+    if (rt->jit) c->jit = new_jit();
+
+    int ok = 1;
+    if (rt->nvars) {
+        c->vars = (Var*)calloc((size_t)rt->nvars, sizeof(Var));
+        c->index = (int*)malloc(rt->index_cap * sizeof(int));
+        ok = c->vars && c->index;
+        if (ok) {
+            c->capvars = rt->nvars;
+            c->index_cap = rt->index_cap;
+            memcpy(c->index, rt->index, rt->index_cap * sizeof(int));
+        }
+        for (int i = 0; ok && i < rt->nvars; i++) {
+            Var *v = &c->vars[c->nvars++];
+            v->v.kind = VAL_NULL;
+            v->name = xstrdup(rt->vars[i].name);
+            if (!v->name) ok = 0;
+            v->listed = rt->vars[i].listed & LISTED_WRITTEN;
+        }
+    }
+    if (ok && rt->written.n) {
+        c->written.v = (int*)malloc((size_t)rt->written.n * sizeof(int));
+        ok = c->written.v != NULL;
+        if (ok) {
+            memcpy(c->written.v, rt->written.v, (size_t)rt->written.n * sizeof(int));
+            c->written.n = c->written.cap = rt->written.n;
+        }
+    }
+
+    if (ok && rt->nmodules) {
+        c->modules = (Module*)calloc((size_t)rt->nmodules, sizeof(Module));
+        ok = c->modules != NULL;
+        if (ok) c->capmodules = rt->nmodules;
+        for (int i = 0; ok && i < rt->nmodules; i++) {
+            const Module *from = &rt->modules[i];
+            Module *m = &c->modules[c->nmodules++];
+            m->name = xstrdup(from->name);
+            m->members = (Member*)calloc((size_t)from->nmembers + 1, sizeof(Member));
+            if (!m->name || !m->members) { ok = 0; break; }
+            m->capmembers = from->nmembers + 1;
+            for (int j = 0; ok && j < from->nmembers; j++) {
+                Member *f = &m->members[m->nmembers++];
+                f->fn = from->members[j].fn;
+                f->name = xstrdup(from->members[j].name);
+                if (!f->name) ok = 0;
+            }
+        }
+    }
+
+    if (!ok) {
+        runtime_destroy(c);
+        return NULL;
+    }
+    return c;
+}
+
 void runtime_destroy(Runtime *rt) {
     if (!rt) return;
-    for (int i = 0; i < MAX_VARS; i++) {
-        if (rt->vars[i].in_use) {
+    jit_cache_destroy(rt->jit);
+    incr_free(rt->incr);
+    for (int i = 0; i < rt->nvars; i++) {
+        value_free(&rt->vars[i].v);
+        free(rt->vars[i].name);
+    }
+    free(rt->vars);
+    free(rt->index);
+    free(rt->written.v);
+    free(rt->touched.v);
+    for (int i = 0; i < rt->nmodules; i++) {
+        for (int j = 0; j < rt->modules[i].nmembers; j++) free(rt->modules[i].members[j].name);
+        free(rt->modules[i].members);
+        free(rt->modules[i].name);
+    }
+    free(rt->modules);
+    free(rt);
+}
+
+/* Resolves `program` and makes it the one compiled code belongs to.
+   Slots are written into the AST, so the program's first statement
+   records whose numbering they are (a clone shares its original's).
+   Runs after the first reuse them, unless another runtime has resolved
+   the program since; it is then resolved again, to the same slots as
+   before. Runtimes with different numberings must not run one program
+   at the same time. */
+static int attach_program(Runtime *rt, Stmt *program) {
+    int mine = !program || program->slot_stamp == rt->layout;
+    if (program == rt->program && rt->resolved && mine) return 1;
+    if (program != rt->program) {
+        jit_cache_clear(rt->jit);
+        rt->program = program;
+        rt->resolved = 0;
+
+        /* what the old program assigned may still be in use */
+        for (int i = 0; i < rt->written.n; i++) rt->vars[rt->written.v[i]].listed &= ~LISTED_WRITTEN;
+        rt->written.n = 0;
+        rt->reset_all = 1;
+    }
+    if (program) program->slot_stamp = 0;     /* half resolved is no one's */
+    if (!resolve_block(rt, program)) return 0;
+    if (program) program->slot_stamp = rt->layout;
+    rt->resolved = 1;
+    return 1;
+}
+
+int runtime_var(Runtime *rt, const char *name) {
+    return rt ? slot_of(rt, name) : -1;
+}
+
+/* Gives variable `var` the owned value `v` (or, incrementally, its
+   binding); frees it on failure. */
+static int set_owned(Runtime *rt, int var, Value v) {
+    if (rt->incr) {
+        Incr *in = rt->incr;
+        if (!incr_grow(in, rt->nvars)) { value_free(&v); return 0; }
+        if (in->bound[var] && values_equal(&in->binds[var], &v)) {
+            value_free(&v);
+            return 1;
+        }
+        if (!in->bound[var]) {
+            if (in->nbound == MAX_VARS) { value_free(&v); return 0; }
+            in->bound[var] = 1;
+            in->nbound++;
+        }
+        value_free(&in->binds[var]);
+        in->binds[var] = v;
+        in->dirty[var] = 1;
+        return 1;
+    }
+
+    Var *slot = &rt->vars[var];
+    if (!slot->in_use) {
+        if (rt->live == MAX_VARS) { value_free(&v); return 0; }
+        slot->in_use = 1;
+        rt->live++;
+        list_slot(rt, &rt->touched, LISTED_TOUCHED, var);
+    }
+    value_free(&slot->v);
+    slot->v = v;
+    return 1;
+}
+
+int runtime_set_var(Runtime *rt, int var, const LiteralValue *value) {
+    if (!rt || var < 0 || var >= rt->nvars) return 0;
+    return set_owned(rt, var, literal_value(value));
+}
+
+int runtime_set_value(Runtime *rt, int var, const Value *value) {
+    if (!rt || !value || var < 0 || var >= rt->nvars) return 0;
+    return set_owned(rt, var, value_copy(value));
+}
+
+static void clear_slots(Runtime *rt, const SlotList *list) {
+    for (int i = 0; i < list->n; i++) {
+        Var *var = &rt->vars[list->v[i]];
+        value_free(&var->v);
+        var->in_use = 0;
+    }
+}
+
+void runtime_reset(Runtime *rt) {
+    if (!rt) return;
+    if (rt->reset_all || rt->incr) {
+        for (int i = 0; i < rt->nvars; i++) {
             value_free(&rt->vars[i].v);
             rt->vars[i].in_use = 0;
         }
+        rt->reset_all = 0;
+    } else if (rt->live) {
+        clear_slots(rt, &rt->written);
+        clear_slots(rt, &rt->touched);
     }
-    free(rt);
+    for (int i = 0; i < rt->touched.n; i++) rt->vars[rt->touched.v[i]].listed &= ~LISTED_TOUCHED;
+    rt->touched.n = 0;
+    rt->live = 0;
+
+    Incr *in = rt->incr;
+    for (int i = 0; in && i < in->nslots; i++) {
+        if (!in->bound[i]) continue;
+        value_free(&in->binds[i]);
+        in->bound[i] = 0;
+        in->dirty[i] = 1;
+    }
+    if (in) in->nbound = 0;
 }
 
-int runtime_exec(Runtime *rt, Stmt *program, const char *path, char *err_out, int err_cap) {
+int runtime_set_incremental(Runtime *rt, int enabled) {
+    if (!rt) return 0;
+    if (!enabled) {
+        incr_free(rt->incr);
+        rt->incr = NULL;
+        return 1;
+    }
+    if (rt->incr) return 1;
+
+    Incr *in = (Incr*)calloc(1, sizeof(Incr));
+    if (!in || !incr_grow(in, rt->nvars)) {
+        incr_free(in);
+        return 0;
+    }
+    for (int i = 0; i < rt->nvars; i++) {
+        if (!rt->vars[i].in_use) continue;
+        in->binds[i] = value_copy(&rt->vars[i].v);
+        in->bound[i] = 1;
+        in->dirty[i] = 1;
+        in->nbound++;
+    }
+    rt->incr = in;
+    return 1;
+}
+
+static int start_run(Runtime *rt, Stmt *program, const char **path, char *err_out, int err_cap) {
     if (!rt) return 0;
     if (!err_out || err_cap <= 0) return 0;
 
     err_out[0] = '\0';
-    if (!path || !path[0]) path = "<input>";
+    if (!*path || !(*path)[0]) *path = "<input>";
 
+    if (!attach_program(rt, program)) {
+        runtime_error(err_out, err_cap, *path, 0, 0, "out of memory resolving variables");
+        return 0;
+    }
+    return 1;
+}
+
+int runtime_exec_block(Runtime *rt, Stmt *program, Stmt *block, const char *path, char *err_out, int err_cap) {
+    if (!start_run(rt, program, &path, err_out, err_cap)) return 0;
+    return exec_block(rt, block, path, err_out, err_cap);
+}
+
+int runtime_exec(Runtime *rt, Stmt *program, const char *path, char *err_out, int err_cap) {
+    if (!start_run(rt, program, &path, err_out, err_cap)) return 0;
+    if (rt->incr) return incr_exec(rt, program, path, err_out, err_cap);
     return exec_block(rt, program, path, err_out, err_cap);
 }
 
@@ -4,6 +4,8 @@
 
 #include "parser.h"
 
+#include <stdio.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -21,14 +23,75 @@ typedef struct {
     char *string_value;     // for string (heap), NULL otherwise
 } Value;
 
+// How `x / c` and `x % c` with an int literal c are computed; picked
+// when the runtime resolves a program and shared with the JIT.
+typedef enum {
+    DIV_GENERIC = 0,        // hardware divide with zero check
+    DIV_MAGIC,              // multiply-high by a magic number, then shift
+    DIV_SHIFT               // |c| is a power of two: biased arithmetic shift
+} DivPlan;
+
 typedef struct Runtime Runtime;
 
 Runtime* runtime_create(void);
 void     runtime_destroy(Runtime *rt);
 
+// The baseline JIT is off by default: it pays off only for a runtime that
+// executes the same program many times (rule records, batches), and only
+// statements that have run often are compiled. Pass 1 to turn it on
+// where supported.
+void     runtime_set_jit(Runtime *rt, int enabled);
+
 // Added `path` so diagnostics show real filename instead of "<input>"
+// A runtime may execute the same program repeatedly; resolved slots and
+// compiled code are kept per program (which must not be edited between
+// runs) and dropped when a different program is passed. Separately
+// created runtimes may take turns running one program, which is then
+// resolved again for each, but not run it at the same time.
 int      runtime_exec(Runtime *rt, Stmt *program, const char *path, char *err_out, int err_cap);
 
+// Runs only `block`, a statement list inside `program`, as the run of
+// `program` would on reaching it (rule mode runs just the rules that fire).
+int      runtime_exec_block(Runtime *rt, Stmt *program, Stmt *block, const char *path,
+                            char *err_out, int err_cap);
+
+// sonus.dic writes to stdout unless another stream is set.
+void     runtime_set_output(Runtime *rt, FILE *out);
+
+// A runtime that runs `program` like `rt` does, for use on another
+// thread: the program is resolved in `rt` first (so both agree on its
+// variables), and the clone gets its own variables, compiled code and
+// the same output stream. Runtimes sharing a program never write to it
+// while running it. NULL if out of memory.
+Runtime* runtime_clone(Runtime *rt, Stmt *program);
+
+// Resolves `program` in `rt` now instead of on its first run. After
+// that, runtime_clone(rt, program) only reads `rt`, so other threads
+// may clone it at the same time. Returns 0 if out of memory.
+int      runtime_prepare(Runtime *rt, Stmt *program);
+
+// Variables can be given values before a run (rule mode). runtime_var
+// returns the variable for `name` (-1 if out of memory); runtime_set_var
+// and runtime_set_value (which copies `value`) return 0 when that would
+// exceed the variable limit. runtime_reset unassigns every variable, as
+// in a fresh runtime; it only visits those the program assigns or that
+// were set since the last reset.
+int      runtime_var(Runtime *rt, const char *name);
+int      runtime_set_var(Runtime *rt, int var, const LiteralValue *value);
+int      runtime_set_value(Runtime *rt, int var, const Value *value);
+void     runtime_reset(Runtime *rt);
+
+// Incremental mode, for a host that reruns one program as its inputs
+// change one at a time. runtime_set_var then sets a binding: the value
+// the variable starts each run with (the variables' values when the
+// mode is turned on are the first bindings, runtime_reset drops them
+// all). Every runtime_exec behaves as a run of a fresh runtime given
+// the bindings, with the same output and final variables, but only the
+// statements that read something changed since the last run are run,
+// interpreted; the rest are replayed from that run. Returns 0 if out of
+// memory.
+int      runtime_set_incremental(Runtime *rt, int enabled);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,737 @@
+// src/specialize.c
+#include "specialize.h"
+#include "optimize.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdio.h>
+
+/* ============================================================
+   Bindings
+   ============================================================ */
+
+static int is_ident(const char *s, size_t n) {
+    if (n == 0) return 0;
+    for (size_t i = 0; i < n; i++) {
+        char c = s[i];
+        int ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' ||
+                 (i > 0 && c >= '0' && c <= '9');
+        if (!ok) return 0;
+    }
+    return 1;
+}
+
+int spec_parse_value(const char *s, size_t n, LiteralValue *out) {
+    memset(out, 0, sizeof(*out));
+    if (n == 0 || (n == 5 && memcmp(s, "nulla", 5) == 0)) {
+        out->lit_kind = LIT_NULL;
+        return 1;
+    }
+    if ((n == 5 && memcmp(s, "verum", 5) == 0) || (n == 6 && memcmp(s, "falsum", 6) == 0)) {
+        out->lit_kind = LIT_BOOL;
+        out->int_value = s[0] == 'v';
+        return 1;
+    }
+
+    /* an optional sign and digits: an integer, or an error if it does
+       not fit */
+    size_t i = s[0] == '-' || s[0] == '+';
+    size_t end = i;
+    while (end < n && s[end] >= '0' && s[end] <= '9') end++;
+    if (i < n && end == n) {
+        long long v = 0;
+        for (; i < n; i++) {
+            v = v * 10 + (s[i] - '0');
+            if (v > (long long)INT_MAX + 1) return 0;
+        }
+        if (s[0] == '-') v = -v;
+        if (v > INT_MAX) return 0;
+        out->lit_kind = LIT_INT;
+        out->int_value = (int)v;
+        return 1;
+    }
+
+    out->lit_kind = LIT_STRING;
+    memcpy(out->text, s, n);
+    return 1;
+}
+
+int spec_parse_binding(const char *text, SpecBinding *out, char *err, int cap) {
+    memset(out, 0, sizeof(*out));
+
+    const char *eq = strchr(text, '=');
+    if (!eq || !is_ident(text, (size_t)(eq - text)) || eq - text >= NOEMA_TOKEN_VALUE_MAX) {
+        snprintf(err, cap, "noema: --bind expects name=value, got '%s'", text);
+        return 0;
+    }
+    memcpy(out->name, text, (size_t)(eq - text));
+
+    const char *v = eq + 1;
+    size_t n = strlen(v);
+    int quoted = n >= 2 && v[0] == '"' && v[n - 1] == '"';
+    if (quoted) { v++; n -= 2; }
+    if (n >= NOEMA_TOKEN_VALUE_MAX || memchr(v, '"', n) || memchr(v, '\n', n)) {
+        snprintf(err, cap, "noema: --bind %s: string cannot be written as a literal", out->name);
+        return 0;
+    }
+
+    if (quoted) {
+        out->value.lit_kind = LIT_STRING;
+        memcpy(out->value.text, v, n);
+        return 1;
+    }
+    if (!spec_parse_value(v, n, &out->value)) {
+        snprintf(err, cap, "noema: --bind %s: integer out of range", out->name);
+        return 0;
+    }
+    return 1;
+}
+
+/* ============================================================
+   Variable numbering
+   ============================================================ */
+
+typedef struct {
+    char **names;
+    int n, cap;
+    int *index;                 /* open addressing: id + 1, 0 = empty */
+    size_t index_cap;
+    int oom;
+} Names;
+
+static int names_lookup(Names *t, const char *name, int create) {
+    if (t->index_cap == 0 || (size_t)(t->n + 1) * 2 > t->index_cap) {
+        size_t cap = t->index_cap ? t->index_cap * 2 : 64;
+        int *idx = (int*)calloc(cap, sizeof(int));
+        if (!idx) { t->oom = 1; return -1; }
+        for (int i = 0; i < t->n; i++) {
+            size_t h = parser_name_hash(t->names[i]) & (cap - 1);
+            while (idx[h]) h = (h + 1) & (cap - 1);
+            idx[h] = i + 1;
+        }
+        free(t->index);
+        t->index = idx;
+        t->index_cap = cap;
+    }
+
+    size_t h = parser_name_hash(name) & (t->index_cap - 1);
+    while (t->index[h]) {
+        int i = t->index[h] - 1;
+        if (strcmp(t->names[i], name) == 0) return i;
+        h = (h + 1) & (t->index_cap - 1);
+    }
+    if (!create) return -1;
+
+    if (t->n == t->cap) {
+        int cap = t->cap ? t->cap * 2 : 32;
+        char **p = (char**)realloc(t->names, (size_t)cap * sizeof(char*));
+        if (!p) { t->oom = 1; return -1; }
+        t->names = p;
+        t->cap = cap;
+    }
+    size_t len = strlen(name) + 1;
+    char *copy = (char*)malloc(len);
+    if (!copy) { t->oom = 1; return -1; }
+    memcpy(copy, name, len);
+
+    t->names[t->n] = copy;
+    t->index[h] = ++t->n;
+    return t->n - 1;
+}
+
+static void names_free(Names *t) {
+    for (int i = 0; i < t->n; i++) free(t->names[i]);
+    free(t->names);
+    free(t->index);
+}
+
+static void number_block(Names *t, Stmt *s);
+
+static void number_expr(Names *t, Expr *e) {
+    if (!e) return;
+    switch (e->kind) {
+        case EXPR_VAR:
+            e->as.var.slot = names_lookup(t, e->as.var.name, 1);
+            break;
+        case EXPR_UNARY:
+            number_expr(t, e->as.unary.rhs);
+            break;
+        case EXPR_BINARY:
+            number_expr(t, e->as.binary.lhs);
+            number_expr(t, e->as.binary.rhs);
+            break;
+        default:
+            break;
+    }
+}
+
+static void number_block(Names *t, Stmt *s) {
+    for (; s; s = s->next) {
+        s->slot_stamp = 0;      /* no runtime's numbering any more */
+        switch (s->kind) {
+            case STMT_ASSIGN:
+                number_expr(t, s->value);
+                s->target_slot = names_lookup(t, s->target, 1);
+                break;
+            case STMT_CALL_PRINT:
+                number_expr(t, s->arg);
+                break;
+            case STMT_IF:
+                for (IfBranch *b = s->if_branches; b; b = b->next) {
+                    number_expr(t, b->cond);
+                    number_block(t, b->body);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/* first[id] = first assignment of each variable in source order. */
+static void first_assigns(Stmt *s, Stmt **first) {
+    for (; s; s = s->next) {
+        if (s->kind == STMT_ASSIGN && s->target_slot >= 0 && !first[s->target_slot]) {
+            first[s->target_slot] = s;
+        }
+        if (s->kind == STMT_IF) {
+            for (IfBranch *b = s->if_branches; b; b = b->next) first_assigns(b->body, first);
+        }
+    }
+}
+
+/* A default is written as a literal; `-5` parses as negation. */
+static int is_default(const Expr *e) {
+    if (!e) return 0;
+    if (e->kind == EXPR_LITERAL) return 1;
+    return e->kind == EXPR_UNARY && e->as.unary.op == OP_NEG &&
+           e->as.unary.rhs && e->as.unary.rhs->kind == EXPR_LITERAL &&
+           e->as.unary.rhs->as.lit.lit_kind == LIT_INT;
+}
+
+typedef struct {
+    Names names;
+    Stmt **first;               /* per id: first assignment */
+    Stmt **input;               /* per id: the defining top-level literal assignment */
+} Scan;
+
+static int scan_program(Stmt *program, Scan *sc) {
+    memset(sc, 0, sizeof(*sc));
+    number_block(&sc->names, program);
+    if (sc->names.oom) return 0;
+    sc->first = (Stmt**)calloc((size_t)sc->names.n + 1, sizeof(Stmt*));
+    sc->input = (Stmt**)calloc((size_t)sc->names.n + 1, sizeof(Stmt*));
+    if (!sc->first || !sc->input) return 0;
+    first_assigns(program, sc->first);
+
+    for (Stmt *s = program; s; s = s->next) {
+        if (s->kind == STMT_ASSIGN && s->target_slot >= 0 && sc->first[s->target_slot] == s &&
+            is_default(s->value)) {
+            sc->input[s->target_slot] = s;
+        }
+    }
+    return 1;
+}
+
+static void scan_free(Scan *sc) {
+    names_free(&sc->names);
+    free(sc->first);
+    free(sc->input);
+}
+
+static Expr* new_lit(const LiteralValue *v, int line, int col) {
+    Expr *e = (Expr*)calloc(1, sizeof(Expr));
+    if (!e) return NULL;
+    e->kind = EXPR_LITERAL;
+    e->line = line;
+    e->col = col;
+    e->as.lit = *v;
+    return e;
+}
+
+int spec_bind(Stmt **program, const SpecBinding *b, int n, char *err, int cap) {
+    if (n <= 0) return 1;
+
+    Scan sc;
+    if (!scan_program(*program, &sc)) {
+        scan_free(&sc);
+        snprintf(err, cap, "noema: out of memory");
+        return 0;
+    }
+
+    int ok = 1;
+    for (int i = 0; i < n && ok; i++) {
+        int id = names_lookup(&sc.names, b[i].name, 0);
+        if (id < 0) {
+            snprintf(err, cap, "noema: --bind %s: no such variable in this program", b[i].name);
+            ok = 0;
+            break;
+        }
+
+        Stmt *in = sc.input[id];
+        if (in) {
+            Expr *lit = new_lit(&b[i].value, in->value->line, in->value->col);
+            if (!lit) { ok = 0; break; }
+            parser_free_expr(in->value);
+            in->value = lit;
+            continue;
+        }
+
+        if (sc.first[id]) {
+            snprintf(err, cap, "noema: --bind %s: not an input (first assigned at %d:%d from an expression)",
+                     b[i].name, sc.first[id]->line, sc.first[id]->col);
+            ok = 0;
+            break;
+        }
+
+        /* read but never assigned: define it up front */
+        Stmt *s = (Stmt*)calloc(1, sizeof(Stmt));
+        Expr *lit = new_lit(&b[i].value, 1, 1);
+        if (!s || !lit) { free(s); free(lit); ok = 0; break; }
+        s->kind = STMT_ASSIGN;
+        s->line = 1;
+        s->col = 1;
+        snprintf(s->target, sizeof(s->target), "%s", b[i].name);
+        s->value = lit;
+        s->next = *program;
+        *program = s;
+        sc.first[id] = s;
+        sc.input[id] = s;
+    }
+
+    if (!ok && !err[0]) snprintf(err, cap, "noema: out of memory");
+    scan_free(&sc);
+    return ok;
+}
+
+/* ============================================================
+   Residual program
+   ============================================================ */
+
+typedef struct {
+    unsigned char *known;
+    LiteralValue *val;
+} Env;
+
+typedef struct {
+    int nvars;
+    Stmt **input;               /* per id */
+    unsigned char *bound;       /* per id */
+    int oom;
+} Spec;
+
+static int env_init(Spec *sp, Env *e) {
+    e->known = (unsigned char*)calloc((size_t)sp->nvars + 1, 1);
+    e->val = (LiteralValue*)calloc((size_t)sp->nvars + 1, sizeof(LiteralValue));
+    if (!e->known || !e->val) { sp->oom = 1; return 0; }
+    return 1;
+}
+
+static void env_free(Env *e) {
+    free(e->known);
+    free(e->val);
+}
+
+static int env_copy(Spec *sp, Env *dst, const Env *src) {
+    if (!env_init(sp, dst)) return 0;
+    memcpy(dst->known, src->known, (size_t)sp->nvars);
+    for (int i = 0; i < sp->nvars; i++) {
+        if (src->known[i]) dst->val[i] = src->val[i];
+    }
+    return 1;
+}
+
+static void pe_expr(Spec *sp, Env *env, Expr *e) {
+    if (!e) return;
+    LiteralValue r;
+
+    switch (e->kind) {
+        case EXPR_VAR: {
+            int id = e->as.var.slot;
+            if (id >= 0 && id < sp->nvars && env->known[id]) {
+                r = env->val[id];
+                opt_become_lit(e, &r);
+            }
+            return;
+        }
+
+        case EXPR_UNARY:
+            pe_expr(sp, env, e->as.unary.rhs);
+            if (opt_is_lit(e->as.unary.rhs) && opt_fold_unary(e->as.unary.op, &e->as.unary.rhs->as.lit, &r)) {
+                opt_become_lit(e, &r);
+            }
+            return;
+
+        case EXPR_BINARY: {
+            ExprOp op = e->as.binary.op;
+            pe_expr(sp, env, e->as.binary.lhs);
+
+            /* a known left operand decides et/aut without the right one */
+            if ((op == OP_AND || op == OP_OR) && opt_is_lit(e->as.binary.lhs)) {
+                int t = opt_lit_truthy(&e->as.binary.lhs->as.lit);
+                if ((op == OP_AND && !t) || (op == OP_OR && t)) {
+                    memset(&r, 0, sizeof(r));
+                    r.lit_kind = LIT_BOOL;
+                    r.int_value = t;
+                    opt_become_lit(e, &r);
+                    return;
+                }
+            }
+
+            pe_expr(sp, env, e->as.binary.rhs);
+            if (opt_is_lit(e->as.binary.lhs) && opt_is_lit(e->as.binary.rhs) &&
+                opt_fold_binary(op, &e->as.binary.lhs->as.lit, &e->as.binary.rhs->as.lit, &r)) {
+                opt_become_lit(e, &r);
+            }
+            return;
+        }
+
+        default:
+            return;
+    }
+}
+
+static Stmt* pe_block(Spec *sp, Env *env, Stmt *first);
+
+/* In a condition only truthiness matters: `c et verum` and `c aut falsum`
+   test the same as `c`. */
+static Expr* pe_cond(Expr *e) {
+    while (e && e->kind == EXPR_BINARY &&
+           (e->as.binary.op == OP_AND || e->as.binary.op == OP_OR)) {
+        int neutral = e->as.binary.op == OP_AND;
+        Expr *keep = NULL;
+        if (opt_is_lit(e->as.binary.rhs) && opt_lit_truthy(&e->as.binary.rhs->as.lit) == neutral) {
+            keep = e->as.binary.lhs;
+            e->as.binary.lhs = NULL;
+        } else if (opt_is_lit(e->as.binary.lhs) && opt_lit_truthy(&e->as.binary.lhs->as.lit) == neutral) {
+            keep = e->as.binary.rhs;
+            e->as.binary.rhs = NULL;
+        } else {
+            break;
+        }
+        parser_free_expr(e);
+        e = keep;
+    }
+    return e;
+}
+
+/* Joins branch outcomes: a variable stays known only if every path
+   leaves it with the same literal. */
+static void env_meet(Spec *sp, Env *acc, const Env *other) {
+    for (int i = 0; i < sp->nvars; i++) {
+        if (acc->known[i] && (!other->known[i] || !opt_lits_equal(&acc->val[i], &other->val[i]))) {
+            acc->known[i] = 0;
+        }
+    }
+}
+
+/* Same *drop / *splice as opt_prune_if. */
+static void pe_if(Spec *sp, Env *env, Stmt *s, int *drop, Stmt **splice) {
+    /* conditions only read variables, so each sees the entry state */
+    for (IfBranch *b = s->if_branches; b; b = b->next) {
+        if (!b->cond) continue;
+        pe_expr(sp, env, b->cond);
+        b->cond = pe_cond(b->cond);
+    }
+
+    opt_prune_if(s, drop, splice);
+    if (*drop) {
+        *splice = pe_block(sp, env, *splice);
+        return;
+    }
+
+    Env out;
+    memset(&out, 0, sizeof(out));
+    int have_out = 0, has_else = 0;
+    for (IfBranch *b = s->if_branches; b; b = b->next) {
+        Env be;
+        if (!env_copy(sp, &be, env)) { env_free(&be); break; }
+        b->body = pe_block(sp, &be, b->body);
+        if (!b->cond) has_else = 1;
+        if (!have_out) { out = be; have_out = 1; continue; }
+        env_meet(sp, &out, &be);
+        env_free(&be);
+    }
+
+    if (sp->oom || !have_out) {
+        /* forget everything rather than guess */
+        memset(env->known, 0, (size_t)sp->nvars);
+        env_free(&out);
+        return;
+    }
+
+    if (!has_else) env_meet(sp, &out, env);     /* no branch taken */
+    memcpy(env->known, out.known, (size_t)sp->nvars);
+    for (int i = 0; i < sp->nvars; i++) {
+        if (out.known[i]) env->val[i] = out.val[i];
+    }
+    env_free(&out);
+}
+
+static int is_unbound_input(Spec *sp, const Stmt *s) {
+    int id = s->target_slot;
+    if (id < 0 || id >= sp->nvars || sp->bound[id]) return 0;
+    return sp->input[id] == s;
+}
+
+static Stmt* pe_block(Spec *sp, Env *env, Stmt *first) {
+    Stmt *head = NULL;
+    Stmt *tail = NULL;
+
+    Stmt *s = first;
+    while (s) {
+        Stmt *next = s->next;
+        s->next = NULL;
+
+        int drop = 0;
+        Stmt *splice = NULL;
+
+        switch (s->kind) {
+            case STMT_ASSIGN: {
+                int id = s->target_slot;
+                if (is_unbound_input(sp, s)) {
+                    env->known[id] = 0;     /* varies per run: keep the default as written */
+                    break;
+                }
+                pe_expr(sp, env, s->value);
+                if (id >= 0 && id < sp->nvars) {
+                    env->known[id] = (unsigned char)opt_is_lit(s->value);
+                    if (env->known[id]) env->val[id] = s->value->as.lit;
+                }
+                break;
+            }
+            case STMT_CALL_PRINT:
+                pe_expr(sp, env, s->arg);
+                break;
+            case STMT_IF:
+                pe_if(sp, env, s, &drop, &splice);
+                break;
+            default:
+                break;
+        }
+
+        if (drop) {
+            parser_free_program(s);
+            s = splice;
+        }
+
+        while (s) {
+            Stmt *n = s->next;
+            s->next = NULL;
+            if (!head) head = s;
+            else tail->next = s;
+            tail = s;
+            s = n;
+        }
+
+        s = next;
+    }
+
+    return head;
+}
+
+Stmt* spec_residual(Stmt *program, const SpecBinding *b, int n) {
+    Scan sc;
+    if (!scan_program(program, &sc)) {
+        scan_free(&sc);
+        return program;
+    }
+
+    Spec sp;
+    memset(&sp, 0, sizeof(sp));
+    sp.nvars = sc.names.n;
+    sp.input = sc.input;
+    sp.bound = (unsigned char*)calloc((size_t)sp.nvars + 1, 1);
+
+    Env env;
+    memset(&env, 0, sizeof(env));
+    if (sp.bound && env_init(&sp, &env)) {
+        for (int i = 0; i < n; i++) {
+            int id = names_lookup(&sc.names, b[i].name, 0);
+            if (id >= 0) sp.bound[id] = 1;
+        }
+        program = pe_block(&sp, &env, program);
+    }
+
+    env_free(&env);
+    free(sp.bound);
+    scan_free(&sc);
+    return program;
+}
+
+/* ============================================================
+   Inputs for rule mode
+   ============================================================ */
+
+static int cmp_input(const void *a, const void *b) {
+    return strcmp(((const SpecInput*)a)->name, ((const SpecInput*)b)->name);
+}
+
+int spec_take_inputs(Stmt **program, SpecInput **out, int *n, char *err, int cap) {
+    *out = NULL;
+    *n = 0;
+
+    Scan sc;
+    SpecInput *in = NULL;
+    if (!scan_program(*program, &sc) ||
+        !(in = (SpecInput*)calloc((size_t)sc.names.n + 1, sizeof(SpecInput)))) {
+        scan_free(&sc);
+        snprintf(err, cap, "noema: out of memory");
+        return 0;
+    }
+
+    /* only the leading definitions run before anything could read them */
+    unsigned char *early = (unsigned char*)calloc((size_t)sc.names.n + 1, 1);
+    if (!early) {
+        free(in);
+        scan_free(&sc);
+        snprintf(err, cap, "noema: out of memory");
+        return 0;
+    }
+    for (Stmt *s = *program; s; s = s->next) {
+        if (s->kind == STMT_IMPORT) continue;
+        if (s->kind != STMT_ASSIGN || s->target_slot < 0 || sc.input[s->target_slot] != s) break;
+        early[s->target_slot] = 1;
+    }
+
+    for (int id = 0; id < sc.names.n; id++) {
+        SpecInput *v = &in[id];
+        snprintf(v->name, sizeof(v->name), "%s", sc.names.names[id]);
+
+        const Stmt *def = sc.input[id];
+        if (!def) {
+            v->kind = sc.first[id] ? SPEC_DERIVED : SPEC_FREE;
+            continue;
+        }
+        v->kind = early[id] ? SPEC_INPUT : SPEC_LATE;
+        if (def->value->kind == EXPR_LITERAL) {
+            v->value = def->value->as.lit;
+        } else {                                            /* -<int> */
+            v->value.lit_kind = LIT_INT;
+            v->value.int_value = (int)(0u - (unsigned)def->value->as.unary.rhs->as.lit.int_value);
+        }
+    }
+
+    /* inputs are top-level statements */
+    for (Stmt **link = program; *link; ) {
+        Stmt *s = *link;
+        if (s->kind == STMT_ASSIGN && s->target_slot >= 0 && sc.input[s->target_slot] == s &&
+            early[s->target_slot]) {
+            *link = s->next;
+            s->next = NULL;
+            parser_free_program(s);
+        } else {
+            link = &s->next;
+        }
+    }
+
+    *n = sc.names.n;
+    qsort(in, (size_t)*n, sizeof(SpecInput), cmp_input);
+    *out = in;
+    free(early);
+    scan_free(&sc);
+    return 1;
+}
+
+/* ============================================================
+   Source writer
+   ============================================================ */
+
+static void write_lit(const LiteralValue *v, FILE *out) {
+    switch (v->lit_kind) {
+        case LIT_INT:
+            if (v->int_value == INT_MIN) fprintf(out, "(-%d - 1)", INT_MAX);
+            else if (v->int_value < 0) fprintf(out, "(-%d)", -v->int_value);
+            else fprintf(out, "%d", v->int_value);
+            break;
+        case LIT_BOOL:   fputs(v->int_value ? "verum" : "falsum", out); break;
+        case LIT_STRING: fprintf(out, "\"%s\"", v->text); break;
+        case LIT_NULL:
+        default:         fputs("nulla", out); break;
+    }
+}
+
+static const char* op_text(ExprOp op) {
+    switch (op) {
+        case OP_ADD: return "+";
+        case OP_SUB: return "-";
+        case OP_MUL: return "*";
+        case OP_DIV: return "/";
+        case OP_MOD: return "%";
+        case OP_EQ:  return "==";
+        case OP_NE:  return "!=";
+        case OP_LT:  return "<";
+        case OP_LE:  return "<=";
+        case OP_GT:  return ">";
+        case OP_GE:  return ">=";
+        case OP_AND: return "et";
+        case OP_OR:  return "aut";
+        default:     return "?";
+    }
+}
+
+static void write_expr(const Expr *e, FILE *out) {
+    switch (e->kind) {
+        case EXPR_LITERAL:
+            write_lit(&e->as.lit, out);
+            return;
+        case EXPR_VAR:
+            fputs(e->as.var.name, out);
+            return;
+        case EXPR_UNARY:
+            fputs(e->as.unary.op == OP_NOT ? "(non " : "(-", out);
+            write_expr(e->as.unary.rhs, out);
+            fputc(')', out);
+            return;
+        case EXPR_BINARY:
+            fputc('(', out);
+            write_expr(e->as.binary.lhs, out);
+            fprintf(out, " %s ", op_text(e->as.binary.op));
+            write_expr(e->as.binary.rhs, out);
+            fputc(')', out);
+            return;
+        default:
+            fputs("nulla", out);
+            return;
+    }
+}
+
+static void write_block(const Stmt *s, int ind, FILE *out) {
+    /* blocks cannot be empty and there is no `pass`; import is a no-op */
+    if (!s && ind > 0) fprintf(out, "%*simport sonus\n", ind, "");
+
+    for (; s; s = s->next) {
+        switch (s->kind) {
+            case STMT_IMPORT:
+                fprintf(out, "%*simport %s\n", ind, "", s->module);
+                break;
+            case STMT_ASSIGN:
+                fprintf(out, "%*s%s = ", ind, "", s->target);
+                write_expr(s->value, out);
+                fputc('\n', out);
+                break;
+            case STMT_CALL_PRINT:
+                fprintf(out, "%*s%s(", ind, "", s->callee);
+                write_expr(s->arg, out);
+                fputs(")\n", out);
+                break;
+            case STMT_IF:
+                for (const IfBranch *b = s->if_branches; b; b = b->next) {
+                    if (b == s->if_branches) fprintf(out, "%*ssi ", ind, "");
+                    else if (b->cond) fprintf(out, "%*saliosi ", ind, "");
+                    else fprintf(out, "%*salio", ind, "");
+                    if (b->cond) write_expr(b->cond, out);
+                    fputs(":\n", out);
+                    write_block(b->body, ind + 4, out);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void spec_write_source(const Stmt *program, FILE *out) {
+    write_block(program, 0, out);
+}
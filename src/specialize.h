@@ -0,0 +1,78 @@
+// src/specialize.h
+#ifndef NOEMA_SPECIALIZE_H
+#define NOEMA_SPECIALIZE_H
+
+#include <stdio.h>
+
+#include "parser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+   Partial evaluation against known inputs.
+
+   An input is a variable whose first assignment (in source order) is a
+   top-level `name = <literal>`; that literal is its default. Binding an
+   input replaces the default. A binding for a variable that is read but
+   never assigned adds `name = <value>` at the top of the program.
+
+   The residual program treats every unbound input as unknown: its
+   default stays in the source, editable per record, and nothing derived
+   from it is folded. Bound inputs are propagated, so expressions and
+   `si` branches that only depend on them are evaluated away.
+*/
+
+/* Types the `n` bytes of unquoted value text at `s` (n less than
+   NOEMA_TOKEN_VALUE_MAX): empty text and nulla are null, verum and falsum
+   are booleans, an optional sign and digits is an integer, and anything
+   else is a string. Returns 0 for integer text that does not fit an int.
+   --bind values and record fields are all typed here. */
+int   spec_parse_value(const char *s, size_t n, LiteralValue *out);
+
+/* `text` is "name=value"; value is typed by spec_parse_value unless it
+   is a "quoted string". */
+typedef struct {
+    char name[NOEMA_TOKEN_VALUE_MAX];
+    LiteralValue value;
+} SpecBinding;
+
+int   spec_parse_binding(const char *text, SpecBinding *out, char *err, int cap);
+
+/* Applies the bindings to `*program`. Returns 1 on success. */
+int   spec_bind(Stmt **program, const SpecBinding *b, int n, char *err, int cap);
+
+/* Rewrites the (bound) program into its residual; returns the new head. */
+Stmt* spec_residual(Stmt *program, const SpecBinding *b, int n);
+
+/* How a variable can receive a value from outside (rule mode). */
+typedef enum {
+    SPEC_INPUT = 1,     /* has a default, defined before anything else runs */
+    SPEC_FREE,          /* read but never assigned */
+    SPEC_LATE,          /* an input defined after other statements */
+    SPEC_DERIVED        /* first assigned from an expression */
+} SpecInputKind;
+
+typedef struct {
+    char name[NOEMA_TOKEN_VALUE_MAX];
+    SpecInputKind kind;
+    LiteralValue value;         /* SPEC_INPUT: the default */
+} SpecInput;
+
+/* Lists every variable of `*program`, sorted by name, and removes the
+   statements that define SPEC_INPUT variables (those in the leading run
+   of imports and input definitions), so their values can be supplied
+   before each run, the default when a run supplies none. Supplying
+   SPEC_FREE variables the same way is exact too; the other kinds keep
+   their assignments. Returns 1 on success; *out is malloc'd. */
+int   spec_take_inputs(Stmt **program, SpecInput **out, int *n, char *err, int cap);
+
+/* Writes `program` as Noema source that parses back to the same behavior. */
+void  spec_write_source(const Stmt *program, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
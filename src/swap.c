@@ -0,0 +1,195 @@
+// src/swap.c
+#include "swap.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+/*
+   Epochs: the handle's epoch starts at 1 and goes up by one with every
+   publish. A reader runs with `active` set to the epoch it read on
+   entry, and 0 outside a run; it stores `active` before loading the
+   current version, and a publisher swaps the version before bumping
+   the epoch (all sequentially consistent). So a reader that entered in
+   a later epoch than the one a version was replaced in loaded a newer
+   version, and the replaced one can go once every reader is outside a
+   run or in a later epoch.
+*/
+
+typedef struct Version {
+    Stmt *program;
+    Runtime *proto;             /* resolved it; readers clone it */
+    unsigned long number;
+    unsigned long replaced;     /* epoch it stopped being current in */
+    struct Version *next;       /* retired list */
+} Version;
+
+struct SwapReader {
+    ProgramHandle *h;
+    atomic_ulong active;        /* epoch of the current run, 0 outside */
+    unsigned long seen;         /* version `rt` was cloned for */
+    Runtime *rt;
+    SwapReader *next;
+};
+
+struct ProgramHandle {
+    _Atomic(Version*) current;
+    atomic_ulong epoch;
+    int no_jit;
+
+    pthread_mutex_t mu;         /* the fields below, and publishing */
+    SwapReader *readers;
+    Version *retired;
+    unsigned long versions;
+};
+
+static void version_free(Version *v) {
+    if (!v) return;
+    runtime_destroy(v->proto);
+    parser_free_program(v->program);
+    free(v);
+}
+
+ProgramHandle* swap_create(int no_jit) {
+    ProgramHandle *h = (ProgramHandle*)calloc(1, sizeof(ProgramHandle));
+    if (!h) return NULL;
+    if (pthread_mutex_init(&h->mu, NULL) != 0) {
+        free(h);
+        return NULL;
+    }
+    atomic_init(&h->current, NULL);
+    atomic_init(&h->epoch, 1);
+    h->no_jit = no_jit;
+    return h;
+}
+
+void swap_destroy(ProgramHandle *h) {
+    if (!h) return;
+    version_free(atomic_load(&h->current));
+    while (h->retired) {
+        Version *next = h->retired->next;
+        version_free(h->retired);
+        h->retired = next;
+    }
+    pthread_mutex_destroy(&h->mu);
+    free(h);
+}
+
+/* Caller holds h->mu. */
+static void reclaim(ProgramHandle *h) {
+    Version **link = &h->retired;
+    while (*link) {
+        Version *v = *link;
+        int used = 0;
+        for (SwapReader *r = h->readers; r && !used; r = r->next) {
+            unsigned long e = atomic_load(&r->active);
+            used = e != 0 && e <= v->replaced;
+        }
+        if (used) {
+            link = &v->next;
+            continue;
+        }
+        *link = v->next;
+        version_free(v);
+    }
+}
+
+unsigned long swap_publish(ProgramHandle *h, Stmt *program) {
+    if (!h) {
+        parser_free_program(program);
+        return 0;
+    }
+
+    Version *v = (Version*)calloc(1, sizeof(Version));
+    Runtime *proto = v ? runtime_create() : NULL;
+    if (proto) runtime_set_jit(proto, !h->no_jit);
+    if (!proto || !runtime_prepare(proto, program)) {
+        runtime_destroy(proto);
+        free(v);
+        parser_free_program(program);
+        return 0;
+    }
+    v->program = program;
+    v->proto = proto;
+
+    /* once the lock is released a later publish may retire and free `v` */
+    pthread_mutex_lock(&h->mu);
+    unsigned long number = ++h->versions;
+    v->number = number;
+    Version *old = atomic_exchange(&h->current, v);
+    if (old) {
+        old->replaced = atomic_fetch_add(&h->epoch, 1);
+        old->next = h->retired;
+        h->retired = old;
+    }
+    reclaim(h);
+    pthread_mutex_unlock(&h->mu);
+    return number;
+}
+
+void swap_reclaim(ProgramHandle *h) {
+    if (!h) return;
+    pthread_mutex_lock(&h->mu);
+    reclaim(h);
+    pthread_mutex_unlock(&h->mu);
+}
+
+SwapReader* swap_reader(ProgramHandle *h) {
+    if (!h) return NULL;
+    SwapReader *r = (SwapReader*)calloc(1, sizeof(SwapReader));
+    if (!r) return NULL;
+    r->h = h;
+    atomic_init(&r->active, 0);
+
+    pthread_mutex_lock(&h->mu);
+    r->next = h->readers;
+    h->readers = r;
+    pthread_mutex_unlock(&h->mu);
+    return r;
+}
+
+void swap_reader_free(SwapReader *r) {
+    if (!r) return;
+    ProgramHandle *h = r->h;
+    pthread_mutex_lock(&h->mu);
+    for (SwapReader **link = &h->readers; *link; link = &(*link)->next) {
+        if (*link == r) {
+            *link = r->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&h->mu);
+    runtime_destroy(r->rt);
+    free(r);
+}
+
+Runtime* swap_enter(SwapReader *r, Stmt **program, unsigned long *version) {
+    if (!r) return NULL;
+    ProgramHandle *h = r->h;
+
+    atomic_store(&r->active, atomic_load(&h->epoch));
+    Version *v = atomic_load(&h->current);
+    if (!v) {
+        atomic_store_explicit(&r->active, 0, memory_order_release);
+        return NULL;
+    }
+
+    /* numbers, not pointers: a freed version's memory may be reused */
+    if (!r->rt || r->seen != v->number) {
+        runtime_destroy(r->rt);
+        r->rt = runtime_clone(v->proto, v->program);
+        r->seen = r->rt ? v->number : 0;
+        if (!r->rt) {
+            atomic_store_explicit(&r->active, 0, memory_order_release);
+            return NULL;
+        }
+    }
+
+    if (program) *program = v->program;
+    if (version) *version = v->number;
+    return r->rt;
+}
+
+void swap_exit(SwapReader *r) {
+    if (r) atomic_store_explicit(&r->active, 0, memory_order_release);
+}
@@ -0,0 +1,68 @@
+// src/swap.h
+#ifndef NOEMA_SWAP_H
+#define NOEMA_SWAP_H
+
+#include "parser.h"
+#include "runtime.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+   Hot-swappable programs, for a host whose rules change while it runs.
+
+   A ProgramHandle holds the current version of a program. Any thread
+   may publish a new version at any time. Each thread that runs the
+   program does so through a SwapReader of its own. A run pins the
+   version that is current when it starts and keeps it to the end, in a
+   runtime of the reader's own resolved for that version, so a run never
+   sees half of one version and half of another.
+
+   Runs take no lock. A reader announces the epoch it runs in, and a
+   replaced version is freed only once every reader has left the epoch
+   it was replaced in (epoch-based reclamation). Publishing, creating
+   readers and freeing versions are serialized on a mutex. Replaced
+   versions are freed by the next publish that finds them unused, or by
+   swap_reclaim.
+*/
+
+typedef struct ProgramHandle ProgramHandle;
+typedef struct SwapReader SwapReader;
+
+/* A handle with no version yet. Runtimes of its readers interpret only
+   if `no_jit` is set. NULL if out of memory. */
+ProgramHandle* swap_create(int no_jit);
+
+/* Frees the handle and every version. Its readers must be freed first. */
+void           swap_destroy(ProgramHandle *h);
+
+/* Makes `program` the current version and takes ownership of it. The
+   program is resolved here, once for every reader. Returns the new
+   version number (from 1), or 0 if out of memory, in which case the
+   program is freed and the current version stays. */
+unsigned long  swap_publish(ProgramHandle *h, Stmt *program);
+
+/* Frees the replaced versions that no run still uses. */
+void           swap_reclaim(ProgramHandle *h);
+
+/* A reader for one thread. NULL if out of memory. It must be outside a
+   run when freed. */
+SwapReader*    swap_reader(ProgramHandle *h);
+void           swap_reader_free(SwapReader *r);
+
+/* Starts a run: pins the current version and returns the runtime to run
+   it in, with the program in *program and its number in *version. The
+   runtime belongs to the reader and keeps its variables from run to run
+   of the same version; a new version starts with a fresh one. NULL
+   (and no run) if nothing is published yet or out of memory. */
+Runtime*       swap_enter(SwapReader *r, Stmt **program, unsigned long *version);
+
+/* Ends the run started by swap_enter. */
+void           swap_exit(SwapReader *r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,184 @@
+// tests/eval_batch.c
+// Runs noema_eval_batch over the same records in callback mode and in
+// array mode, with and without the JIT, and checks every record's
+// output and error against what the program should do. Also covers the
+// argument checks: empty batches, a NULL sink and a bad field index.
+// Build and run with `make test` (under AddressSanitizer by default).
+#define _DEFAULT_SOURCE
+#include "noema.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RECORDS 60
+
+/* x = 0 fails after printing, so failed records have output too */
+static const char *SOURCE =
+    "import sonus\n"
+    "x = 1\n"
+    "y = 2\n"
+    "name = \"big\"\n"
+    "si x > y:\n"
+    "    sonus.dic(name)\n"
+    "alio:\n"
+    "    sonus.dic(x + y)\n"
+    "sonus.dic(12 / x)\n";
+
+typedef struct {
+    int ok;
+    char output[64];
+    char error[256];
+} Seen;
+
+static int failures;
+static int fx, fy, fname;
+static NoemaField fields[RECORDS][3];
+static NoemaRecord records[RECORDS];
+static Seen seen[RECORDS];
+static size_t calls;
+
+static void fail(const char *what, size_t index, const char *detail) {
+    failures++;
+    fprintf(stderr, "eval_batch: %s (record %zu) %s\n", what, index, detail);
+}
+
+/* Record k sets x to k % 7 (every fifth record leaves it at 1), y to 3,
+   and every third record sets name. */
+static void make_records(void) {
+    for (int k = 0; k < RECORDS; k++) {
+        int n = 0;
+        if (k % 5 != 4) {
+            fields[k][n].field = fx;
+            fields[k][n].kind = NOEMA_INT;
+            fields[k][n++].int_value = k % 7;
+        }
+        fields[k][n].field = fy;
+        fields[k][n].kind = NOEMA_INT;
+        fields[k][n++].int_value = 3;
+        if (k % 3 == 0) {
+            fields[k][n].field = fname;
+            fields[k][n].kind = NOEMA_STRING;
+            fields[k][n++].string_value = "r";
+        }
+        records[k].fields = fields[k];
+        records[k].nfields = n;
+    }
+}
+
+static void check(size_t k, const Seen *s) {
+    int x = k % 5 != 4 ? (int)(k % 7) : 1;
+    char want[64];
+    if (x > 3) snprintf(want, sizeof(want), "%s\n", k % 3 == 0 ? "r" : "big");
+    else snprintf(want, sizeof(want), "%d\n", x + 3);
+    if (x != 0) snprintf(want + strlen(want), sizeof(want) - strlen(want), "%d\n", 12 / x);
+
+    if (s->ok != (x != 0)) fail("wrong ok flag", k, "");
+    if (strcmp(s->output, want) != 0) fail("wrong output:", k, s->output);
+    if (s->ok ? s->error[0] != '\0' : strstr(s->error, "division by zero") == NULL) {
+        fail("wrong error:", k, s->error);
+    }
+}
+
+static void keep(size_t k, const NoemaRecordResult *r) {
+    Seen *s = &seen[k];
+    s->ok = r->ok;
+    snprintf(s->output, sizeof(s->output), "%.*s", (int)r->output_len, r->output);
+    snprintf(s->error, sizeof(s->error), "%s", r->error);
+}
+
+static void on_result(void *ctx, size_t index, const NoemaRecordResult *r) {
+    size_t base = *(const size_t*)ctx;
+    if (index != calls - base) fail("out of order:", base + index, "");
+    keep(base + index, r);
+    calls++;
+}
+
+/* Runs all records in batches of `size`, through `fn` or into an array. */
+static void run_all(NoemaProgram *p, size_t size, int callback) {
+    NoemaRecordResult results[RECORDS];
+    memset(seen, 0, sizeof(seen));
+    calls = 0;
+    for (size_t at = 0; at < RECORDS; at += size) {
+        size_t n = at + size <= RECORDS ? size : RECORDS - at;
+        NoemaResultSink sink;
+        memset(&sink, 0, sizeof(sink));
+        if (callback) {
+            sink.fn = on_result;
+            sink.ctx = &at;
+        } else {
+            sink.results = results;
+        }
+
+        long want = 0;
+        for (size_t k = at; k < at + n; k++) want += k % 5 != 4 && k % 7 == 0;
+        long failed = noema_eval_batch(p, records + at, n, &sink);
+        if (failed != want) fail("wrong failure count in the batch at", at, "");
+        for (size_t k = 0; !callback && k < n; k++) keep(at + k, &results[k]);
+    }
+    if (callback && calls != RECORDS) fail("missed callbacks, last", calls, "");
+    for (size_t k = 0; k < RECORDS; k++) check(k, &seen[k]);
+}
+
+static void check_arguments(NoemaProgram *p) {
+    NoemaResultSink cb, array;
+    size_t base = 0;
+    memset(&cb, 0, sizeof(cb));
+    memset(&array, 0, sizeof(array));
+    cb.fn = on_result;
+    cb.ctx = &base;
+    calls = 0;
+
+    if (noema_eval_batch(p, NULL, 0, NULL) != -1) fail("empty batch with no sink not rejected", 0, "");
+    if (noema_eval_batch(p, records, 1, NULL) != -1) fail("batch with no sink not rejected", 0, "");
+    if (noema_eval_batch(NULL, records, 1, &cb) != -1) fail("batch with no program not rejected", 0, "");
+    if (noema_eval_batch(p, NULL, 0, &cb) != 0) fail("empty callback batch failed", 0, "");
+    /* an empty array batch needs no results array */
+    if (noema_eval_batch(p, NULL, 0, &array) != 0) fail("empty array batch failed", 0, "");
+    if (noema_eval_batch(p, records, 1, &array) != -1) fail("array batch with no results not rejected", 0, "");
+
+    NoemaField bad = { 99, NOEMA_INT, 1, NULL };
+    NoemaRecord two[2] = { records[1], { &bad, 1 } };
+    if (noema_eval_batch(p, two, 2, &cb) != -1) fail("bad field index not rejected", 1, "");
+    if (calls != 0) fail("a rejected batch ran, calls:", calls, "");
+}
+
+int main(void) {
+    static const size_t sizes[] = { 1, 7, RECORDS };
+
+    for (int jit = 0; jit <= 1; jit++) {
+        NoemaOptions opt;
+        memset(&opt, 0, sizeof(opt));
+        opt.no_jit = !jit;
+        FILE *f = fmemopen((void*)SOURCE, strlen(SOURCE), "r");
+        NoemaResult r;
+        NoemaProgram *p = f ? noema_program_load(f, "batch", &opt, &r) : NULL;
+        if (f) fclose(f);
+        if (!p) {
+            fprintf(stderr, "eval_batch: cannot load the program: %s\n", f ? r.message : "");
+            return 1;
+        }
+
+        fx = noema_field(p, "x");
+        fy = noema_field(p, "y");
+        fname = noema_field(p, "name");
+        if (fx < 0 || fy < 0 || fname < 0 || noema_field(p, "z") != -1) {
+            fail("wrong field indexes", 0, "");
+        }
+        make_records();
+
+        check_arguments(p);
+        /* enough runs for the JIT to compile the program on the way */
+        for (int i = 0; i < 3; i++) {
+            for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+                run_all(p, sizes[s], 1);
+                run_all(p, sizes[s], 0);
+            }
+        }
+        check_arguments(p);
+        noema_program_free(p);
+    }
+
+    printf("eval_batch: %d failures\n", failures);
+    return failures != 0;
+}
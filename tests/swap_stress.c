@@ -0,0 +1,158 @@
+// tests/swap_stress.c
+// Publishes new versions of a program continuously from several threads
+// while reader threads run it, and checks that every run sees exactly
+// one version and that a reader never goes back to an older one. Build
+// and run with `make stress` (under ThreadSanitizer by default).
+#define _DEFAULT_SOURCE
+#include "swap.h"
+#include "lexer.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PUBLISHERS 2
+
+static ProgramHandle *handle;
+static atomic_int stop;
+static atomic_long next_id, runs, failures;
+
+/* Program `id` prints x * id + id, then id; a run that mixed two
+   versions prints a pair that does not fit. The si chain gives each
+   version a dispatch table to build and free. */
+static Stmt* make_version(long id) {
+    char src[512];
+    snprintf(src, sizeof(src),
+             "import sonus\n"
+             "t = x * %ld\n"
+             "y = t + %ld\n"
+             "si y == -3:\n"
+             "    sonus.dic(0)\n"
+             "aliosi y == -5:\n"
+             "    sonus.dic(0)\n"
+             "alio:\n"
+             "    sonus.dic(y)\n"
+             "sonus.dic(%ld)\n",
+             id, id, id);
+
+    FILE *f = fmemopen(src, strlen(src), "r");
+    if (!f) return NULL;
+    Lexer *lx = lexer_create(f, "stress");
+    Parser *p = lx ? parser_create(lx) : NULL;
+    ParseResult pr;
+    memset(&pr, 0, sizeof(pr));
+    if (p) pr = parser_parse_program(p);
+    parser_destroy(p);
+    lexer_destroy(lx);
+    fclose(f);
+    if (!pr.ok) {
+        parser_free_program(pr.first);
+        return NULL;
+    }
+    return pr.first;
+}
+
+static void fail(const char *what, unsigned long version, const char *detail) {
+    atomic_fetch_add(&failures, 1);
+    fprintf(stderr, "swap_stress: %s (version %lu) %s\n", what, version, detail);
+}
+
+static void* reader_main(void *arg) {
+    (void)arg;
+    SwapReader *r = swap_reader(handle);
+    char *buf = NULL;
+    size_t len = 0;
+    FILE *out = r ? open_memstream(&buf, &len) : NULL;
+    if (!out) fail("out of memory", 0, "");
+
+    LiteralValue x;
+    memset(&x, 0, sizeof(x));
+    x.lit_kind = LIT_INT;
+    unsigned long seen = 0;
+
+    for (long i = 0; out && !atomic_load(&stop); i++) {
+        Stmt *program;
+        unsigned long version;
+        Runtime *rt = swap_enter(r, &program, &version);
+        if (!rt) continue;
+
+        x.int_value = (int)(i % 100);
+        runtime_set_output(rt, out);
+        runtime_set_var(rt, runtime_var(rt, "x"), &x);
+
+        size_t at = len;
+        char err[256];
+        if (!runtime_exec(rt, program, "stress", err, (int)sizeof(err))) fail("run failed:", version, err);
+        fflush(out);
+
+        long y, id;
+        if (sscanf(buf + at, "%ld\n%ld", &y, &id) != 2 || y != x.int_value * id + id) {
+            fail("mixed versions, printed", version, buf + at);
+        }
+        if (version < seen) fail("went back from", seen, "");
+        seen = version;
+        swap_exit(r);
+        atomic_fetch_add(&runs, 1);
+
+        if (len > (1u << 20)) {
+            fclose(out);
+            free(buf);
+            buf = NULL;
+            len = 0;
+            out = open_memstream(&buf, &len);
+        }
+    }
+
+    if (out) fclose(out);
+    free(buf);
+    swap_reader_free(r);
+    return NULL;
+}
+
+/* Version numbers are taken under the handle's lock, so the ones a
+   publisher gets back strictly increase. */
+static void* publisher_main(void *arg) {
+    long count = *(const long*)arg;
+    unsigned long last = 0;
+    for (long i = 0; i < count; i++) {
+        Stmt *program = make_version(atomic_fetch_add(&next_id, 1) + 1);
+        if (!program) { fail("cannot parse a version", 0, ""); break; }
+        unsigned long n = swap_publish(handle, program);
+        if (n <= last) fail("publish returned", n, "");
+        last = n;
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    int readers = argc > 1 ? atoi(argv[1]) : 4;
+    long versions = argc > 2 ? atol(argv[2]) : 500;
+    if (readers < 1 || readers > 64 || versions < PUBLISHERS) {
+        fprintf(stderr, "usage: %s [readers (1-64)] [versions (%d+)]\n", argv[0], PUBLISHERS);
+        return 2;
+    }
+
+    handle = swap_create(0);
+    if (!handle || !swap_publish(handle, make_version(atomic_fetch_add(&next_id, 1) + 1))) {
+        fprintf(stderr, "swap_stress: cannot publish the first version\n");
+        return 1;
+    }
+
+    pthread_t rd[64], pub[PUBLISHERS];
+    long per = versions / PUBLISHERS;
+    for (int i = 0; i < readers; i++) pthread_create(&rd[i], NULL, reader_main, NULL);
+    for (int i = 0; i < PUBLISHERS; i++) pthread_create(&pub[i], NULL, publisher_main, &per);
+    for (int i = 0; i < PUBLISHERS; i++) pthread_join(pub[i], NULL);
+    atomic_store(&stop, 1);
+    for (int i = 0; i < readers; i++) pthread_join(rd[i], NULL);
+
+    swap_reclaim(handle);
+    swap_destroy(handle);
+
+    long bad = atomic_load(&failures);
+    printf("swap_stress: %ld runs over %ld versions, %ld failures\n",
+           atomic_load(&runs), atomic_load(&next_id), bad);
+    return bad != 0;
+}